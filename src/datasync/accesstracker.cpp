@@ -0,0 +1,101 @@
+#include "accesstracker_p.h"
+
+#include <algorithm>
+
+using namespace QtDataSync;
+
+AccessTracker::AccessTracker(QHash<QByteArray, int> capacities) :
+	_capacities{std::move(capacities)}
+{}
+
+QList<QByteArray> AccessTracker::trackedTypes() const
+{
+	return _capacities.keys();
+}
+
+bool AccessTracker::isTracked(const QByteArray &typeName) const
+{
+	return _capacities.contains(typeName);
+}
+
+void AccessTracker::record(const ObjectKey &key)
+{
+	if(!isTracked(key.typeName))
+		return;
+
+	QMutexLocker _(&_lock);
+	auto &counts = _counts[key.typeName];
+	auto it = counts.find(key.id);
+	if(it != counts.end())
+		++(*it);
+	else
+		insert(counts, _capacities.value(key.typeName), key.id, 1);
+	_changed.insert(key.typeName);
+}
+
+void AccessTracker::restore(const QByteArray &typeName, const Counts &counts)
+{
+	QMutexLocker _(&_lock);
+	auto &current = _counts[typeName];
+	const auto capacity = _capacities.value(typeName);
+	for(auto it = counts.constBegin(); it != counts.constEnd(); it++) {
+		const auto count = (*it + 1) / 2; //older runs count less, so the set can change over time
+		auto cIt = current.find(it.key());
+		if(cIt != current.end())
+			*cIt += count;
+		else
+			insert(current, capacity, it.key(), count);
+	}
+}
+
+QStringList AccessTracker::mostUsed(const QByteArray &typeName, int limit) const
+{
+	QList<QPair<quint64, QString>> entries;
+	{
+		QMutexLocker _(&_lock);
+		const auto counts = _counts.value(typeName);
+		entries.reserve(counts.size());
+		for(auto it = counts.constBegin(); it != counts.constEnd(); it++)
+			entries.append({it.value(), it.key()});
+	}
+
+	limit = qMin(limit, entries.size());
+	std::partial_sort(entries.begin(), entries.begin() + limit, entries.end(),
+					  [](const QPair<quint64, QString> &lhs, const QPair<quint64, QString> &rhs) {
+		return lhs.first > rhs.first;
+	});
+	QStringList ids;
+	ids.reserve(limit);
+	for(auto i = 0; i < limit; i++)
+		ids.append(entries[i].second);
+	return ids;
+}
+
+QHash<QByteArray, AccessTracker::Counts> AccessTracker::takeChanged()
+{
+	QMutexLocker _(&_lock);
+	QHash<QByteArray, Counts> changed;
+	for(const auto &typeName : qAsConst(_changed))
+		changed.insert(typeName, _counts.value(typeName));
+	_changed.clear();
+	return changed;
+}
+
+void AccessTracker::clear()
+{
+	QMutexLocker _(&_lock);
+	_counts.clear();
+	_changed.clear();
+}
+
+void AccessTracker::insert(Counts &counts, int capacity, const QString &id, quint64 count)
+{
+	if(capacity <= 0)
+		return;
+	if(counts.size() >= capacity) {
+		auto minIt = std::min_element(counts.begin(), counts.end());
+		count += *minIt;
+		counts.erase(minIt);
+	}
+	counts.insert(id, count);
+}
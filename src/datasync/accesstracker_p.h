@@ -0,0 +1,47 @@
+#ifndef QTDATASYNC_ACCESSTRACKER_P_H
+#define QTDATASYNC_ACCESSTRACKER_P_H
+
+#include <QtCore/QHash>
+#include <QtCore/QSet>
+#include <QtCore/QMutex>
+#include <QtCore/QStringList>
+
+#include "qtdatasync_global.h"
+#include "objectkey.h"
+
+namespace QtDataSync {
+
+//counts loads of the types with the Setup::PreloadMostUsed policy, shared by all stores of a setup
+//uses the space saving algorithm: only a fixed number of keys per type is counted, a new key replaces
+//the least counted one and inherits its count, so frequently loaded keys are never dropped
+class Q_DATASYNC_EXPORT AccessTracker
+{
+	Q_DISABLE_COPY(AccessTracker)
+
+public:
+	using Counts = QHash<QString, quint64>; //id -> count
+
+	explicit AccessTracker(QHash<QByteArray, int> capacities); //type -> number of counted keys
+
+	QList<QByteArray> trackedTypes() const;
+	bool isTracked(const QByteArray &typeName) const; //no lock needed, the types never change
+
+	void record(const ObjectKey &key);
+	void restore(const QByteArray &typeName, const Counts &counts); //adds counts of previous runs, with half the weight
+	QStringList mostUsed(const QByteArray &typeName, int limit) const;
+	QHash<QByteArray, Counts> takeChanged(); //all counts of types that were changed since the last call
+	void clear();
+
+private:
+	const QHash<QByteArray, int> _capacities;
+
+	mutable QMutex _lock;
+	QHash<QByteArray, Counts> _counts;
+	QSet<QByteArray> _changed;
+
+	static void insert(Counts &counts, int capacity, const QString &id, quint64 count);
+};
+
+}
+
+#endif // QTDATASYNC_ACCESSTRACKER_P_H
@@ -0,0 +1,73 @@
+#include "cachestatistics.h"
+#include "cachestatistics_p.h"
+using namespace QtDataSync;
+
+CacheStatistics::CacheStatistics() :
+	d{new CacheStatisticsPrivate{}}
+{}
+
+CacheStatistics::CacheStatistics(const CacheStatistics &other) = default;
+
+CacheStatistics::CacheStatistics(CacheStatistics &&other) = default;
+
+CacheStatistics::~CacheStatistics() = default;
+
+CacheStatistics &CacheStatistics::operator=(const CacheStatistics &other) = default;
+
+CacheStatistics &CacheStatistics::operator=(CacheStatistics &&other) = default;
+
+quint64 CacheStatistics::hits() const
+{
+	return d->hits;
+}
+
+quint64 CacheStatistics::misses() const
+{
+	return d->misses;
+}
+
+quint64 CacheStatistics::inserts() const
+{
+	return d->inserts;
+}
+
+quint64 CacheStatistics::evictions() const
+{
+	return d->evictions;
+}
+
+quint64 CacheStatistics::invalidations() const
+{
+	return d->invalidations;
+}
+
+int CacheStatistics::count() const
+{
+	return d->count;
+}
+
+int CacheStatistics::totalCost() const
+{
+	return d->totalCost;
+}
+
+int CacheStatistics::maxCost() const
+{
+	return d->maxCost;
+}
+
+double CacheStatistics::hitRate() const
+{
+	const auto loads = d->hits + d->misses;
+	if(loads == 0)
+		return 0.0;
+	return static_cast<double>(d->hits) / static_cast<double>(loads);
+}
+
+
+
+CacheStatisticsPrivate::CacheStatisticsPrivate() :
+	QSharedData{}
+{}
+
+CacheStatisticsPrivate::CacheStatisticsPrivate(const CacheStatisticsPrivate &other) = default;
@@ -0,0 +1,81 @@
+#ifndef QTDATASYNC_CACHESTATISTICS_H
+#define QTDATASYNC_CACHESTATISTICS_H
+
+#include <QtCore/qobject.h>
+#include <QtCore/qshareddata.h>
+
+#include "QtDataSync/qtdatasync_global.h"
+
+namespace QtDataSync {
+
+class ObjectCache;
+
+class CacheStatisticsPrivate;
+//! A snapshot of the usage figures of the data cache of a setup
+class Q_DATASYNC_EXPORT CacheStatistics
+{
+	Q_GADGET
+	friend class ObjectCache;
+
+	//! The number of loads that were answered from the cache
+	Q_PROPERTY(quint64 hits READ hits)
+	//! The number of loads that had to read the data from the disk
+	Q_PROPERTY(quint64 misses READ misses)
+	//! The number of datasets that were added to or replaced in the cache
+	Q_PROPERTY(quint64 inserts READ inserts)
+	//! The number of datasets that were dropped to make room for others
+	Q_PROPERTY(quint64 evictions READ evictions)
+	//! The number of datasets that were dropped because they were changed by another setup instance
+	Q_PROPERTY(quint64 invalidations READ invalidations)
+	//! The number of datasets currently in the cache
+	Q_PROPERTY(int count READ count)
+	//! The size in bytes of the datasets currently in the cache
+	Q_PROPERTY(int totalCost READ totalCost)
+	//! The maximum size in bytes of the cache, see Setup::cacheSize
+	Q_PROPERTY(int maxCost READ maxCost)
+	//! The fraction of loads that were answered from the cache
+	Q_PROPERTY(double hitRate READ hitRate)
+
+public:
+	//! Default constructor, with all figures 0
+	CacheStatistics();
+	//! Copy constructor
+	CacheStatistics(const CacheStatistics &other);
+	//! Move constructor
+	CacheStatistics(CacheStatistics &&other);
+	~CacheStatistics();
+
+	//! Copy-Assignment operator
+	CacheStatistics &operator=(const CacheStatistics &other);
+	//! Move-Assignment operator
+	CacheStatistics &operator=(CacheStatistics &&other);
+
+	//! @readAcFn{CacheStatistics::hits}
+	quint64 hits() const;
+	//! @readAcFn{CacheStatistics::misses}
+	quint64 misses() const;
+	//! @readAcFn{CacheStatistics::inserts}
+	quint64 inserts() const;
+	//! @readAcFn{CacheStatistics::evictions}
+	quint64 evictions() const;
+	//! @readAcFn{CacheStatistics::invalidations}
+	quint64 invalidations() const;
+	//! @readAcFn{CacheStatistics::count}
+	int count() const;
+	//! @readAcFn{CacheStatistics::totalCost}
+	int totalCost() const;
+	//! @readAcFn{CacheStatistics::maxCost}
+	int maxCost() const;
+	//! @readAcFn{CacheStatistics::hitRate}
+	double hitRate() const;
+
+private:
+	QSharedDataPointer<CacheStatisticsPrivate> d;
+};
+
+}
+
+Q_DECLARE_METATYPE(QtDataSync::CacheStatistics)
+Q_DECLARE_TYPEINFO(QtDataSync::CacheStatistics, Q_MOVABLE_TYPE);
+
+#endif // QTDATASYNC_CACHESTATISTICS_H
@@ -0,0 +1,28 @@
+#ifndef QTDATASYNC_CACHESTATISTICS_P_H
+#define QTDATASYNC_CACHESTATISTICS_P_H
+
+#include "qtdatasync_global.h"
+#include "cachestatistics.h"
+
+namespace QtDataSync {
+
+//no export needed
+class CacheStatisticsPrivate : public QSharedData
+{
+public:
+	CacheStatisticsPrivate();
+	CacheStatisticsPrivate(const CacheStatisticsPrivate &other);
+
+	quint64 hits = 0;
+	quint64 misses = 0;
+	quint64 inserts = 0;
+	quint64 evictions = 0;
+	quint64 invalidations = 0;
+	int count = 0;
+	int totalCost = 0;
+	int maxCost = 0;
+};
+
+}
+
+#endif // QTDATASYNC_CACHESTATISTICS_P_H
@@ -3,6 +3,7 @@
 #include "setup_p.h"
 #include "exchangeengine_p.h"
 #include "synchelper_p.h"
+#include "datacodec_p.h"
 #include "changeemitter_p.h"
 
 using namespace QtDataSync;
@@ -43,6 +44,7 @@ void ChangeController::clearUploads()
 		logDebug() << "Finished uploading changes";
 	_activeUploads.clear();
 	_changeEstimate = 0;
+	_changeCursor = 0;
 }
 
 void ChangeController::updateUploadLimit(quint32 limit)
@@ -132,13 +134,19 @@ void ChangeController::uploadNext(bool emitStarted)
 			}
 		}
 
-		_store->loadChanges(_uploadLimit, [this, emitProgress, &emitStarted](const ObjectKey &objKey, quint64 version, const QString &file, QUuid deviceId) {
+		//continue after the last started change, instead of scanning all of them again
+		auto holdCursor = false;
+		_store->loadChanges(_uploadLimit, _changeCursor, [this, emitProgress, &emitStarted, &holdCursor](quint64 seq, const ObjectKey &objKey, quint64 version, const QString &file, QUuid deviceId) {
 			CachedObjectKey key(objKey, deviceId);
 
 			//skip stuff already beeing uploaded (could still have changed, but to prevent errors)
 //			auto skip = false;
-			if(_activeUploads.contains(key))
+			if(_activeUploads.contains(key)) {
+				holdCursor = true; //must be loaded again once the active upload is done
 				return true;
+			}
+			if(seq != 0 && !holdCursor)
+				_changeCursor = seq;
 //			for(const auto &mKey : _activeUploads.keys()) {
 //				if(key == mKey) {
 //					skip = true;
@@ -175,12 +183,14 @@ void ChangeController::uploadNext(bool emitStarted)
 			} else { //changed
 				try {
 					auto json = _store->readJson(key, file);
+					const auto codecName = CodecHelper::codecName(defaults(), key.typeName);
+					const auto threshold = defaults().property(Defaults::CompressionThreshold).toInt();
 					if(deviceId.isNull()) {
-						emit uploadChange(keyHash, SyncHelper::combine(key, version, json));
+						emit uploadChange(keyHash, SyncHelper::combine(key, version, json, codecName, threshold));
 						logDebug() << "Started upload of changed" << key
 								   << "( Active uploads:" << _activeUploads.size() << ")";
 					} else {
-						emit uploadDeviceChange(keyHash, deviceId, SyncHelper::combine(key, version, json));
+						emit uploadDeviceChange(keyHash, deviceId, SyncHelper::combine(key, version, json, codecName, threshold));
 						logDebug() << "Started device upload of changed"
 								   << key << "for device" << deviceId
 								   << "( Active uploads:" << _activeUploads.size() << ")";
@@ -196,6 +206,7 @@ void ChangeController::uploadNext(bool emitStarted)
 		});
 
 		if(_activeUploads.isEmpty()) {
+			_changeCursor = 0; //nothing in flight -> the next run may start from the beginning again
 			endOp(); //stop any timeouts
 			logDebug() << "Finished uploading changes";
 			emit uploadingChanged(false);
@@ -81,6 +81,7 @@ private:
 	int _uploadLimit = 10;
 	QHash<CachedObjectKey, UploadInfo> _activeUploads;
 	quint32 _changeEstimate = 0;
+	quint64 _changeCursor = 0; //all changes up to this sequence number have been started
 };
 
 //not exported, just like the class
@@ -3,7 +3,7 @@ using namespace QtDataSync;
 
 ChangeEmitter::ChangeEmitter(const Defaults &defaults, QObject *parent) :
 	ChangeEmitterSource{parent},
-	_cache{defaults.cacheHandle().value<QSharedPointer<EmitterAdapter::CacheInfo>>()}
+	_cache{defaults.cacheHandle().value<QSharedPointer<ObjectCache>>()}
 {}
 
 void ChangeEmitter::triggerChange(QObject *origin, const ObjectKey &key, bool deleted, bool changed)
@@ -14,6 +14,16 @@ void ChangeEmitter::triggerChange(QObject *origin, const ObjectKey &key, bool de
 	emit remoteDataChanged(key, deleted);
 }
 
+void ChangeEmitter::triggerChanges(QObject *origin, const QByteArray &typeName, const QStringList &ids, bool deleted, bool changed)
+{
+	if(changed)
+		emit uploadNeeded();
+	for(const auto &id : ids) {
+		emit dataChanged(origin, {typeName, id}, deleted);
+		emit remoteDataChanged({typeName, id}, deleted);
+	}
+}
+
 void ChangeEmitter::triggerClear(QObject *origin, const QByteArray &typeName, const QStringList &ids)
 {
 	emit uploadNeeded();
@@ -37,32 +47,30 @@ void ChangeEmitter::triggerUpload()
 
 void ChangeEmitter::triggerRemoteChange(const ObjectKey &key, bool deleted, bool changed)
 {
-	if(_cache) {
-		auto contains = false;
-		//check if cached
-		{
-			QReadLocker _(&_cache->lock);
-			contains = _cache->cache.contains(key);
-		}
-		//if chached, remove
-		if(contains) {
-			QWriteLocker _(&_cache->lock);
-			_cache->cache.remove(key);
-		}
-	}
+	if(_cache)
+		_cache->remove(key, true);
 	if(changed)
 		emit uploadNeeded();
 	emit dataChanged(nullptr, key, deleted);
 	emit remoteDataChanged(key, deleted);
 }
 
-void ChangeEmitter::triggerRemoteClear(const QByteArray &typeName, const QStringList &ids)
+void ChangeEmitter::triggerRemoteChanges(const QByteArray &typeName, const QStringList &ids, bool deleted, bool changed)
 {
-	if(_cache) {
-		QWriteLocker _(&_cache->lock);
-		for(const auto &id : ids)
-			_cache->cache.remove({typeName, id});
+	if(_cache)
+		_cache->remove(typeName, ids, true);
+	if(changed)
+		emit uploadNeeded();
+	for(const auto &id : ids) {
+		emit dataChanged(nullptr, {typeName, id}, deleted);
+		emit remoteDataChanged({typeName, id}, deleted);
 	}
+}
+
+void ChangeEmitter::triggerRemoteClear(const QByteArray &typeName, const QStringList &ids)
+{
+	if(_cache)
+		_cache->remove(typeName, ids, true);
 	emit uploadNeeded();
 	for(const auto &id : ids) {
 		emit dataChanged(nullptr, {typeName, id}, true);
@@ -72,10 +80,8 @@ void ChangeEmitter::triggerRemoteClear(const QByteArray &typeName, const QString
 
 void ChangeEmitter::triggerRemoteReset()
 {
-	if(_cache) {
-		QWriteLocker _(&_cache->lock);
-		_cache->cache.clear();
-	}
+	if(_cache)
+		_cache->clear(true);
 	emit uploadNeeded();
 	emit dataResetted(nullptr);
 	emit remoteDataResetted();
@@ -25,6 +25,11 @@ public Q_SLOTS:
 					   const QtDataSync::ObjectKey &key,
 					   bool deleted,
 					   bool changed);
+	void triggerChanges(QObject *origin,
+						const QByteArray &typeName,
+						const QStringList &ids,
+						bool deleted,
+						bool changed);
 	void triggerClear(QObject *origin, const QByteArray &typeName, const QStringList &ids);
 	void triggerReset(QObject *origin);
 	void triggerUpload() override;
@@ -38,11 +43,12 @@ Q_SIGNALS:
 protected Q_SLOTS:
 	//remcon interface
 	void triggerRemoteChange(const ObjectKey &key, bool deleted, bool changed) override;
+	void triggerRemoteChanges(const QByteArray &typeName, const QStringList &ids, bool deleted, bool changed) override;
 	void triggerRemoteClear(const QByteArray &typeName, const QStringList &ids) override;
 	void triggerRemoteReset() override;
 
 private:
-	QSharedPointer<EmitterAdapter::CacheInfo> _cache;//needed to clear cache on remote changes
+	QSharedPointer<ObjectCache> _cache;//needed to clear cache on remote changes
 };
 
 }
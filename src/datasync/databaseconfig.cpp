@@ -0,0 +1,80 @@
+#include "databaseconfig.h"
+#include "databaseconfig_p.h"
+using namespace QtDataSync;
+
+DatabaseConfig::DatabaseConfig(bool writeAheadLog, SyncLevel syncLevel, int cacheSize, qint64 mmapSize, TempStore tempStore) :
+	d{new DatabaseConfigPrivate(writeAheadLog, syncLevel, cacheSize, mmapSize, tempStore)}
+{}
+
+DatabaseConfig::DatabaseConfig(const DatabaseConfig &other) = default;
+
+DatabaseConfig::DatabaseConfig(DatabaseConfig &&other) = default;
+
+DatabaseConfig::~DatabaseConfig() = default;
+
+DatabaseConfig &DatabaseConfig::operator=(const DatabaseConfig &other) = default;
+
+DatabaseConfig &DatabaseConfig::operator=(DatabaseConfig &&other) = default;
+
+bool DatabaseConfig::writeAheadLog() const
+{
+	return d->writeAheadLog;
+}
+
+DatabaseConfig::SyncLevel DatabaseConfig::syncLevel() const
+{
+	return d->syncLevel;
+}
+
+int DatabaseConfig::cacheSize() const
+{
+	return d->cacheSize;
+}
+
+qint64 DatabaseConfig::mmapSize() const
+{
+	return d->mmapSize;
+}
+
+DatabaseConfig::TempStore DatabaseConfig::tempStore() const
+{
+	return d->tempStore;
+}
+
+void DatabaseConfig::setWriteAheadLog(bool writeAheadLog)
+{
+	d->writeAheadLog = writeAheadLog;
+}
+
+void DatabaseConfig::setSyncLevel(DatabaseConfig::SyncLevel syncLevel)
+{
+	d->syncLevel = syncLevel;
+}
+
+void DatabaseConfig::setCacheSize(int cacheSize)
+{
+	d->cacheSize = cacheSize;
+}
+
+void DatabaseConfig::setMmapSize(qint64 mmapSize)
+{
+	d->mmapSize = mmapSize;
+}
+
+void DatabaseConfig::setTempStore(DatabaseConfig::TempStore tempStore)
+{
+	d->tempStore = tempStore;
+}
+
+
+
+DatabaseConfigPrivate::DatabaseConfigPrivate(bool writeAheadLog, DatabaseConfig::SyncLevel syncLevel, int cacheSize, qint64 mmapSize, DatabaseConfig::TempStore tempStore) :
+	QSharedData{},
+	writeAheadLog{writeAheadLog},
+	syncLevel{syncLevel},
+	cacheSize{cacheSize},
+	mmapSize{mmapSize},
+	tempStore{tempStore}
+{}
+
+DatabaseConfigPrivate::DatabaseConfigPrivate(const DatabaseConfigPrivate &other) = default;
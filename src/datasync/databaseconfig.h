@@ -0,0 +1,94 @@
+#ifndef QTDATASYNC_DATABASECONFIG_H
+#define QTDATASYNC_DATABASECONFIG_H
+
+#include <QtCore/qobject.h>
+#include <QtCore/qshareddata.h>
+
+#include "QtDataSync/qtdatasync_global.h"
+
+namespace QtDataSync {
+
+class DatabaseConfigPrivate;
+//! A configuration on how the local sqlite database is operated
+class Q_DATASYNC_EXPORT DatabaseConfig
+{
+	Q_GADGET
+
+	//! Specifies whether the database uses a write-ahead-log instead of a rollback journal
+	Q_PROPERTY(bool writeAheadLog READ writeAheadLog WRITE setWriteAheadLog)
+	//! The level of synchronization used when writing data to the disk
+	Q_PROPERTY(SyncLevel syncLevel READ syncLevel WRITE setSyncLevel)
+	//! The maximum size of the page cache of each connection, in KiB
+	Q_PROPERTY(int cacheSize READ cacheSize WRITE setCacheSize)
+	//! The maximum number of bytes of the database that are memory mapped by each connection
+	Q_PROPERTY(qint64 mmapSize READ mmapSize WRITE setMmapSize)
+	//! Specifies where temporary tables and indices are stored
+	Q_PROPERTY(TempStore tempStore READ tempStore WRITE setTempStore)
+
+public:
+	//! The synchronization levels of sqlite (`PRAGMA synchronous`)
+	enum SyncLevel {
+		SyncOff = 0, //!< Do not sync at all. Fastest, but the database can be corrupted on a power loss
+		SyncNormal = 1, //!< Sync at critical moments only. Safe in WAL mode, but the last commits can be lost on a power loss
+		SyncFull = 2, //!< Sync on every commit (sqlite default)
+		SyncExtra = 3 //!< Like SyncFull, but additionally syncs the directory after a journal was deleted
+	};
+	Q_ENUM(SyncLevel)
+
+	//! The storage locations for temporary data (`PRAGMA temp_store`)
+	enum TempStore {
+		TempDefault = 0, //!< Use the compile time default of sqlite
+		TempFile = 1, //!< Store temporary data in files
+		TempMemory = 2 //!< Keep temporary data in memory
+	};
+	Q_ENUM(TempStore)
+
+	//! Default constructor, with optional parameters
+	DatabaseConfig(bool writeAheadLog = false,
+				   SyncLevel syncLevel = SyncFull,
+				   int cacheSize = 0, //use the sqlite default
+				   qint64 mmapSize = 0, //no memory mapping
+				   TempStore tempStore = TempDefault);
+	//! Copy constructor
+	DatabaseConfig(const DatabaseConfig &other);
+	//! Move constructor
+	DatabaseConfig(DatabaseConfig &&other);
+	~DatabaseConfig();
+
+	//! Copy-Assignment operator
+	DatabaseConfig &operator=(const DatabaseConfig &other);
+	//! Move-Assignment operator
+	DatabaseConfig &operator=(DatabaseConfig &&other);
+
+	//! @readAcFn{DatabaseConfig::writeAheadLog}
+	bool writeAheadLog() const;
+	//! @readAcFn{DatabaseConfig::syncLevel}
+	SyncLevel syncLevel() const;
+	//! @readAcFn{DatabaseConfig::cacheSize}
+	int cacheSize() const;
+	//! @readAcFn{DatabaseConfig::mmapSize}
+	qint64 mmapSize() const;
+	//! @readAcFn{DatabaseConfig::tempStore}
+	TempStore tempStore() const;
+
+	//! @writeAcFn{DatabaseConfig::writeAheadLog}
+	void setWriteAheadLog(bool writeAheadLog);
+	//! @writeAcFn{DatabaseConfig::syncLevel}
+	void setSyncLevel(SyncLevel syncLevel);
+	//! @writeAcFn{DatabaseConfig::cacheSize}
+	void setCacheSize(int cacheSize);
+	//! @writeAcFn{DatabaseConfig::mmapSize}
+	void setMmapSize(qint64 mmapSize);
+	//! @writeAcFn{DatabaseConfig::tempStore}
+	void setTempStore(TempStore tempStore);
+
+private:
+	QSharedDataPointer<DatabaseConfigPrivate> d;
+};
+
+}
+
+Q_DECLARE_METATYPE(QtDataSync::DatabaseConfig)
+Q_DECLARE_TYPEINFO(QtDataSync::DatabaseConfig, Q_MOVABLE_TYPE);
+
+#endif // QTDATASYNC_DATABASECONFIG_H
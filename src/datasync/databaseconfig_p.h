@@ -0,0 +1,29 @@
+#ifndef QTDATASYNC_DATABASECONFIG_P_H
+#define QTDATASYNC_DATABASECONFIG_P_H
+
+#include "qtdatasync_global.h"
+#include "databaseconfig.h"
+
+namespace QtDataSync {
+
+//no export needed
+class DatabaseConfigPrivate : public QSharedData
+{
+public:
+	DatabaseConfigPrivate(bool writeAheadLog,
+						  DatabaseConfig::SyncLevel syncLevel,
+						  int cacheSize,
+						  qint64 mmapSize,
+						  DatabaseConfig::TempStore tempStore);
+	DatabaseConfigPrivate(const DatabaseConfigPrivate &other);
+
+	bool writeAheadLog;
+	DatabaseConfig::SyncLevel syncLevel;
+	int cacheSize;
+	qint64 mmapSize;
+	DatabaseConfig::TempStore tempStore;
+};
+
+}
+
+#endif // QTDATASYNC_DATABASECONFIG_P_H
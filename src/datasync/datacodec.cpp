@@ -0,0 +1,133 @@
+#include "datacodec.h"
+#include "datacodec_p.h"
+
+#include <QtCore/QHash>
+#include <QtCore/QReadWriteLock>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QVariant>
+#include <QtCore/QGlobalStatic>
+
+using namespace QtDataSync;
+
+namespace {
+
+// the default codec, always available
+class ZlibCodec : public DataCodec
+{
+public:
+	QByteArray name() const override {
+		return QByteArrayLiteral("zlib");
+	}
+
+	QByteArray encode(const QByteArray &data) const override {
+		return qCompress(data);
+	}
+
+	QByteArray decode(const QByteArray &data) const override {
+		return qUncompress(data);
+	}
+};
+
+class CodecRegistry
+{
+public:
+	CodecRegistry() {
+		auto zlib = QSharedPointer<DataCodec>{new ZlibCodec{}};
+		codecs.insert(zlib->name(), zlib);
+	}
+
+	QReadWriteLock lock;
+	QHash<QByteArray, QSharedPointer<DataCodec>> codecs;
+};
+
+Q_GLOBAL_STATIC(CodecRegistry, registry)
+
+// encoded data: magic, codec name length (1 byte), codec name, encoded data
+// binary and plain json never start with the magic, so old data is still read as is
+const QByteArray CodecMagic = QByteArrayLiteral("qdsc");
+
+}
+
+DataCodec::DataCodec() = default;
+
+DataCodec::~DataCodec() = default;
+
+void DataCodec::registerCodec(DataCodec *codec)
+{
+	Q_ASSERT_X(codec, Q_FUNC_INFO, "codec must not be nullptr");
+	Q_ASSERT_X(!codec->name().isEmpty() && codec->name().size() <= 255, Q_FUNC_INFO, "codec name must be between 1 and 255 bytes");
+	QWriteLocker _(&registry->lock);
+	//never replaced, as the previous one might still be in use
+	if(registry->codecs.contains(codec->name())) {
+		qWarning() << "Compression codec" << codec->name()
+				   << "is already registered - ignoring the new one";
+		delete codec;
+	} else
+		registry->codecs.insert(codec->name(), QSharedPointer<DataCodec>{codec});
+}
+
+const DataCodec *DataCodec::codec(const QByteArray &name)
+{
+	QReadLocker _(&registry->lock);
+	return registry->codecs.value(name).data();
+}
+
+
+
+QByteArray CodecHelper::codecName(const Defaults &defaults, const QByteArray &typeName)
+{
+	const auto typeCodecs = defaults.property(Defaults::TypeCompressionCodecs).toHash();
+	auto tIter = typeCodecs.constFind(QString::fromUtf8(typeName));
+	if(tIter != typeCodecs.constEnd()) //also if empty, to disable it for a single type
+		return tIter->toString().toUtf8();
+	else
+		return defaults.property(Defaults::CompressionCodec).toString().toUtf8();
+}
+
+QByteArray CodecHelper::encode(const QByteArray &codecName, int threshold, const QByteArray &data)
+{
+	if(codecName.isEmpty() || data.size() < threshold)
+		return data;
+
+	auto codec = DataCodec::codec(codecName);
+	if(!codec) {
+		qWarning() << "Unknown compression codec" << codecName
+				   << "- storing data uncompressed";
+		return data;
+	}
+
+	auto encoded = codec->encode(data);
+	if(encoded.size() + CodecMagic.size() + 1 + codecName.size() >= data.size()) //not worth it
+		return data;
+
+	QByteArray result;
+	result.reserve(CodecMagic.size() + 1 + codecName.size() + encoded.size());
+	result.append(CodecMagic);
+	result.append(static_cast<char>(codecName.size()));
+	result.append(codecName);
+	result.append(encoded);
+	return result;
+}
+
+bool CodecHelper::isEncoded(const QByteArray &data)
+{
+	return data.startsWith(CodecMagic);
+}
+
+QByteArray CodecHelper::decode(const QByteArray &data)
+{
+	if(!isEncoded(data))
+		return data;
+
+	const auto nameOffset = CodecMagic.size() + 1;
+	if(data.size() < nameOffset)
+		return {};
+	const auto nameSize = static_cast<int>(static_cast<quint8>(data[CodecMagic.size()]));
+	if(data.size() < nameOffset + nameSize)
+		return {};
+
+	auto codec = DataCodec::codec(data.mid(nameOffset, nameSize));
+	if(!codec)
+		return {};
+	return codec->decode(data.mid(nameOffset + nameSize));
+}
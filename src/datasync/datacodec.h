@@ -0,0 +1,35 @@
+#ifndef QTDATASYNC_DATACODEC_H
+#define QTDATASYNC_DATACODEC_H
+
+#include <QtCore/qbytearray.h>
+
+#include "QtDataSync/qtdatasync_global.h"
+
+namespace QtDataSync {
+
+//! Interface to implement a custom compression codec for stored and uploaded data
+class Q_DATASYNC_EXPORT DataCodec
+{
+	Q_DISABLE_COPY(DataCodec)
+
+public:
+	//! Default constructor
+	DataCodec();
+	virtual ~DataCodec();
+
+	//! The unique name of the codec, as used for Setup::compressionCodec
+	virtual QByteArray name() const = 0;
+	//! Compresses the given data
+	virtual QByteArray encode(const QByteArray &data) const = 0;
+	//! Decompresses data that was compressed by encode()
+	virtual QByteArray decode(const QByteArray &data) const = 0;
+
+	//! Registers a codec, so it can be selected via its name
+	static void registerCodec(DataCodec *codec);
+	//! Returns the codec registered for the given name, or nullptr if there is none
+	static const DataCodec *codec(const QByteArray &name);
+};
+
+}
+
+#endif // QTDATASYNC_DATACODEC_H
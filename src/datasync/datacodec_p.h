@@ -0,0 +1,24 @@
+#ifndef QTDATASYNC_DATACODEC_P_H
+#define QTDATASYNC_DATACODEC_P_H
+
+#include <QtCore/QByteArray>
+
+#include "qtdatasync_global.h"
+#include "datacodec.h"
+#include "defaults.h"
+
+namespace QtDataSync {
+
+namespace CodecHelper {
+
+//exports are needed for tests
+Q_DATASYNC_EXPORT QByteArray codecName(const Defaults &defaults, const QByteArray &typeName); //empty if not compressed
+Q_DATASYNC_EXPORT QByteArray encode(const QByteArray &codecName, int threshold, const QByteArray &data);
+Q_DATASYNC_EXPORT bool isEncoded(const QByteArray &data);
+Q_DATASYNC_EXPORT QByteArray decode(const QByteArray &data); //null if the codec is unknown or decoding failed
+
+}
+
+}
+
+#endif // QTDATASYNC_DATACODEC_P_H
@@ -1,6 +1,9 @@
 #include "datastore.h"
 #include "datastore_p.h"
 #include "defaults_p.h"
+#include "storeworker_p.h"
+
+#include <QtCore/QThread>
 
 #include <QtJsonSerializer/QJsonSerializer>
 
@@ -9,6 +12,33 @@
 using namespace QtDataSync;
 using std::function;
 
+namespace {
+
+LocalStore *checkStore(const Defaults &defaults, LocalStore *store, const QByteArray &typeName)
+{
+	if(!store) {
+		throw LocalStoreException(defaults,
+								  ObjectKey{typeName},
+								  QStringLiteral("async"),
+								  QStringLiteral("The store of the setup is not available for background operations"));
+	}
+	return store;
+}
+
+//deserializes in the worker thread, but hands objects over to the thread that started the operation
+QVariant deserializeFor(const Defaults &defaults, const QJsonObject &data, int metaTypeId, QThread *target)
+{
+	auto value = defaults.serializer()->deserialize(data, metaTypeId);
+	if(QMetaType::typeFlags(metaTypeId).testFlag(QMetaType::PointerToQObject)) {
+		auto object = value.value<QObject*>();
+		if(object)
+			object->moveToThread(target);
+	}
+	return value;
+}
+
+}
+
 DataStore::DataStore(QObject *parent) :
 	DataStore{DefaultSetup, parent}
 {}
@@ -30,7 +60,13 @@ void DataStore::initStore(const QString &setupName)
 	d.reset(new DataStorePrivate(this, setupName));
 	connect(d->store, &LocalStore::dataChanged,
 			this, [this](const ObjectKey &key, bool deleted) {
-		emit dataChanged(QMetaType::type(key.typeName), key.id, deleted, {});
+		const auto metaTypeId = QMetaType::type(key.typeName);
+		d->valueCache.remove({metaTypeId, key.id});
+		emit dataChanged(metaTypeId, key.id, deleted, {});
+	});
+	connect(d->store, &LocalStore::dataResetted,
+			this, [this](){
+		d->valueCache.clear();
 	});
 	connect(d->store, &LocalStore::dataResetted,
 			this, PSIG(&DataStore::dataResetted));
@@ -60,44 +96,70 @@ QVariantList DataStore::loadAll(int metaTypeId) const
 
 QVariant DataStore::load(int metaTypeId, const QString &key) const
 {
-	auto data = d->store->load({d->typeName(metaTypeId), key});
-	return d->serializer->deserialize(data, metaTypeId);
+	QVariant value;
+	if(!tryLoad(metaTypeId, key, value))
+		throw NoDataException(d->defaults, {d->typeName(metaTypeId), key});
+	return value;
 }
 
-void DataStore::save(int metaTypeId, QVariant value)
+bool DataStore::tryLoad(int metaTypeId, const QString &key, QVariant &value) const
 {
-	auto typeName = d->typeName(metaTypeId);
-	if(!value.convert(metaTypeId))
-		throw InvalidDataException(d->defaults, typeName, QStringLiteral("Failed to convert passed variant to the target type"));
+	QJsonObject data;
+	quint64 generation;
+	int size;
+	if(!d->store->tryLoad({d->typeName(metaTypeId), key}, data, generation, size))
+		return false;
+	value = d->deserialize(metaTypeId, key, data, generation, size);
+	return true;
+}
 
-	auto meta = QMetaType::metaObjectForType(metaTypeId);
-	if(!meta)
-		throw InvalidDataException(d->defaults, typeName, QStringLiteral("Type does not have a meta object"));
-	auto userProp = meta->userProperty();
-	if(!userProp.isValid())
-		throw InvalidDataException(d->defaults, typeName, QStringLiteral("Type does not have a user property"));
+bool DataStore::contains(int metaTypeId, const QString &key) const
+{
+	return d->store->contains({d->typeName(metaTypeId), key});
+}
 
-	QString key;
-	auto flags = QMetaType::typeFlags(metaTypeId);
-	if(flags.testFlag(QMetaType::IsGadget))
-		key = userProp.readOnGadget(value.data()).toString();
-	else if(flags.testFlag(QMetaType::PointerToQObject))
-		key = userProp.read(value.value<QObject*>()).toString();
-	else if(flags.testFlag(QMetaType::SharedPointerToQObject))
-		key = userProp.read(value.value<QSharedPointer<QObject>>().data()).toString();
-	else if(flags.testFlag(QMetaType::WeakPointerToQObject))
-		key = userProp.read(value.value<QWeakPointer<QObject>>().data()).toString();
-	else if(flags.testFlag(QMetaType::TrackingPointerToQObject))
-		key = userProp.read(value.value<QPointer<QObject>>().data()).toString();
-	else
-		throw InvalidDataException(d->defaults, typeName, QStringLiteral("Type is neither a gadget nor a pointer to an object"));
+QStringList DataStore::keys(int metaTypeId, int offset, int limit) const
+{
+	return d->store->keys(d->typeName(metaTypeId), offset, limit);
+}
 
-	if(key.isEmpty())
-		throw InvalidDataException(d->defaults, typeName, QStringLiteral("Failed to convert USER property to a string"));
-	auto json = d->serializer->serialize(value);
-	if(!json.isObject())
-		throw InvalidDataException(d->defaults, typeName, QStringLiteral("Serialization converted to invalid json type. Only json objects are allowed"));
-	d->store->save({typeName, key}, json.toObject());
+QVariantList DataStore::loadPage(int metaTypeId, const QString &after, int limit) const
+{
+	const auto page = loadPageEntries(metaTypeId, after, limit);
+	QVariantList resList;
+	resList.reserve(page.size());
+	for(const auto &entry : page)
+		resList.append(entry.second);
+	return resList;
+}
+
+QVariantList DataStore::loadMany(int metaTypeId, const QStringList &keys) const
+{
+	const auto allData = d->store->loadMany(d->typeName(metaTypeId), keys);
+	QVariantList resList;
+	resList.reserve(allData.size());
+	for(const auto &val : allData)
+		resList.append(d->serializer->deserialize(val, metaTypeId));
+	return resList;
+}
+
+void DataStore::save(int metaTypeId, QVariant value)
+{
+	auto typeName = d->typeName(metaTypeId);
+	auto data = d->serialize(metaTypeId, typeName, std::move(value));
+	d->store->save({typeName, data.first}, data.second);
+}
+
+void DataStore::saveAll(int metaTypeId, const QVariantList &values)
+{
+	auto typeName = d->typeName(metaTypeId);
+	QHash<QString, QJsonObject> data;
+	data.reserve(values.size());
+	for(const auto &value : values) {
+		auto entry = d->serialize(metaTypeId, typeName, value);
+		data.insert(entry.first, entry.second); //later duplicates replace earlier ones, like repeated saves would
+	}
+	d->store->saveBatch(typeName, data);
 }
 
 bool DataStore::remove(int metaTypeId, const QString &key)
@@ -105,6 +167,11 @@ bool DataStore::remove(int metaTypeId, const QString &key)
 	return d->store->remove({d->typeName(metaTypeId), key});
 }
 
+int DataStore::removeMany(int metaTypeId, const QStringList &keys)
+{
+	return d->store->removeMany(d->typeName(metaTypeId), keys).size();
+}
+
 void DataStore::update(int metaTypeId, QObject *object) const
 {
 	auto typeName = d->typeName(metaTypeId);
@@ -144,12 +211,39 @@ QVariantList DataStore::search(int metaTypeId, const QString &query, SearchMode
 	return resList;
 }
 
+void DataStore::search(int metaTypeId, const QString &query, const function<bool (QVariant)> &iterator, SearchMode mode) const
+{
+	d->store->find(d->typeName(metaTypeId), query, mode, [&](const ObjectKey &, const QJsonObject &data) {
+		return iterator(d->serializer->deserialize(data, metaTypeId));
+	});
+}
+
+QVariantList DataStore::findBy(int metaTypeId, const QString &property, const QVariant &value) const
+{
+	//serialize the value like the property, so it matches the stored data
+	const auto dataList = d->store->findBy(d->typeName(metaTypeId), property, d->serializer->serialize(value));
+	QVariantList resList;
+	resList.reserve(dataList.size());
+	for(const auto &val : dataList)
+		resList.append(d->serializer->deserialize(val, metaTypeId));
+	return resList;
+}
+
+QVariantList DataStore::fullTextSearch(int metaTypeId, const QString &query, int limit) const
+{
+	const auto dataList = d->store->fullTextSearch(d->typeName(metaTypeId), query, limit);
+	QVariantList resList;
+	resList.reserve(dataList.size());
+	for(const auto &val : dataList)
+		resList.append(d->serializer->deserialize(val, metaTypeId));
+	return resList;
+}
+
 void DataStore::iterate(int metaTypeId, const function<bool (QVariant)> &iterator) const
 {
-	for(const auto &key : keys(metaTypeId)) {
-		if(!iterator(load(metaTypeId, key)))
-			break;
-	}
+	d->store->iterate(d->typeName(metaTypeId), [&](const ObjectKey &, const QJsonObject &data) {
+		return iterator(d->serializer->deserialize(data, metaTypeId));
+	});
 }
 
 void DataStore::clear(int metaTypeId)
@@ -157,13 +251,147 @@ void DataStore::clear(int metaTypeId)
 	d->store->clear(d->typeName(metaTypeId));
 }
 
+QFuture<QVariantList> DataStore::loadAllAsync(int metaTypeId) const
+{
+	return runAsync<QVariantList>(loadAllTask(metaTypeId), [](const QVariant &v) {
+		return v.toList();
+	});
+}
+
+QFuture<QVariant> DataStore::loadAsync(int metaTypeId, const QString &key) const
+{
+	return runAsync<QVariant>(loadTask(metaTypeId, key), [](const QVariant &v) {
+		return v;
+	});
+}
+
+QFuture<void> DataStore::saveAsync(int metaTypeId, QVariant value)
+{
+	//serialize right away, the value belongs to the calling thread
+	auto typeName = d->typeName(metaTypeId);
+	auto data = d->serialize(metaTypeId, typeName, std::move(value));
+	auto defaults = d->defaults;
+
+	QFutureInterface<void> futureInterface;
+	futureInterface.reportStarted();
+	auto future = futureInterface.future();
+	enqueueAsync([futureInterface, defaults, typeName, data](LocalStore *store) mutable {
+		if(!futureInterface.isCanceled()) {
+			try {
+				checkStore(defaults, store, typeName)->save({typeName, data.first}, data.second);
+			} catch(QException &e) {
+				futureInterface.reportException(e);
+			} catch(std::exception &) {
+				futureInterface.reportException(QUnhandledException{});
+			}
+		}
+		futureInterface.reportFinished();
+	});
+	return future;
+}
+
+QFuture<QVariantList> DataStore::searchAsync(int metaTypeId, const QString &query, SearchMode mode) const
+{
+	return runAsync<QVariantList>(searchTask(metaTypeId, query, mode), [](const QVariant &v) {
+		return v.toList();
+	});
+}
+
+CacheStatistics DataStore::cacheStatistics() const
+{
+	auto cache = d->defaults.cacheHandle().value<QSharedPointer<ObjectCache>>();
+	if(cache)
+		return cache->statistics();
+	else
+		return {};
+}
+
+QList<QPair<QString, QVariant>> DataStore::loadPageEntries(int metaTypeId, const QString &after, int limit) const
+{
+	const auto page = d->store->loadPage(d->typeName(metaTypeId), after, limit);
+	QList<QPair<QString, QVariant>> resList;
+	resList.reserve(page.size());
+	for(const auto &entry : page)
+		resList.append({entry.first, d->serializer->deserialize(entry.second, metaTypeId)});
+	return resList;
+}
+
+DataStore::AsyncTask DataStore::loadAllTask(int metaTypeId) const
+{
+	auto typeName = d->typeName(metaTypeId);
+	auto defaults = d->defaults;
+	auto target = QThread::currentThread();
+	return [defaults, typeName, metaTypeId, target](LocalStore *store, const QFutureInterfaceBase &future) {
+		QVariantList resList;
+		try {
+			checkStore(defaults, store, typeName)->iterate(typeName, [&](const ObjectKey &, const QJsonObject &data) {
+				resList.append(deserializeFor(defaults, data, metaTypeId, target));
+				return !future.isCanceled();
+			});
+		} catch(...) {
+			discardAsyncResult(resList);
+			throw;
+		}
+		return QVariant{resList};
+	};
+}
+
+DataStore::AsyncTask DataStore::loadTask(int metaTypeId, const QString &key) const
+{
+	auto typeName = d->typeName(metaTypeId);
+	auto defaults = d->defaults;
+	auto target = QThread::currentThread();
+	return [defaults, typeName, key, metaTypeId, target](LocalStore *store, const QFutureInterfaceBase &) {
+		auto data = checkStore(defaults, store, typeName)->load({typeName, key});
+		return deserializeFor(defaults, data, metaTypeId, target);
+	};
+}
+
+DataStore::AsyncTask DataStore::searchTask(int metaTypeId, const QString &query, SearchMode mode) const
+{
+	auto typeName = d->typeName(metaTypeId);
+	auto defaults = d->defaults;
+	auto target = QThread::currentThread();
+	return [defaults, typeName, query, mode, metaTypeId, target](LocalStore *store, const QFutureInterfaceBase &future) {
+		QVariantList resList;
+		try {
+			checkStore(defaults, store, typeName)->find(typeName, query, mode, [&](const ObjectKey &, const QJsonObject &data) {
+				resList.append(deserializeFor(defaults, data, metaTypeId, target));
+				return !future.isCanceled();
+			});
+		} catch(...) {
+			discardAsyncResult(resList);
+			throw;
+		}
+		return QVariant{resList};
+	};
+}
+
+void DataStore::enqueueAsync(const std::function<void(LocalStore*)> &task) const
+{
+	d->defaults.storeWorker()->enqueue(task);
+}
+
+void DataStore::discardAsyncResult(const QVariant &result)
+{
+	if(result.userType() == QMetaType::QVariantList) {
+		for(const auto &value : result.toList())
+			discardAsyncResult(value);
+	} else if(QMetaType::typeFlags(result.userType()).testFlag(QMetaType::PointerToQObject)) {
+		auto object = result.value<QObject*>();
+		if(object) //lives in the thread of the caller already
+			object->deleteLater();
+	}
+}
+
 // ------------- PRIVATE IMPLEMENTATION -------------
 
 DataStorePrivate::DataStorePrivate(DataStore *q, const QString &setupName) :
 	defaults{DefaultsPrivate::obtainDefaults(setupName)},
 	logger{defaults.createLogger("datastore", q)},
 	serializer{defaults.serializer()},
-	store{new LocalStore(defaults, q)}
+	store{new LocalStore(defaults, q)},
+	valueCache{defaults.property(Defaults::ValueCacheSize).toInt()}
 {}
 
 QByteArray DataStorePrivate::typeName(int metaTypeId) const
@@ -175,6 +403,62 @@ QByteArray DataStorePrivate::typeName(int metaTypeId) const
 		throw InvalidDataException(defaults, "type_" + QByteArray::number(metaTypeId), QStringLiteral("Not a valid metatype id"));
 }
 
+QPair<QString, QJsonObject> DataStorePrivate::serialize(int metaTypeId, const QByteArray &typeName, QVariant value) const
+{
+	if(!value.convert(metaTypeId))
+		throw InvalidDataException(defaults, typeName, QStringLiteral("Failed to convert passed variant to the target type"));
+
+	auto meta = QMetaType::metaObjectForType(metaTypeId);
+	if(!meta)
+		throw InvalidDataException(defaults, typeName, QStringLiteral("Type does not have a meta object"));
+	auto userProp = meta->userProperty();
+	if(!userProp.isValid())
+		throw InvalidDataException(defaults, typeName, QStringLiteral("Type does not have a user property"));
+
+	QString key;
+	auto flags = QMetaType::typeFlags(metaTypeId);
+	if(flags.testFlag(QMetaType::IsGadget))
+		key = userProp.readOnGadget(value.data()).toString();
+	else if(flags.testFlag(QMetaType::PointerToQObject))
+		key = userProp.read(value.value<QObject*>()).toString();
+	else if(flags.testFlag(QMetaType::SharedPointerToQObject))
+		key = userProp.read(value.value<QSharedPointer<QObject>>().data()).toString();
+	else if(flags.testFlag(QMetaType::WeakPointerToQObject))
+		key = userProp.read(value.value<QWeakPointer<QObject>>().data()).toString();
+	else if(flags.testFlag(QMetaType::TrackingPointerToQObject))
+		key = userProp.read(value.value<QPointer<QObject>>().data()).toString();
+	else
+		throw InvalidDataException(defaults, typeName, QStringLiteral("Type is neither a gadget nor a pointer to an object"));
+
+	if(key.isEmpty())
+		throw InvalidDataException(defaults, typeName, QStringLiteral("Failed to convert USER property to a string"));
+	auto json = serializer->serialize(value);
+	if(!json.isObject())
+		throw InvalidDataException(defaults, typeName, QStringLiteral("Serialization converted to invalid json type. Only json objects are allowed"));
+	return {key, json.toObject()};
+}
+
+QVariant DataStorePrivate::deserialize(int metaTypeId, const QString &key, const QJsonObject &data, quint64 generation, int size) const
+{
+	//objects are owned by the caller, so only gadgets can be handed out more than once
+	//data without a generation (not in the json cache or not written yet) cannot be validated later
+	if(valueCache.maxCost() <= 0 ||
+	   generation == 0 ||
+	   !QMetaType::typeFlags(metaTypeId).testFlag(QMetaType::IsGadget))
+		return serializer->deserialize(data, metaTypeId);
+
+	//the generation changes with every save of the key, so changes of other threads whose
+	//dataChanged signal has not been delivered yet are detected as well
+	const ValueKey valueKey{metaTypeId, key};
+	auto cached = valueCache.object(valueKey);
+	if(cached && cached->generation == generation)
+		return cached->value;
+
+	auto value = serializer->deserialize(data, metaTypeId);
+	valueCache.insert(valueKey, new CachedValue{generation, value}, qMax(size, 1));
+	return value;
+}
+
 // ------------- Exceptions -------------
 
 DataStoreException::DataStoreException(const Defaults &defaults, const QString &message) :
@@ -6,15 +6,19 @@
 #include <QtCore/qobject.h>
 #include <QtCore/qscopedpointer.h>
 #include <QtCore/qvariant.h>
+#include <QtCore/qfuture.h>
+#include <QtCore/qexception.h>
 
 #include "QtDataSync/qtdatasync_global.h"
 #include "QtDataSync/objectkey.h"
 #include "QtDataSync/exception.h"
+#include "QtDataSync/cachestatistics.h"
 #include "QtDataSync/qtdatasync_helpertypes.h"
 
 namespace QtDataSync {
 
 class Defaults;
+class LocalStore;
 
 class DataStorePrivate;
 //! Main store to generically access all stored data synchronously
@@ -45,6 +49,8 @@ public:
 	qint64 count(int metaTypeId) const;
 	//! @copybrief DataStore::keys() const
 	QStringList keys(int metaTypeId) const;
+	//! @copybrief DataStore::keys(int, int) const
+	QStringList keys(int metaTypeId, int offset, int limit) const;
 	//! @copybrief DataStore::loadAll() const
 	QVariantList loadAll(int metaTypeId) const;
 	//! @copybrief DataStore::load(const QString &) const
@@ -53,24 +59,57 @@ public:
 	inline QVariant load(int metaTypeId, const QVariant &key) const {
 		return load(metaTypeId, key.toString());
 	}
+	//! @copybrief DataStore::tryLoad(const QString &, T &) const
+	bool tryLoad(int metaTypeId, const QString &key, QVariant &value) const;
+	//! @copybrief DataStore::contains(const QString &) const
+	bool contains(int metaTypeId, const QString &key) const;
+	//! @copybrief DataStore::loadPage(const QString &, int) const
+	QVariantList loadPage(int metaTypeId, const QString &after, int limit) const;
+	//! @copybrief DataStore::loadMany(const QStringList &) const
+	QVariantList loadMany(int metaTypeId, const QStringList &keys) const;
 	//! @copybrief DataStore::save(const T &)
 	void save(int metaTypeId, QVariant value);
+	//! @copybrief DataStore::saveAll(const QList<T> &)
+	void saveAll(int metaTypeId, const QVariantList &values);
 	//! @copybrief DataStore::remove(const QString &)
 	bool remove(int metaTypeId, const QString &key);
 	//! @copybrief DataStore::remove(int, const QString &)
 	inline bool remove(int metaTypeId, const QVariant &key) {
 		return remove(metaTypeId, key.toString());
 	}
+	//! @copybrief DataStore::removeMany(const QStringList &)
+	int removeMany(int metaTypeId, const QStringList &keys);
 	//! @copybrief DataStore::update(T) const
 	void update(int metaTypeId, QObject *object) const;
 	//! @copybrief DataStore::search(const QString &, SearchMode) const
 	QVariantList search(int metaTypeId, const QString &query, SearchMode mode = RegexpMode) const;
+	//! @copybrief DataStore::search(const QString &, const std::function<bool(T)> &, SearchMode) const
+	void search(int metaTypeId,
+				const QString &query,
+				const std::function<bool(QVariant)> &iterator,
+				SearchMode mode = RegexpMode) const;
+	//! @copybrief DataStore::findBy(const QString &, const QVariant &) const
+	QVariantList findBy(int metaTypeId, const QString &property, const QVariant &value) const;
+	//! @copybrief DataStore::fullTextSearch(const QString &, int) const
+	QVariantList fullTextSearch(int metaTypeId, const QString &query, int limit = -1) const;
 	//! @copybrief DataStore::iterate(const std::function<bool(T)> &) const
 	void iterate(int metaTypeId,
 				 const std::function<bool(QVariant)> &iterator) const;
 	//! @copybrief DataStore::clear()
 	void clear(int metaTypeId);
 
+	//! @copybrief DataStore::loadAllAsync() const
+	QFuture<QVariantList> loadAllAsync(int metaTypeId) const;
+	//! @copybrief DataStore::loadAsync(const QString &) const
+	QFuture<QVariant> loadAsync(int metaTypeId, const QString &key) const;
+	//! @copybrief DataStore::saveAsync(const T &)
+	QFuture<void> saveAsync(int metaTypeId, QVariant value);
+	//! @copybrief DataStore::searchAsync(const QString &, SearchMode) const
+	QFuture<QVariantList> searchAsync(int metaTypeId, const QString &query, SearchMode mode = RegexpMode) const;
+
+	//! Returns the current usage figures of the data cache of the setup
+	CacheStatistics cacheStatistics() const;
+
 	//! Counts the number of datasets for the given type
 	template<typename T>
 	quint64 count() const;
@@ -84,6 +123,9 @@ public:
 	 */
 	template<typename T, typename K>
 	QList<K> keys() const;
+	//! Returns a part of the saved keys for the given type, sorted by the key
+	template<typename T>
+	QStringList keys(int offset, int limit) const;
 	//! Loads all existing datasets for the given type
 	template<typename T>
 	QList<T> loadAll() const;
@@ -93,21 +135,48 @@ public:
 	//! @copybrief DataStore::load(const QString &) const
 	template<typename T, typename K>
 	T load(const K &key) const;
+	//! Loads the dataset with the given key for the given type, if it exists
+	template<typename T>
+	bool tryLoad(const QString &key, T &value) const;
+	//! Checks whether a dataset with the given key exists for the given type
+	template<typename T>
+	bool contains(const QString &key) const;
+	//! Loads the datasets of the given type that follow the given key, sorted by the key
+	template<typename T>
+	QList<T> loadPage(const QString &after, int limit) const;
+	//! Loads all datasets with the given keys for the given type
+	template<typename T>
+	QList<T> loadMany(const QStringList &keys) const;
 	//! Saves the given dataset in the store
 	template<typename T>
 	void save(const T &value);
+	//! Saves all of the given datasets in the store at once
+	template<typename T>
+	void saveAll(const QList<T> &values);
 	//! Removes the dataset with the given key for the given type
 	template<typename T>
 	bool remove(const QString &key);
 	//! @copybrief DataStore::remove(const QString &)
 	template<typename T, typename K>
 	bool remove(const K &key);
+	//! Removes all datasets with the given keys for the given type
+	template<typename T>
+	int removeMany(const QStringList &keys);
 	//! Loads the dataset with the given key for the given type into the existing object by updating it's properties
 	template<typename T>
 	void update(T object) const;
 	//! Searches the store for datasets of the given type where the key matches the query
 	template<typename T>
 	QList<T> search(const QString &query, SearchMode mode = RegexpMode) const;
+	//! Iterates over all datasets of the given type where the key matches the query
+	template<typename T>
+	void search(const QString &query, const std::function<bool(T)> &iterator, SearchMode mode = RegexpMode) const;
+	//! Finds all datasets of the given type where the indexed property has the given value
+	template<typename T>
+	QList<T> findBy(const QString &property, const QVariant &value) const;
+	//! Searches the full text index of the given type and returns the best matching datasets
+	template<typename T>
+	QList<T> fullTextSearch(const QString &query, int limit = -1) const;
 	//! Iterates over all existing datasets of the given types
 	template<typename T>
 	void iterate(const std::function<bool(T)> &iterator) const;
@@ -115,6 +184,19 @@ public:
 	template<typename T>
 	void clear();
 
+	//! Loads all existing datasets for the given type in the background
+	template<typename T>
+	QFuture<QList<T>> loadAllAsync() const;
+	//! Loads the dataset with the given key for the given type in the background
+	template<typename T>
+	QFuture<T> loadAsync(const QString &key) const;
+	//! Saves the given dataset in the store in the background
+	template<typename T>
+	QFuture<void> saveAsync(const T &value);
+	//! Searches the store in the background for datasets of the given type where the key matches the query
+	template<typename T>
+	QFuture<QList<T>> searchAsync(const QString &query, SearchMode mode = RegexpMode) const;
+
 Q_SIGNALS:
 	//! Is emitted whenever a dataset has been changed
 	void dataChanged(int metaTypeId, const QString &key, bool deleted, QPrivateSignal);
@@ -130,7 +212,22 @@ protected:
 	void initStore(const QString &setupName);
 
 private:
+	//(store, future) -> result, runs on the store worker of the setup
+	using AsyncTask = std::function<QVariant(LocalStore*, const QFutureInterfaceBase &)>;
+
 	QScopedPointer<DataStorePrivate> d;
+
+	//(key, value), sorted by key. Used by the DataStoreModel, which needs the keys of the page
+	QList<QPair<QString, QVariant>> loadPageEntries(int metaTypeId, const QString &after, int limit) const;
+
+	AsyncTask loadAllTask(int metaTypeId) const;
+	AsyncTask loadTask(int metaTypeId, const QString &key) const;
+	AsyncTask searchTask(int metaTypeId, const QString &query, SearchMode mode) const;
+	void enqueueAsync(const std::function<void(LocalStore*)> &task) const;
+	//deletes the objects of a result that never reaches the caller
+	static void discardAsyncResult(const QVariant &result);
+	template<typename TResult>
+	QFuture<TResult> runAsync(const AsyncTask &task, const std::function<TResult(QVariant)> &convert) const;
 };
 
 
@@ -268,6 +365,55 @@ T DataStore::load(const K &key) const
 	return load(qMetaTypeId<T>(), QVariant::fromValue(key)).template value<T>();
 }
 
+template<typename T>
+bool DataStore::tryLoad(const QString &key, T &value) const
+{
+	QTDATASYNC_STORE_ASSERT(T);
+	QVariant variant;
+	if(!tryLoad(qMetaTypeId<T>(), key, variant))
+		return false;
+	value = variant.template value<T>();
+	return true;
+}
+
+template<typename T>
+bool DataStore::contains(const QString &key) const
+{
+	QTDATASYNC_STORE_ASSERT(T);
+	return contains(qMetaTypeId<T>(), key);
+}
+
+template<typename T>
+QStringList DataStore::keys(int offset, int limit) const
+{
+	QTDATASYNC_STORE_ASSERT(T);
+	return keys(qMetaTypeId<T>(), offset, limit);
+}
+
+template<typename T>
+QList<T> DataStore::loadPage(const QString &after, int limit) const
+{
+	QTDATASYNC_STORE_ASSERT(T);
+	auto mList = loadPage(qMetaTypeId<T>(), after, limit);
+	QList<T> rList;
+	rList.reserve(mList.size());
+	for(auto v : mList)
+		rList.append(v.template value<T>());
+	return rList;
+}
+
+template<typename T>
+QList<T> DataStore::loadMany(const QStringList &keys) const
+{
+	QTDATASYNC_STORE_ASSERT(T);
+	auto mList = loadMany(qMetaTypeId<T>(), keys);
+	QList<T> rList;
+	rList.reserve(mList.size());
+	for(auto v : mList)
+		rList.append(v.template value<T>());
+	return rList;
+}
+
 template<typename T>
 void DataStore::save(const T &value)
 {
@@ -275,6 +421,17 @@ void DataStore::save(const T &value)
 	save(qMetaTypeId<T>(), QVariant::fromValue(value));
 }
 
+template<typename T>
+void DataStore::saveAll(const QList<T> &values)
+{
+	QTDATASYNC_STORE_ASSERT(T);
+	QVariantList vList;
+	vList.reserve(values.size());
+	for(const auto &value : values)
+		vList.append(QVariant::fromValue(value));
+	saveAll(qMetaTypeId<T>(), vList);
+}
+
 template<typename T>
 bool DataStore::remove(const QString &key)
 {
@@ -289,6 +446,13 @@ bool DataStore::remove(const K &key)
 	return remove(qMetaTypeId<T>(), QVariant::fromValue(key));
 }
 
+template<typename T>
+int DataStore::removeMany(const QStringList &keys)
+{
+	QTDATASYNC_STORE_ASSERT(T);
+	return removeMany(qMetaTypeId<T>(), keys);
+}
+
 template<typename T>
 void DataStore::update(T object) const
 {
@@ -296,6 +460,26 @@ void DataStore::update(T object) const
 	update(qMetaTypeId<T>(), object);
 }
 
+template<typename T>
+QList<T> DataStore::findBy(const QString &property, const QVariant &value) const
+{
+	QTDATASYNC_STORE_ASSERT(T);
+	QList<T> rList;
+	for(auto v : findBy(qMetaTypeId<T>(), property, value))
+		rList.append(v.template value<T>());
+	return rList;
+}
+
+template<typename T>
+QList<T> DataStore::fullTextSearch(const QString &query, int limit) const
+{
+	QTDATASYNC_STORE_ASSERT(T);
+	QList<T> rList;
+	for(auto v : fullTextSearch(qMetaTypeId<T>(), query, limit))
+		rList.append(v.template value<T>());
+	return rList;
+}
+
 template<typename T>
 QList<T> DataStore::search(const QString &query, SearchMode mode) const
 {
@@ -306,6 +490,15 @@ QList<T> DataStore::search(const QString &query, SearchMode mode) const
 	return rList;
 }
 
+template<typename T>
+void DataStore::search(const QString &query, const std::function<bool(T)> &iterator, SearchMode mode) const
+{
+	QTDATASYNC_STORE_ASSERT(T);
+	search(qMetaTypeId<T>(), query, [iterator](const QVariant &v) {
+		return iterator(v.template value<T>());
+	}, mode);
+}
+
 template<typename T>
 void DataStore::iterate(const std::function<bool (T)> &iterator) const
 {
@@ -322,6 +515,70 @@ void DataStore::clear()
 	clear(qMetaTypeId<T>());
 }
 
+template<typename T>
+QFuture<QList<T>> DataStore::loadAllAsync() const
+{
+	QTDATASYNC_STORE_ASSERT(T);
+	return runAsync<QList<T>>(loadAllTask(qMetaTypeId<T>()), [](const QVariant &v) {
+		QList<T> rList;
+		for(auto e : v.toList())
+			rList.append(e.template value<T>());
+		return rList;
+	});
+}
+
+template<typename T>
+QFuture<T> DataStore::loadAsync(const QString &key) const
+{
+	QTDATASYNC_STORE_ASSERT(T);
+	return runAsync<T>(loadTask(qMetaTypeId<T>(), key), [](const QVariant &v) {
+		return v.template value<T>();
+	});
+}
+
+template<typename T>
+QFuture<void> DataStore::saveAsync(const T &value)
+{
+	QTDATASYNC_STORE_ASSERT(T);
+	return saveAsync(qMetaTypeId<T>(), QVariant::fromValue(value));
+}
+
+template<typename T>
+QFuture<QList<T>> DataStore::searchAsync(const QString &query, SearchMode mode) const
+{
+	QTDATASYNC_STORE_ASSERT(T);
+	return runAsync<QList<T>>(searchTask(qMetaTypeId<T>(), query, mode), [](const QVariant &v) {
+		QList<T> rList;
+		for(auto e : v.toList())
+			rList.append(e.template value<T>());
+		return rList;
+	});
+}
+
+template<typename TResult>
+QFuture<TResult> DataStore::runAsync(const AsyncTask &task, const std::function<TResult(QVariant)> &convert) const
+{
+	QFutureInterface<TResult> futureInterface;
+	futureInterface.reportStarted();
+	auto future = futureInterface.future();
+	enqueueAsync([futureInterface, task, convert](LocalStore *store) mutable {
+		if(!futureInterface.isCanceled()) {
+			try {
+				const auto result = task(store, futureInterface);
+				futureInterface.reportResult(convert(result));
+				if(futureInterface.resultCount() == 0) //dropped, as the future was canceled meanwhile
+					discardAsyncResult(result);
+			} catch(QException &e) {
+				futureInterface.reportException(e);
+			} catch(std::exception &) {
+				futureInterface.reportException(QUnhandledException{});
+			}
+		}
+		futureInterface.reportFinished();
+	});
+	return future;
+}
+
 }
 
 #endif // QTDATASYNC_DATASTORE_H
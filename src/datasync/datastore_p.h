@@ -2,6 +2,7 @@
 #define QTDATASYNC_DATASTORE_P_H
 
 #include <QtCore/QPointer>
+#include <QtCore/QCache>
 
 #include "qtdatasync_global.h"
 #include "datastore.h"
@@ -17,13 +18,22 @@ class DataStorePrivate
 public:
 	DataStorePrivate(DataStore *q, const QString &setupName);
 
+	using ValueKey = QPair<int, QString>; //(metaTypeId, key)
+	struct CachedValue {
+		quint64 generation; //of the json data in the ObjectCache the value was deserialized from
+		QVariant value;
+	};
+
 	QByteArray typeName(int metaTypeId) const;
+	QPair<QString, QJsonObject> serialize(int metaTypeId, const QByteArray &typeName, QVariant value) const;
+	QVariant deserialize(int metaTypeId, const QString &key, const QJsonObject &data, quint64 generation, int size) const;
 
 	Defaults defaults;
 	Logger *logger;
 	QPointer<const QJsonSerializer> serializer;
 
 	LocalStore *store;
+	mutable QCache<ValueKey, CachedValue> valueCache; //gadgets only, costs are the stored size, see Setup::valueCacheSize
 };
 
 }
@@ -92,7 +92,7 @@ bool DataStoreModel::canFetchMore(const QModelIndex &parent) const
 	if(parent.isValid())
 		return false;
 	else
-		return d->dataHash.size() < d->keyList.size();
+		return !d->fetchedAll;
 }
 
 void DataStoreModel::fetchMore(const QModelIndex &parent)
@@ -102,19 +102,30 @@ void DataStoreModel::fetchMore(const QModelIndex &parent)
 	if(canFetchMore(parent)) {
 		d->isFetching = true;
 		try {
-			//load 100 at once
-			auto offset = d->dataHash.size();
-			auto max = qMin(offset + 100, d->keyList.size());
-			QVariantHash loadData;
+			//load 100 at once, continuing after the last fetched key
+			const auto limit = 100;
+			const auto page = d->store->loadPageEntries(d->type, d->lastKey, limit);
+			if(page.size() < limit)
+				d->fetchedAll = true;
 
-			for(auto i = offset; i < max; i++) {
-				auto key = d->keyList.value(i);
-				loadData.insert(key, d->store->load(d->type, key));
+			QStringList loadKeys;
+			QVariantHash loadData;
+			for(const auto &entry : page) {
+				if(d->dataHash.contains(entry.first)) //was added via a change notification
+					continue;
+				loadKeys.append(entry.first);
+				loadData.insert(entry.first, entry.second);
+			}
+			if(!page.isEmpty())
+				d->lastKey = page.last().first;
+
+			if(!loadKeys.isEmpty()) {
+				auto offset = d->keyList.size();
+				beginInsertRows(parent, offset, offset + loadKeys.size() - 1);
+				d->keyList.append(loadKeys);
+				d->dataHash.unite(loadData);//no duplicates thanks to logic
+				endInsertRows();
 			}
-
-			beginInsertRows(parent, offset, max - 1);
-			d->dataHash.unite(loadData);//no duplicates thanks to logic
-			endInsertRows();
 		} catch(QException &e) {
 			emit storeError(e, {});
 		}
@@ -261,19 +272,11 @@ void DataStoreModel::setTypeId(int typeId, bool resetColumns)
 
 		beginResetModel();
 		d->isObject = flags.testFlag(QMetaType::PointerToQObject);
-		d->keyList.clear();
 		if(resetColumns)
 			clearColumns();
-		d->clearHashObjects();
+		d->resetPaging();
 		d->createRoleNames();
-
-		try {
-			d->keyList = d->store->keys(typeId);
-			endResetModel();
-		} catch(...) {
-			endResetModel();
-			throw;
-		}
+		endResetModel(); //rows are loaded page by page via fetchMore
 	} else
 		throw InvalidDataException(d->store->d->defaults, QMetaType::typeName(typeId), QStringLiteral("Type is neither a gadget nor a pointer to an object"));
 }
@@ -290,15 +293,8 @@ void DataStoreModel::setEditable(bool editable)
 void DataStoreModel::reload()
 {
 	beginResetModel();
-	d->keyList.clear();
-	d->clearHashObjects();
-	try {
-		d->keyList = d->store->keys(d->type);
-		endResetModel();
-	} catch(QException &e) {
-		endResetModel();
-		emit storeError(e, {});
-	}
+	d->resetPaging();
+	endResetModel();
 }
 
 void DataStoreModel::storeChanged(int metaTypeId, const QString &key, bool wasDeleted)
@@ -308,46 +304,45 @@ void DataStoreModel::storeChanged(int metaTypeId, const QString &key, bool wasDe
 
 	if(wasDeleted) {
 		auto index = d->keyList.indexOf(key);
-		if(index != -1) {
-			if(index < d->dataHash.size()) { //is already fetched
-				beginRemoveRows(QModelIndex(), index, index);
-				d->keyList.removeAt(index);
-				d->deleteObject(d->dataHash.take(key));
-				endRemoveRows();
-			} else //not fetched yet -> no signals needed
-				d->keyList.removeAt(index);
-		} //else no need to remove something already not existing
+		if(index != -1) { //is already fetched
+			beginRemoveRows(QModelIndex(), index, index);
+			d->keyList.removeAt(index);
+			d->deleteObject(d->dataHash.take(key));
+			endRemoveRows();
+		} //else not fetched yet or not existing -> nothing to remove
 	} else {
 		auto index = d->keyList.indexOf(key);
-		if(index != -1) { //key already know
-			if(index < d->dataHash.size()) { //not fully loaded -> only load if already fetched
-				try {
-					if(d->isObject) {
-						auto obj = d->dataHash.value(key).value<QObject*>();
-						d->store->update(d->type, obj);
-					} else
-						d->dataHash.insert(key, d->store->load(d->type, key));
-					auto mIndex = idIndex(key);
-					emit dataChanged(mIndex, mIndex.sibling(mIndex.row(), (d->columns.isEmpty() ? 0 : d->columns.size() - 1)));
-				} catch(QException &e) {
-					emit storeError(e, {});
-				}
+		if(index != -1) { //key already fetched -> reload it
+			try {
+				if(d->isObject) {
+					auto obj = d->dataHash.value(key).value<QObject*>();
+					d->store->update(d->type, obj);
+				} else
+					d->dataHash.insert(key, d->store->load(d->type, key));
+				auto mIndex = idIndex(key);
+				emit dataChanged(mIndex, mIndex.sibling(mIndex.row(), (d->columns.isEmpty() ? 0 : d->columns.size() - 1)));
+			} catch(QException &e) {
+				emit storeError(e, {});
 			}
-		} else { //key unknown -> append it
-			if(d->keyList.size() == d->dataHash.size()) { //already fully loaded -> needs to be loaded as well
-				d->keyList.append(key);
-				fetchMore(QModelIndex());//simply call fetch more does the loading
-			} else //only append
+		} else if(d->fetchedAll || key.toUtf8() <= d->lastKey.toUtf8()) { //key unknown, but within the fetched range -> append it (SQLite sorts by the UTF-8 bytes)
+			try {
+				auto value = d->store->load(d->type, key);
+				auto offset = d->keyList.size();
+				beginInsertRows(QModelIndex(), offset, offset);
 				d->keyList.append(key);
-		}
+				d->dataHash.insert(key, value);
+				endInsertRows();
+			} catch(QException &e) {
+				emit storeError(e, {});
+			}
+		} //else the key will be part of a later page
 	}
 }
 
 void DataStoreModel::storeResetted()
 {
 	beginResetModel();
-	d->keyList.clear();
-	d->clearHashObjects();
+	d->resetPaging();
 	endResetModel();
 }
 
@@ -359,7 +354,15 @@ DataStoreModelPrivate::DataStoreModelPrivate(DataStoreModel *q_ptr) :
 
 QStringList DataStoreModelPrivate::activeKeys()
 {
-	return keyList.mid(0, dataHash.size());
+	return keyList;
+}
+
+void DataStoreModelPrivate::resetPaging()
+{
+	keyList.clear();
+	clearHashObjects();
+	lastKey.clear();
+	fetchedAll = false;
 }
 
 void DataStoreModelPrivate::createRoleNames()
@@ -20,8 +20,10 @@ public:
 	bool isObject = false;
 	QHash<int, QByteArray> roleNames;
 
-	QStringList keyList;
+	QStringList keyList; //only fetched keys, in row order
 	QVariantHash dataHash;
+	QString lastKey; //largest key fetched via paging, the next page continues after it
+	bool fetchedAll = false;
 
 	QStringList columns;
 	QHash<int, QHash<int, QByteArray>> roleMapping; //column -> (role -> property)
@@ -30,6 +32,7 @@ public:
 
 	QStringList activeKeys();
 
+	void resetPaging();
 	void createRoleNames();
 	void clearHashObjects();
 	void deleteObject(const QVariant &value);
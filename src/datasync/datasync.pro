@@ -41,7 +41,17 @@ HEADERS += \
 	migrationhelper.h \
 	migrationhelper_p.h \
 	remoteconfig.h \
-	remoteconfig_p.h
+	remoteconfig_p.h \
+	databaseconfig.h \
+	databaseconfig_p.h \
+	cachestatistics.h \
+	cachestatistics_p.h \
+	datacodec.h \
+	datacodec_p.h \
+	storeworker_p.h \
+	writejournal_p.h \
+	objectcache_p.h \
+	accesstracker_p.h
 
 SOURCES += \
 	localstore.cpp \
@@ -71,7 +81,14 @@ SOURCES += \
 	emitteradapter.cpp \
 	changeemitter.cpp \
 	migrationhelper.cpp \
-	remoteconfig.cpp
+	remoteconfig.cpp \
+	databaseconfig.cpp \
+	cachestatistics.cpp \
+	datacodec.cpp \
+	storeworker.cpp \
+	writejournal.cpp \
+	objectcache.cpp \
+	accesstracker.cpp
 
 STATECHARTS += \
 	connectorstatemachine.scxml
@@ -5,6 +5,8 @@
 #include "exchangeengine_p.h"
 #include "changeemitter_p.h"
 #include "emitteradapter_p.h"
+#include "storeworker_p.h"
+#include "databaseconfig.h"
 
 #include <QtCore/QThread>
 #include <QtCore/QStandardPaths>
@@ -131,12 +133,32 @@ EmitterAdapter *Defaults::createEmitter(QObject *parent) const
 		emitter = d->passiveEmitter;
 	else
 		emitter = SetupPrivate::engine(d->setupName)->emitter();
-	return new EmitterAdapter(emitter, d->cacheInfo, parent);
+	return new EmitterAdapter(emitter, d->objectCache, parent);
 }
 
 QVariant Defaults::cacheHandle() const
 {
-	return QVariant::fromValue(d->cacheInfo);
+	return QVariant::fromValue(d->objectCache);
+}
+
+StoreWorker *Defaults::storeWorker() const
+{
+	return d->acquireStoreWorker(*this);
+}
+
+WriteJournal *Defaults::writeJournal() const
+{
+	return d->writeJournal.data();
+}
+
+AccessTracker *Defaults::accessTracker() const
+{
+	return d->accessTracker.data();
+}
+
+UnsyncedFiles *Defaults::unsyncedFiles() const
+{
+	return &(d->unsyncedFiles);
 }
 
 // ------------- DatabaseRef -------------
@@ -184,6 +206,11 @@ QSqlDatabase *DatabaseRef::operator->() const
 	return &(d->db());
 }
 
+QSqlQuery DatabaseRef::preparedQuery(int statementId, const QString &statement) const
+{
+	return d->preparedQuery(statementId, statement);
+}
+
 // ------------- PRIVATE IMPLEMENTATION Defaults -------------
 
 #undef QTDATASYNC_LOG
@@ -218,6 +245,7 @@ void DefaultsPrivate::createDefaults(const QString &setupName, bool isPassive, c
 
 void DefaultsPrivate::removeDefaults(const QString &setupName)
 {
+	stopStoreWorker(setupName); //the worker references the defaults, so it must go first
 	QMutexLocker _(&setupDefaultsMutex);
 	QWeakPointer<DefaultsPrivate> weakRef;
 	{
@@ -234,6 +262,27 @@ void DefaultsPrivate::removeDefaults(const QString &setupName)
 	}
 }
 
+void DefaultsPrivate::stopStoreWorker(const QString &setupName)
+{
+	StoreWorker *worker = nullptr;
+	{
+		QMutexLocker _(&setupDefaultsMutex);
+		auto d = setupDefaults.value(setupName);
+		if(!d)
+			return;
+		QMutexLocker _w(&d->workerMutex);
+		d->workerStopped = true;
+		worker = d->storeWorker;
+		d->storeWorker = nullptr;
+	}
+
+	//stop without holding any lock, pending tasks may still need them
+	if(worker) {
+		worker->stop();
+		delete worker;
+	}
+}
+
 QSharedPointer<DefaultsPrivate> DefaultsPrivate::obtainDefaults(const QString &setupName)
 {
 	QMutexLocker _(&setupDefaultsMutex);
@@ -272,7 +321,23 @@ DefaultsPrivate::DefaultsPrivate(QString setupName, QDir storageDir, QUrl roAddr
 	//create cache
 	auto maxSize = properties.value(Defaults::CacheSize).toInt();
 	if(maxSize > 0)
-		cacheInfo = QSharedPointer<EmitterAdapter::CacheInfo>::create(maxSize);
+		objectCache = QSharedPointer<ObjectCache>::create(maxSize);
+
+	//create write behind journal
+	auto writeBehindDelay = this->properties.value(Defaults::WriteBehindDelay).toInt();
+	if(writeBehindDelay > 0)
+		writeJournal.reset(new WriteJournal{writeBehindDelay, this->properties.value(Defaults::WriteBehindLimit).toInt()});
+
+	//create access tracker, counts more keys than preloaded to find the most used ones reliably
+	QHash<QByteArray, int> trackedTypes;
+	const auto preloads = this->properties.value(Defaults::CachePreloads).toHash();
+	for(auto it = preloads.constBegin(); it != preloads.constEnd(); it++) {
+		const auto preload = it->toList();
+		if(preload.value(0).toInt() == Setup::PreloadMostUsed)
+			trackedTypes.insert(it.key().toUtf8(), qMax(4 * preload.value(1).toInt(), 16));
+	}
+	if(!trackedTypes.isEmpty())
+		accessTracker.reset(new AccessTracker{trackedTypes});
 }
 
 DefaultsPrivate::~DefaultsPrivate()
@@ -324,6 +389,9 @@ QSqlDatabase DefaultsPrivate::acquireDatabase()
 		QSqlQuery pragmaForeignKeys(database);
 		if(!pragmaForeignKeys.exec(QStringLiteral("PRAGMA foreign_keys = ON")))
 			logWarning() << "Failed to enable foreign_keys support";
+
+		//apply the user configuration
+		configureDatabase(database);
 	}
 
 	return QSqlDatabase::database(name);
@@ -331,12 +399,27 @@ QSqlDatabase DefaultsPrivate::acquireDatabase()
 
 void DefaultsPrivate::releaseDatabase()
 {
-	if(--(dbRefHash.localData()[setupName]) == 0) {
+	auto &holder = dbRefHash.localData();
+	if(--(holder[setupName]) == 0) {
 		logDebug() << "Releasing database for thread" << QThread::currentThread();
+		holder.queries.remove(setupName); //statements must be gone before the connection
 		releaseDatabaseImpl(setupName);
 	}
 }
 
+QSqlQuery DefaultsPrivate::preparedQuery(const QSqlDatabase &database, int statementId, const QString &statement)
+{
+	auto &queries = dbRefHash.localData().queries[setupName];
+	auto it = queries.constFind(statementId);
+	if(it != queries.constEnd() && !it->isActive()) //active means it is currently in use (nested call)
+		return *it;
+
+	QSqlQuery query(database);
+	if(query.prepare(statement) && it == queries.constEnd())
+		queries.insert(statementId, query);
+	return query;
+}
+
 QRemoteObjectNode *DefaultsPrivate::acquireNode()
 {
 	auto cThread = QThread::currentThread();
@@ -358,6 +441,18 @@ QRemoteObjectNode *DefaultsPrivate::acquireNode()
 	return node;
 }
 
+StoreWorker *DefaultsPrivate::acquireStoreWorker(const Defaults &defaults)
+{
+	QMutexLocker _(&workerMutex);
+	if(workerStopped)
+		throw SetupDoesNotExistException(setupName);
+	if(!storeWorker) {
+		logDebug() << "Starting store worker for async operations";
+		storeWorker = new StoreWorker{defaults};
+	}
+	return storeWorker;
+}
+
 void DefaultsPrivate::roThreadDone()
 {
 	auto cThread = qobject_cast<QThread*>(sender());
@@ -382,6 +477,42 @@ void DefaultsPrivate::makePassive()
 	}
 }
 
+void DefaultsPrivate::configureDatabase(const QSqlDatabase &database)
+{
+	const auto config = properties.value(Defaults::DatabaseConfiguration).value<DatabaseConfig>();
+
+	//journal mode is persistent, so only switch if needed
+	QSqlQuery pragmaJournal(database);
+	if(!pragmaJournal.exec(QStringLiteral("PRAGMA journal_mode")) || !pragmaJournal.first())
+		logWarning() << "Failed to read journal_mode";
+	else {
+		auto isWal = pragmaJournal.value(0).toString().toLower() == QStringLiteral("wal");
+		if(isWal != config.writeAheadLog()) {
+			auto mode = config.writeAheadLog() ? QStringLiteral("WAL") : QStringLiteral("DELETE");
+			if(!pragmaJournal.exec(QStringLiteral("PRAGMA journal_mode = %1").arg(mode)) ||
+			   !pragmaJournal.first() ||
+			   pragmaJournal.value(0).toString().toUpper() != mode)
+				logWarning() << "Failed to set journal_mode to" << mode;
+			else
+				logDebug() << "Changed journal_mode to" << mode;
+		}
+	}
+
+	//connection specific options
+	QStringList pragmas {
+		QStringLiteral("PRAGMA synchronous = %1").arg(config.syncLevel()),
+		QStringLiteral("PRAGMA mmap_size = %1").arg(config.mmapSize()),
+		QStringLiteral("PRAGMA temp_store = %1").arg(config.tempStore())
+	};
+	if(config.cacheSize() > 0) //negative values are interpreted as KiB by sqlite
+		pragmas.append(QStringLiteral("PRAGMA cache_size = -%1").arg(config.cacheSize()));
+	for(const auto &pragma : pragmas) {
+		QSqlQuery pragmaQuery(database);
+		if(!pragmaQuery.exec(pragma))
+			logWarning() << "Failed to execute" << pragma << "with error:" << pragmaQuery.lastError().text();
+	}
+}
+
 void DefaultsPrivate::releaseDatabaseImpl(const QString &name)
 {
 	auto dbName = DefaultsPrivate::DatabaseName
@@ -394,6 +525,7 @@ void DefaultsPrivate::releaseDatabaseImpl(const QString &name)
 
 DefaultsPrivate::DatabaseHolder::~DatabaseHolder()
 {
+	queries.clear();
 	for(auto it = constBegin(); it != constEnd(); it++) {
 		if(*it <= 0)
 			continue;
@@ -429,6 +561,11 @@ QSqlDatabase &DatabaseRefPrivate::db()
 	return _database;
 }
 
+QSqlQuery DatabaseRefPrivate::preparedQuery(int statementId, const QString &statement)
+{
+	return _defaultsPrivate->preparedQuery(db(), statementId, statement);
+}
+
 bool DatabaseRefPrivate::eventFilter(QObject *watched, QEvent *event)
 {
 	if(event->type() == QEvent::ThreadChange && watched == _object) {
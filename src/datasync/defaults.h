@@ -15,6 +15,7 @@
 #include "QtDataSync/setup.h"
 
 class QSqlDatabase;
+class QSqlQuery;
 class QJsonSerializer;
 
 namespace QtDataSync {
@@ -22,6 +23,10 @@ namespace QtDataSync {
 class Logger;
 class Defaults;
 class EmitterAdapter;
+class StoreWorker;
+class WriteJournal;
+class AccessTracker;
+struct UnsyncedFiles;
 
 class DatabaseRefPrivate;
 //! A wrapper around QSqlDatabase to manage the connections
@@ -49,6 +54,9 @@ public:
 	//! Arrow operator to access the database
 	QSqlDatabase *operator->() const;
 
+	//! @private
+	QSqlQuery preparedQuery(int statementId, const QString &statement) const;
+
 private:
 	QScopedPointer<DatabaseRefPrivate> d;
 };
@@ -74,7 +82,21 @@ public:
 		CryptScheme, //!< @copybrief Setup::encryptionScheme
 		CryptKeyParam, //!< @copybrief Setup::encryptionKeyParam
 		SymScheme, //!< @copybrief Setup::cipherScheme
-		SymKeyParam //!< @copybrief Setup::cipherKeySize
+		SymKeyParam, //!< @copybrief Setup::cipherKeySize
+		InlineDataLimit, //!< @copybrief Setup::inlineDataLimit
+		DatabaseConfiguration, //!< @copybrief Setup::databaseConfiguration
+		PropertyIndexes, //!< @copybrief Setup::addIndex(int, const QString &)
+		FullTextIndexes, //!< @copybrief Setup::addFullTextIndex(int, const QStringList &)
+		SegmentSize, //!< @copybrief Setup::segmentSize
+		CompactionThreshold, //!< @copybrief Setup::compactionThreshold
+		CompressionCodec, //!< @copybrief Setup::compressionCodec
+		CompressionThreshold, //!< @copybrief Setup::compressionThreshold
+		TypeCompressionCodecs, //!< @copybrief Setup::setTypeCompressionCodec(int, const QString &)
+		WriteBehindDelay, //!< @copybrief Setup::writeBehindDelay
+		WriteBehindLimit, //!< @copybrief Setup::writeBehindLimit
+		Durability, //!< @copybrief Setup::durability
+		ValueCacheSize, //!< @copybrief Setup::valueCacheSize
+		CachePreloads //!< @copybrief Setup::setCachePreload(int, CachePreload, int)
 	};
 	Q_ENUM(PropertyKey)
 
@@ -124,6 +146,14 @@ public:
 	EmitterAdapter *createEmitter(QObject *parent = nullptr) const;
 	//! @private
 	QVariant cacheHandle() const;
+	//! @private
+	StoreWorker *storeWorker() const;
+	//! @private
+	WriteJournal *writeJournal() const;
+	//! @private
+	AccessTracker *accessTracker() const;
+	//! @private
+	UnsyncedFiles *unsyncedFiles() const;
 
 private:
 	QSharedPointer<DefaultsPrivate> d;
@@ -3,8 +3,10 @@
 
 #include <QtCore/QMutex>
 #include <QtCore/QThreadStorage>
+#include <QtCore/QSet>
 
 #include <QtSql/QSqlDatabase>
+#include <QtSql/QSqlQuery>
 
 #include <QtJsonSerializer/QJsonSerializer>
 
@@ -14,12 +16,24 @@
 #include "logger.h"
 #include "conflictresolver.h"
 #include "emitteradapter_p.h"
+#include "writejournal_p.h"
+#include "accesstracker_p.h"
 
 class ChangeEmitterReplica;
 
 namespace QtDataSync {
 
 class ChangeEmitter;
+class StoreWorker;
+
+//files written without flushing them, see Setup::Normal
+//no export needed
+struct UnsyncedFiles
+{
+	QMutex lock;
+	QSet<QString> paths; //files and their directories
+	QSet<QString> obsolete; //unreferenced data files that could not be removed, see LocalStore::compactSegments
+};
 
 //no exports needed
 class DatabaseRefPrivate : public QObject
@@ -29,6 +43,7 @@ public:
 	~DatabaseRefPrivate() override;
 
 	QSqlDatabase &db();
+	QSqlQuery preparedQuery(int statementId, const QString &statement);
 	bool eventFilter(QObject *watched, QEvent *event) override;
 
 private:
@@ -54,6 +69,7 @@ public:
 							   QJsonSerializer *serializer,
 							   ConflictResolver *resolver);
 	static void removeDefaults(const QString &setupName);
+	static void stopStoreWorker(const QString &setupName);
 	static QSharedPointer<DefaultsPrivate> obtainDefaults(const QString &setupName);
 
 	DefaultsPrivate(QString setupName,
@@ -66,8 +82,10 @@ public:
 
 	QSqlDatabase acquireDatabase();
 	void releaseDatabase();
+	QSqlQuery preparedQuery(const QSqlDatabase &database, int statementId, const QString &statement);
 
 	QRemoteObjectNode *acquireNode();
+	StoreWorker *acquireStoreWorker(const Defaults &defaults);
 
 public Q_SLOTS:
 	void roThreadDone();
@@ -81,9 +99,11 @@ private Q_SLOTS:
 
 private:
 	static void releaseDatabaseImpl(const QString &name);
+	void configureDatabase(const QSqlDatabase &database);
 
 	struct DatabaseHolder : public QHash<QString, quint64>
 	{
+		QHash<QString, QHash<int, QSqlQuery>> queries; //prepared statements per setup connection
 		~DatabaseHolder();
 	};
 
@@ -102,9 +122,16 @@ private:
 	QMutex roMutex;
 	QHash<QThread*, QRemoteObjectNode*> roNodes;
 
-	QSharedPointer<EmitterAdapter::CacheInfo> cacheInfo;
+	QSharedPointer<ObjectCache> objectCache;
+	QScopedPointer<WriteJournal> writeJournal; //only if write behind is enabled
+	QScopedPointer<AccessTracker> accessTracker; //only if a type uses Setup::PreloadMostUsed
+	UnsyncedFiles unsyncedFiles;
 
 	ChangeEmitterReplica *passiveEmitter = nullptr;
+
+	QMutex workerMutex;
+	StoreWorker *storeWorker = nullptr; //created on first use, stopped before the setup goes away
+	bool workerStopped = false;
 };
 
 }
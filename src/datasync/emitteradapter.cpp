@@ -2,11 +2,11 @@
 #include "changeemitter_p.h"
 using namespace QtDataSync;
 
-EmitterAdapter::EmitterAdapter(QObject *changeEmitter, QSharedPointer<CacheInfo> cacheInfo, QObject *origin) :
+EmitterAdapter::EmitterAdapter(QObject *changeEmitter, QSharedPointer<ObjectCache> cache, QObject *origin) :
 	QObject{origin},
 	_isPrimary{changeEmitter->metaObject()->inherits(&ChangeEmitter::staticMetaObject)},
 	_emitterBackend{changeEmitter},
-	_cache{std::move(cacheInfo)}
+	_cache{std::move(cache)}
 {
 	if(_isPrimary) {
 		connect(_emitterBackend, SIGNAL(dataChanged(QObject*,QtDataSync::ObjectKey,bool)),
@@ -45,6 +45,29 @@ void EmitterAdapter::triggerChange(const ObjectKey &key, bool deleted, bool chan
 	}
 }
 
+void EmitterAdapter::triggerChanges(const QByteArray &typeName, const QStringList &ids, bool deleted, bool changed)
+{
+	if(_isPrimary) {
+		QMetaObject::invokeMethod(_emitterBackend, "triggerChanges",
+								  Qt::QueuedConnection,
+								  Q_ARG(QObject*, parent()),
+								  Q_ARG(QByteArray, typeName),
+								  Q_ARG(QStringList, ids),
+								  Q_ARG(bool, deleted),
+								  Q_ARG(bool, changed));
+		for(const auto &id : ids)
+			emit dataChanged({typeName, id}, deleted);//own change
+	} else {
+		QMetaObject::invokeMethod(_emitterBackend, "triggerRemoteChanges",
+								  Qt::QueuedConnection,
+								  Q_ARG(QByteArray, typeName),
+								  Q_ARG(QStringList, ids),
+								  Q_ARG(bool, deleted),
+								  Q_ARG(bool, changed));
+		//no change signal, because operating in passive setup
+	}
+}
+
 void EmitterAdapter::triggerClear(const QByteArray &typeName, const QStringList &ids)
 {
 	if(_isPrimary) {
@@ -84,13 +107,12 @@ void EmitterAdapter::triggerUpload()
 							  Qt::QueuedConnection);
 }
 
-void EmitterAdapter::putCached(const ObjectKey &key, const QJsonObject &data, int costs)
+quint64 EmitterAdapter::putCached(const ObjectKey &key, const QJsonObject &data, int costs)
 {
-	if(!_cache)
-		return;
-
-	QWriteLocker _(&_cache->lock);
-	_cache->cache.insert(key, new QJsonObject(data), costs);
+	quint64 generation = 0;
+	if(_cache)
+		_cache->insert(key, data, costs, &generation);
+	return generation;
 }
 
 void EmitterAdapter::putCached(const QList<ObjectKey> &keys, const QList<QJsonObject> &data, const QList<int> &costs)
@@ -100,58 +122,47 @@ void EmitterAdapter::putCached(const QList<ObjectKey> &keys, const QList<QJsonOb
 	if(!_cache)
 		return;
 
-	QWriteLocker _(&_cache->lock);
 	for(auto i = 0; i < keys.size(); i++)
-		_cache->cache.insert(keys[i], new QJsonObject(data[i]), costs[i]);
+		_cache->insert(keys[i], data[i], costs[i]);
 }
 
 bool EmitterAdapter::getCached(const ObjectKey &key, QJsonObject &data)
 {
 	if(!_cache)
 		return false;
+	return _cache->lookup(key, data);
+}
 
-	QReadLocker _(&_cache->lock);
-	auto json = _cache->cache.object(key);
-	if(json) {
-		data = *json;
-		return true;
-	} else
-		return false;
+ObjectCache::LookupResult EmitterAdapter::findCached(const ObjectKey &key, QJsonObject &data, quint64 &generation, int *costs)
+{
+	if(!_cache)
+		return ObjectCache::NotCached;
+	return _cache->find(key, data, generation, costs);
+}
+
+void EmitterAdapter::putMissing(const ObjectKey &key, quint64 generation)
+{
+	if(_cache)
+		_cache->insertMissing(key, generation);
 }
 
 bool EmitterAdapter::dropCached(const ObjectKey &key)
 {
 	if(!_cache)
 		return false;
-
-	//check if cached
-	{
-		QReadLocker _(&_cache->lock);
-		if(!_cache->cache.contains(key))
-			return false;
-	}
-
-	QWriteLocker _(&_cache->lock);
-	return _cache->cache.remove(key);
+	return _cache->remove(key);
 }
 
 void EmitterAdapter::dropCached(const QByteArray &typeName, const QStringList &ids)
 {
-	if(!_cache)
-		return;
-
-	QWriteLocker _(&_cache->lock);
-	for(const auto &id : ids)
-		_cache->cache.remove({typeName, id});
+	if(_cache)
+		_cache->remove(typeName, ids);
 }
 
 void EmitterAdapter::dropCached()
 {
-	if(!_cache)
-		return;
-
-	QWriteLocker _(&_cache->lock);
-	_cache->cache.clear();
+	if(_cache)
+		_cache->clear();
 }
 
 void EmitterAdapter::dataChangedImpl(QObject *origin, const ObjectKey &key, bool deleted)
@@ -168,33 +179,14 @@ void EmitterAdapter::dataResettedImpl(QObject *origin)
 
 void EmitterAdapter::remoteDataChangedImpl(const ObjectKey &key, bool deleted)
 {
-	if(_cache) {
-		auto contains = false;
-		//check if cached
-		{
-			QReadLocker _(&_cache->lock);
-			contains = _cache->cache.contains(key);
-		}
-		//if chached, remove
-		if(contains) {
-			QWriteLocker _(&_cache->lock);
-			_cache->cache.remove(key);
-		}
-	}
+	if(_cache)
+		_cache->remove(key, true);
 	emit dataChanged(key, deleted);
 }
 
 void EmitterAdapter::remoteDataResettedImpl()
 {
-	if(_cache) {
-		QWriteLocker _(&_cache->lock);
-		_cache->cache.clear();
-	}
+	if(_cache)
+		_cache->clear(true);
 	emit dataResetted();
 }
-
-
-
-EmitterAdapter::CacheInfo::CacheInfo(int maxSize) :
-	cache{maxSize}
-{}
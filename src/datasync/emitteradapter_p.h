@@ -2,12 +2,12 @@
 #define QTDATASYNC_EMITTERADAPTER_P_H
 
 #include <QtCore/QObject>
-#include <QtCore/QReadWriteLock>
-#include <QtCore/QCache>
+#include <QtCore/QSharedPointer>
 
 #include "qtdatasync_global.h"
 #include "objectkey.h"
 #include "defaults.h"
+#include "objectcache_p.h"
 
 namespace QtDataSync {
 
@@ -16,25 +16,21 @@ class Q_DATASYNC_EXPORT EmitterAdapter : public QObject
 	Q_OBJECT
 
 public:
-	struct Q_DATASYNC_EXPORT CacheInfo {
-		QReadWriteLock lock;
-		QCache<ObjectKey, QJsonObject> cache;
-
-		CacheInfo(int maxSize);
-	};
-
 	explicit EmitterAdapter(QObject *changeEmitter,
-							QSharedPointer<CacheInfo> cacheInfo,
+							QSharedPointer<ObjectCache> cache,
 							QObject *origin = nullptr);
 
 	void triggerChange(const QtDataSync::ObjectKey &key, bool deleted, bool changed);
+	void triggerChanges(const QByteArray &typeName, const QStringList &ids, bool deleted, bool changed);
 	void triggerClear(const QByteArray &typeName, const QStringList &ids);
 	void triggerReset();
 	void triggerUpload();
 
-	void putCached(const ObjectKey &key, const QJsonObject &data, int costs);
+	quint64 putCached(const ObjectKey &key, const QJsonObject &data, int costs); //generation of the cached data, 0 if not cached
 	void putCached(const QList<ObjectKey> &keys, const QList<QJsonObject> &data, const QList<int> &costs);
 	bool getCached(const ObjectKey &key, QJsonObject &data);
+	ObjectCache::LookupResult findCached(const ObjectKey &key, QJsonObject &data, quint64 &generation, int *costs = nullptr);
+	void putMissing(const ObjectKey &key, quint64 generation);
 	bool dropCached(const ObjectKey &key);
 	void dropCached(const QByteArray &typeName, const QStringList &ids);
 	void dropCached();
@@ -52,11 +48,11 @@ private Q_SLOTS:
 private:
 	bool _isPrimary;
 	QObject *_emitterBackend;
-	QSharedPointer<CacheInfo> _cache;
+	QSharedPointer<ObjectCache> _cache;
 };
 
 }
 
-Q_DECLARE_METATYPE(QSharedPointer<QtDataSync::EmitterAdapter::CacheInfo>)
+Q_DECLARE_METATYPE(QSharedPointer<QtDataSync::ObjectCache>)
 
 #endif // QTDATASYNC_EMITTERADAPTER_P_H
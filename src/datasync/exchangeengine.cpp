@@ -29,6 +29,13 @@ ExchangeEngine::ExchangeEngine(const QString &setupName, Setup::FatalErrorHandle
 
 ExchangeEngine::~ExchangeEngine()
 {
+	if(_localStore) {
+		try {
+			_localStore->checkpoint(true);
+		} catch(Exception &e) {
+			logWarning() << "Failed to flush data files on shutdown with error:" << e.what();
+		}
+	}
 	logDebug() << "Finalization completed";
 }
 
@@ -94,6 +101,24 @@ void ExchangeEngine::initialize()
 	logDebug() << "Beginning engine initialization";
 	try {
 		_localStore = new LocalStore(_defaults, this);
+		_localStore->recover();
+
+		//data files written without full durability are flushed to disk regularly
+		_checkpointTimer = new QTimer(this);
+		_checkpointTimer->setInterval(60 * 1000); //1 minute
+		connect(_checkpointTimer, &QTimer::timeout,
+				this, &ExchangeEngine::checkpointStore);
+		_checkpointTimer->start();
+
+		//data is migrated and segment files compacted in the background, once at startup and then regularly
+		_maintenanceTimer = new QTimer(this);
+		_maintenanceTimer->setInterval(10 * 60 * 1000); //10 minutes
+		connect(_maintenanceTimer, &QTimer::timeout,
+				this, &ExchangeEngine::maintainStore);
+		_maintenanceTimer->start();
+		//the cache is filled first, so preloaded data is available as soon as possible
+		QMetaObject::invokeMethod(this, "warmCache", Qt::QueuedConnection);
+		QMetaObject::invokeMethod(this, "maintainStore", Qt::QueuedConnection);
 
 		//change controller
 		connectController(_changeController);
@@ -191,6 +216,52 @@ void ExchangeEngine::resetAccount(bool keepData, bool clearConfig)
 	_remoteConnector->resetAccount(clearConfig);
 }
 
+void ExchangeEngine::warmCache()
+{
+	_localStore->warmCache();
+}
+
+void ExchangeEngine::maintainStore()
+{
+	try {
+		_localStore->migrateInlineData();
+	} catch(Exception &e) {
+		logWarning() << "Failed to migrate datasets to inline storage with error:" << e.what();
+	}
+
+	try {
+		_localStore->migrateFileLayout();
+	} catch(Exception &e) {
+		logWarning() << "Failed to move data files into sharded directories with error:" << e.what();
+	}
+
+	try {
+		_localStore->compactSegments();
+	} catch(Exception &e) {
+		logWarning() << "Failed to compact segment files with error:" << e.what();
+	}
+
+	//figures to tune Setup::cacheSize, only visible with debug logging
+	auto cache = _defaults.cacheHandle().value<QSharedPointer<ObjectCache>>();
+	if(cache) {
+		const auto statistics = cache->statistics();
+		logDebug() << "Cache statistics - hits:" << statistics.hits()
+				   << "misses:" << statistics.misses()
+				   << "evictions:" << statistics.evictions()
+				   << "invalidations:" << statistics.invalidations()
+				   << "size:" << statistics.totalCost() << "/" << statistics.maxCost();
+	}
+}
+
+void ExchangeEngine::checkpointStore()
+{
+	try {
+		_localStore->checkpoint();
+	} catch(Exception &e) {
+		logWarning() << "Failed to flush data files with error:" << e.what();
+	}
+}
+
 void ExchangeEngine::controllerError(const QString &errorMessage)
 {
 	_lastError = errorMessage;
@@ -408,6 +479,7 @@ void EngineThread::run()
 
 		// cleanup
 		_running = false;
+		DefaultsPrivate::stopStoreWorker(_name); //its store needs the engine
 		delete _engine;
 		_lockFile->unlock();
 		delete _lockFile;
@@ -5,6 +5,7 @@
 #include <QtCore/QAtomicPointer>
 #include <QtCore/QThread>
 #include <QtCore/QLockFile>
+#include <QtCore/QTimer>
 
 #include <QtRemoteObjects/QRemoteObjectHost>
 
@@ -83,6 +84,9 @@ private Q_SLOTS:
 	void controllerTimeout();
 	void remoteEvent(RemoteConnector::RemoteEvent event);
 	void uploadingChanged(bool uploading);
+	void warmCache();
+	void maintainStore();
+	void checkpointStore();
 
 	void addProgress(quint32 estimate);
 	void incrementProgress();
@@ -99,6 +103,8 @@ private:
 	Setup::FatalErrorHandler _fatalErrorHandler;
 
 	LocalStore *_localStore = nullptr;
+	QTimer *_maintenanceTimer = nullptr;
+	QTimer *_checkpointTimer = nullptr;
 
 	ChangeController *_changeController;
 	SyncController *_syncController;
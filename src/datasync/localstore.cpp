@@ -2,16 +2,40 @@
 #include "changecontroller_p.h"
 #include "synchelper_p.h"
 #include "emitteradapter_p.h"
+#include "datacodec_p.h"
+#include "storeworker_p.h"
+#include "writejournal_p.h"
+#include "accesstracker_p.h"
+#include "defaults_p.h"
 
 #include <QtCore/QUrl>
 #include <QtCore/QJsonDocument>
+#include <QtCore/QJsonArray>
 #include <QtCore/QTemporaryFile>
 #include <QtCore/QCoreApplication>
 #include <QtCore/QSaveFile>
 #include <QtCore/QRegularExpression>
+#include <QtCore/QSet>
+#include <QtCore/QSettings>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QDirIterator>
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+#include <QtCore/QCborValue>
+#include <QtCore/QCborMap>
+#include <QtCore/QCborStreamReader>
+#endif
 
 #include <QtSql/QSqlQuery>
 #include <QtSql/QSqlError>
+#include <QtSql/QSqlRecord>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#elif defined(Q_OS_WIN)
+#include <io.h>
+#endif
 
 using namespace QtDataSync;
 using std::function;
@@ -21,6 +45,146 @@ using std::make_tuple;
 #define QTDATASYNC_LOG _logger
 #define SCOPE_ASSERT() Q_ASSERT_X(scope.d->database.isValid(), Q_FUNC_INFO, "Cannot use SyncScope after committing it")
 
+namespace {
+
+// a statement from the per connection cache, that is reset again once it goes out of scope
+class PreparedQuery : public QSqlQuery
+{
+	Q_DISABLE_COPY(PreparedQuery)
+public:
+	inline PreparedQuery(const DatabaseRef &db, int statementId, const QString &statement) :
+		QSqlQuery{db.preparedQuery(statementId, statement)}
+	{}
+	inline ~PreparedQuery() {
+		finish();
+	}
+};
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+// the encoded "self describe cbor" tag every dataset starts with, to tell it apart from binary json
+const QByteArray CborSignature = QByteArrayLiteral("\xd9\xd9\xf7");
+
+QString readCborString(QCborStreamReader &reader)
+{
+	QString string;
+	auto result = reader.readString();
+	while(result.status == QCborStreamReader::Ok) {
+		string += result.data;
+		result = reader.readString();
+	}
+	return result.status == QCborStreamReader::EndOfString ? string : QString{};
+}
+
+QByteArray readCborBytes(QCborStreamReader &reader)
+{
+	QByteArray bytes;
+	auto result = reader.readByteArray();
+	while(result.status == QCborStreamReader::Ok) {
+		bytes += result.data;
+		result = reader.readByteArray();
+	}
+	return result.status == QCborStreamReader::EndOfString ? bytes : QByteArray{};
+}
+
+// parses directly into json values, without building a QCborValue tree first
+QJsonValue readCborValue(QCborStreamReader &reader)
+{
+	QJsonValue value{QJsonValue::Undefined};
+	switch(reader.type()) {
+	case QCborStreamReader::Map:
+	{
+		QJsonObject object;
+		if(!reader.enterContainer())
+			return value;
+		while(reader.lastError() == QCborError::NoError && reader.hasNext()) {
+			if(reader.isString()) {
+				const auto key = readCborString(reader);
+				object.insert(key, readCborValue(reader));
+			} else { //never written, skip the whole entry
+				reader.next();
+				reader.next();
+			}
+		}
+		if(reader.lastError() == QCborError::NoError)
+			reader.leaveContainer();
+		return object;
+	}
+	case QCborStreamReader::Array:
+	{
+		QJsonArray array;
+		if(!reader.enterContainer())
+			return value;
+		while(reader.lastError() == QCborError::NoError && reader.hasNext())
+			array.append(readCborValue(reader));
+		if(reader.lastError() == QCborError::NoError)
+			reader.leaveContainer();
+		return array;
+	}
+	case QCborStreamReader::String:
+		return readCborString(reader);
+	case QCborStreamReader::ByteArray: //same representation as QCborValue::toJsonValue
+		return QString::fromUtf8(readCborBytes(reader).toBase64(QByteArray::Base64UrlEncoding | QByteArray::OmitTrailingEquals));
+	case QCborStreamReader::Tag:
+		reader.next(); //tags are not part of json, only the tagged value is
+		return readCborValue(reader);
+	case QCborStreamReader::UnsignedInteger:
+	case QCborStreamReader::NegativeInteger:
+		value = static_cast<double>(reader.toInteger());
+		break;
+	case QCborStreamReader::Float16:
+		value = static_cast<double>(reader.toFloat16());
+		break;
+	case QCborStreamReader::Float:
+		value = static_cast<double>(reader.toFloat());
+		break;
+	case QCborStreamReader::Double:
+		value = reader.toDouble();
+		break;
+	case QCborStreamReader::SimpleType:
+		if(reader.isBool())
+			value = reader.toBool();
+		else if(reader.isNull())
+			value = QJsonValue{QJsonValue::Null};
+		break;
+	case QCborStreamReader::Invalid:
+		return value;
+	}
+	reader.next();
+	return value;
+}
+#endif
+
+// flushes a file or directory to disk, QFileDevice has no public API for that
+bool syncToDisk(const QString &path)
+{
+#ifdef Q_OS_UNIX
+	auto fd = ::open(QFile::encodeName(path).constData(), O_RDONLY);
+	if(fd == -1)
+		return !QFileInfo::exists(path); //removed in the meantime -> nothing to flush
+	auto ok = ::fsync(fd) == 0;
+	::close(fd);
+	return ok;
+#elif defined(Q_OS_WIN)
+	if(QFileInfo{path}.isDir()) //directory entries are journaled by NTFS
+		return true;
+	QFile file{path};
+	if(!file.open(QIODevice::ReadWrite))
+		return !file.exists();
+	return ::_commit(file.handle()) == 0;
+#else
+	Q_UNUSED(path)
+	return true;
+#endif
+}
+
+}
+
+const int LocalStore::SchemaVersion = 6;
+// stays well below SQLITE_MAX_VARIABLE_NUMBER (999) for older sqlite versions
+const int LocalStore::MaxBatchSize = 500;
+// below, a plain read is cheaper than setting up a mapping
+const qint64 LocalStore::MinMapSize = 64 * 1024;
+
 LocalStore::LocalStore(Defaults defaults, QObject *parent) :
 	QObject{parent},
 	_defaults{std::move(defaults)},
@@ -33,81 +197,380 @@ LocalStore::LocalStore(Defaults defaults, QObject *parent) :
 	connect(_emitter, &EmitterAdapter::dataResetted,
 			this, &LocalStore::dataResetted);
 
-	if(!_database->tables().contains(QStringLiteral("DataIndex"))) {
-		QSqlQuery createQuery(_database);
-		createQuery.prepare(QStringLiteral("CREATE TABLE IF NOT EXISTS DataIndex ("
-										   "	Type		TEXT NOT NULL,"
-										   "	Id			TEXT NOT NULL,"
-										   "	Version		INTEGER NOT NULL,"
-										   "	File		TEXT,"
-										   "	Checksum	BLOB,"
-										   "	Changed		INTEGER NOT NULL DEFAULT 1,"
-										   "	PRIMARY KEY(Type, Id)"
-										   ") WITHOUT ROWID;"));
-		if(!createQuery.exec()) {
-			throw LocalStoreException(_defaults,
-									  QByteArrayLiteral("any"),
-									  createQuery.executedQuery().simplified(),
-									  createQuery.lastError().text());
+	if(!_database->tables().contains(QStringLiteral("DataIndex")))
+		createDataTables();
+
+	if(!_database->tables().contains(QStringLiteral("PropertyIndex")) ||
+	   !_database->tables().contains(QStringLiteral("IndexedProperties")))
+		createIndexTables();
+
+	upgradeSchema();
+	updateIndexes();
+	updateFullTextIndexes();
+}
+
+LocalStore::~LocalStore() = default;
+
+QJsonObject LocalStore::readJson(const ObjectKey &key, const QString &fileName, int *costs) const
+{
+	if(!fileName.isEmpty())
+		return readJson(key, fileName, QByteArray(), costs);
+
+	//empty (but not null) file name: data is stored inline or in a segment
+	PreparedQuery dataQuery(_database, LoadDataStatement, QStringLiteral("SELECT Data, Segment, Offset, Length FROM DataIndex WHERE Type = ? AND Id = ? AND File IS NOT NULL"));
+	dataQuery.addBindValue(typeId(key.typeName));
+	dataQuery.addBindValue(key.id);
+	exec(dataQuery, key);
+
+	if(!dataQuery.first())
+		throw NoDataException(_defaults, key);
+	if(dataQuery.value(0).isNull()) {
+		return readSegment(key,
+						   dataQuery.value(1).toLongLong(),
+						   dataQuery.value(2).toLongLong(),
+						   dataQuery.value(3).toInt(),
+						   costs);
+	} else
+		return readJson(key, fileName, dataQuery.value(0).toByteArray(), costs);
+}
+
+void LocalStore::migrateInlineData()
+{
+	const auto inlineLimit = _defaults.property(Defaults::InlineDataLimit).toInt();
+	QScopedPointer<QSettings> settings{_defaults.createSettings(nullptr, QStringLiteral("store"))};
+	const auto lastLimit = settings->value(QStringLiteral("inlineLimit"), 0).toInt();
+	if(inlineLimit == lastLimit)
+		return;
+	else if(inlineLimit < lastLimit) { //smaller limits are applied lazily on the next save
+		settings->setValue(QStringLiteral("inlineLimit"), inlineLimit);
+		return;
+	}
+
+	//moved in small batches, so other connections can continue to write in between
+	auto moved = 0;
+	auto skipped = 0;
+	auto lastType = -1ll;
+	QString lastId;
+	forever {
+		QStringList obsoleteFiles;
+		auto batchSize = 0;
+		beginWriteTransaction();
+		try {
+			QSqlQuery filesQuery(_database);
+			filesQuery.prepare(QStringLiteral("SELECT DataIndex.Type, Types.Name, DataIndex.Id, DataIndex.File FROM DataIndex "
+											  "INNER JOIN Types ON Types.Id = DataIndex.Type "
+											  "WHERE DataIndex.File IS NOT NULL AND DataIndex.File != '' "
+											  "AND (DataIndex.Type > ? OR (DataIndex.Type = ? AND DataIndex.Id > ?)) "
+											  "ORDER BY DataIndex.Type, DataIndex.Id "
+											  "LIMIT ?"));
+			filesQuery.addBindValue(lastType);
+			filesQuery.addBindValue(lastType);
+			filesQuery.addBindValue(lastId);
+			filesQuery.addBindValue(MaxBatchSize);
+			exec(filesQuery);
+
+			//files above the limit stay, so the batch continues after the last row instead of starting over
+			QList<QPair<ObjectKey, QString>> candidates;
+			while(filesQuery.next()) {
+				lastType = filesQuery.value(0).toLongLong();
+				lastId = filesQuery.value(2).toString();
+				++batchSize;
+				ObjectKey key {filesQuery.value(1).toByteArray(), lastId};
+				auto path = filePath(key, filesQuery.value(3).toString());
+				if(QFileInfo(path).size() < inlineLimit)
+					candidates.append({key, path});
+			}
+
+			QSqlQuery inlineQuery(_database);
+			inlineQuery.prepare(QStringLiteral("UPDATE DataIndex SET File = '', Data = ? WHERE Type = ? AND Id = ?"));
+			for(const auto &candidate : qAsConst(candidates)) {
+				QFile file(candidate.second);
+				if(!file.open(QIODevice::ReadOnly)) {
+					//stays a file, the next save decides again
+					logWarning() << "Skipping unreadable data file" << file.fileName()
+								 << "with error:" << file.errorString();
+					++skipped;
+					continue;
+				}
+				inlineQuery.addBindValue(file.readAll());
+				file.close();
+				inlineQuery.addBindValue(knownTypeId(candidate.first));
+				inlineQuery.addBindValue(candidate.first.id);
+				exec(inlineQuery, candidate.first);
+				obsoleteFiles.append(file.fileName());
+			}
+
+			if(!_database->commit())
+				throw LocalStoreException(_defaults, QByteArray("<any>"), _database->databaseName(), _database->lastError().text());
+		} catch(...) {
+			_database->rollback();
+			throw;
 		}
-		logDebug() << "Created DataIndex table";
+
+		//files are only removed after the data was safely moved into the database
+		removeObsoleteFiles(obsoleteFiles);
+		moved += obsoleteFiles.size();
+		if(batchSize < MaxBatchSize)
+			break;
 	}
 
-	if(!_database->tables().contains(QStringLiteral("DeviceUploads"))) {
-		QSqlQuery createQuery(_database);
-		createQuery.prepare(QStringLiteral("CREATE TABLE IF NOT EXISTS DeviceUploads ( "
-										   "	Type	TEXT NOT NULL, "
-										   "	Id		TEXT NOT NULL, "
-										   "	Device	TEXT NOT NULL, "
-										   "	PRIMARY KEY(Type, Id, Device), "
-										   "	FOREIGN KEY(Type, Id) REFERENCES DataIndex ON DELETE CASCADE "
-										   ") WITHOUT ROWID;"));
-		if(!createQuery.exec()) {
-			throw LocalStoreException(_defaults,
-									  QByteArrayLiteral("any"),
-									  createQuery.executedQuery().simplified(),
-									  createQuery.lastError().text());
+	settings->setValue(QStringLiteral("inlineLimit"), inlineLimit);
+	if(moved > 0)
+		logDebug() << "Moved" << moved << "datasets into the database";
+	if(skipped > 0)
+		logWarning() << "Skipped" << skipped << "unreadable datasets while moving them into the database";
+}
+
+void LocalStore::compactSegments()
+{
+	//retry the data files that could not be removed after their commit
+	QSet<QString> obsolete;
+	{
+		auto unsynced = _defaults.unsyncedFiles();
+		QMutexLocker _(&unsynced->lock);
+		obsolete.swap(unsynced->obsolete);
+	}
+	if(!obsolete.isEmpty())
+		removeObsoleteFiles(obsolete.values());
+
+	const auto threshold = _defaults.property(Defaults::CompactionThreshold).toDouble();
+
+	QSqlQuery typesQuery(_database);
+	typesQuery.prepare(QStringLiteral("SELECT Name FROM Types WHERE Id IN (SELECT DISTINCT Type FROM DataIndex WHERE Segment IS NOT NULL)"));
+	exec(typesQuery);
+	QList<QByteArray> typeNames;
+	while(typesQuery.next())
+		typeNames.append(typesQuery.value(0).toByteArray());
+
+	for(const auto &typeName : qAsConst(typeNames))
+		compactSegments(typeName, threshold);
+}
+
+void LocalStore::migrateFileLayout()
+{
+	QScopedPointer<QSettings> settings{_defaults.createSettings(nullptr, QStringLiteral("store"))};
+	if(settings->value(QStringLiteral("shardedFiles"), false).toBool())
+		return;
+
+	//moved in small batches, so other connections can continue to write in between
+	auto moved = 0;
+	forever {
+		QStringList obsoleteFiles;
+		auto batchSize = 0;
+		beginWriteTransaction();
+		try {
+			QSqlQuery filesQuery(_database);
+			filesQuery.prepare(QStringLiteral("SELECT Types.Name, DataIndex.Id, DataIndex.File FROM DataIndex "
+											  "INNER JOIN Types ON Types.Id = DataIndex.Type "
+											  "WHERE DataIndex.File IS NOT NULL AND DataIndex.File != '' AND DataIndex.File NOT LIKE '%/%' "
+											  "LIMIT ?"));
+			filesQuery.addBindValue(MaxBatchSize);
+			exec(filesQuery);
+
+			QList<std::tuple<ObjectKey, QString>> candidates;
+			while(filesQuery.next()) {
+				candidates.append(std::make_tuple(ObjectKey{filesQuery.value(0).toByteArray(), filesQuery.value(1).toString()},
+												  filesQuery.value(2).toString()));
+			}
+			batchSize = candidates.size();
+
+			QSqlQuery moveQuery(_database);
+			moveQuery.prepare(QStringLiteral("UPDATE DataIndex SET File = ? WHERE Type = ? AND Id = ?"));
+			for(const auto &candidate : qAsConst(candidates)) {
+				const auto &key = std::get<0>(candidate);
+				const auto tableDir = typeDirectory(key);
+				const auto oldPath = filePath(tableDir, std::get<1>(candidate));
+				const auto newName = shardedName(std::get<1>(candidate));
+				const auto newPath = filePath(tableDir, newName);
+
+				//copied, not renamed, so readers of the old path are not affected until the commit
+				if(!tableDir.mkpath(QFileInfo(newPath).path()))
+					throw LocalStoreException(_defaults, key, newPath, QStringLiteral("Failed to create directory"));
+				QFile::remove(newPath); //leftover of a failed previous attempt
+				if(!QFile::copy(oldPath, newPath))
+					throw LocalStoreException(_defaults, key, oldPath, QStringLiteral("Failed to copy data file"));
+				if(durability() != Setup::Relaxed && !syncToDisk(newPath))
+					throw LocalStoreException(_defaults, key, newPath, QStringLiteral("Failed to flush data file to disk"));
+
+				moveQuery.addBindValue(newName);
+				moveQuery.addBindValue(typeId(key.typeName));
+				moveQuery.addBindValue(key.id);
+				exec(moveQuery, key);
+				obsoleteFiles.append(oldPath);
+			}
+
+			if(!_database->commit())
+				throw LocalStoreException(_defaults, QByteArray("<any>"), _database->databaseName(), _database->lastError().text());
+		} catch(...) {
+			_database->rollback();
+			throw;
+		}
+
+		for(const auto &file : qAsConst(obsoleteFiles)) {
+			if(!QFile::remove(file))
+				logWarning() << "Failed to remove migrated data file" << file;
 		}
-		logDebug() << "Created DeviceUploads table";
+		moved += obsoleteFiles.size();
+		if(batchSize < MaxBatchSize)
+			break;
 	}
+
+	settings->setValue(QStringLiteral("shardedFiles"), true);
+	if(moved > 0)
+		logDebug() << "Moved" << moved << "data files into sharded directories";
 }
 
-LocalStore::~LocalStore() = default;
+void LocalStore::recover()
+{
+	QScopedPointer<QSettings> settings{_defaults.createSettings(nullptr, QStringLiteral("store"))};
+	if(!settings->value(QStringLiteral("cleanShutdown"), true).toBool()) {
+		logWarning() << "Store was not shut down properly - checking data files";
+		repairDataFiles();
+	}
+	//with full durability, every written file is complete as soon as it is committed
+	settings->setValue(QStringLiteral("cleanShutdown"), durability() == Setup::Full);
+	settings->sync();
+}
 
-QJsonObject LocalStore::readJson(const ObjectKey &key, const QString &fileName, int *costs) const
+void LocalStore::checkpoint(bool shutdown)
 {
-	QFile file(filePath(key, fileName));
-	if(!file.open(QIODevice::ReadOnly))
-		throw LocalStoreException(_defaults, key, file.fileName(), file.errorString());
+	auto unsynced = _defaults.unsyncedFiles();
+	QSet<QString> paths;
+	auto failed = false;
+	{
+		QMutexLocker _(&unsynced->lock);
+		paths.swap(unsynced->paths);
+		//leftover files are only found again by repairDataFiles
+		failed = !unsynced->obsolete.isEmpty();
+	}
 
-	auto doc = QJsonDocument::fromBinaryData(file.readAll());
-	if(costs)
-		*costs = static_cast<int>(file.size());
-	file.close();
+	//files first, then the directories that reference them
+	for(auto dirs : {false, true}) {
+		for(const auto &path : qAsConst(paths)) {
+			if(QFileInfo{path}.isDir() == dirs && !syncToDisk(path)) {
+				logWarning() << "Failed to flush" << path << "to disk";
+				failed = true;
+			}
+		}
+	}
+	if(!paths.isEmpty())
+		logDebug() << "Flushed" << paths.size() << "data files and directories to disk";
+
+	//only claim a clean state if everything has been written. For relaxed durability, that is up to the operating system
+	if(shutdown && !failed) {
+		QScopedPointer<QSettings> settings{_defaults.createSettings(nullptr, QStringLiteral("store"))};
+		settings->setValue(QStringLiteral("cleanShutdown"), true);
+		settings->sync();
+	}
 
-	if(!doc.isObject())
-		throw LocalStoreException(_defaults, key, file.fileName(), QStringLiteral("File contains invalid json data"));
-	return doc.object();
+	storeAccessCounts();
+}
+
+void LocalStore::warmCache()
+{
+	const auto preloads = _defaults.property(Defaults::CachePreloads).toHash();
+	if(preloads.isEmpty() || _defaults.property(Defaults::CacheSize).toInt() <= 0)
+		return;
+
+	try {
+		QElapsedTimer timer;
+		timer.start();
+		auto tracker = _defaults.accessTracker();
+		if(tracker)
+			loadAccessCounts(tracker);
+
+		auto loaded = 0;
+		for(auto it = preloads.constBegin(); it != preloads.constEnd(); it++) {
+			const auto typeName = it.key().toUtf8();
+			const auto preload = it->toList();
+			switch(static_cast<Setup::CachePreload>(preload.value(0).toInt())) {
+			case Setup::PreloadAll:
+				loaded += loadAll(typeName).size();
+				break;
+			case Setup::PreloadMostUsed:
+				if(tracker)
+					loaded += loadMany(typeName, tracker->mostUsed(typeName, preload.value(1).toInt())).size();
+				break;
+			case Setup::PreloadNone:
+				break;
+			}
+		}
+		logDebug() << "Preloaded" << loaded << "datasets into the cache within" << timer.elapsed() << "ms";
+	} catch(Exception &e) {
+		logWarning() << "Failed to preload the cache with error:" << e.what();
+	}
 }
 
 quint64 LocalStore::count(const QByteArray &typeName) const
 {
-	QSqlQuery countQuery(_database);
-	countQuery.prepare(QStringLiteral("SELECT Count(*) FROM DataIndex WHERE Type = ? AND File IS NOT NULL"));
-	countQuery.addBindValue(typeName);
-	exec(countQuery, typeName);
+	const auto pending = pendingEntries(typeName);
+	PreparedQuery countQuery(_database, CountStatement, QStringLiteral("SELECT Objects FROM TypeStats WHERE Type = ?"));
+	countQuery.addBindValue(typeId(typeName));
+	if(pending.isEmpty()) {
+		exec(countQuery, typeName);
+		return countQuery.first() ? countQuery.value(0).toULongLong() : 0;
+	}
 
-	if(countQuery.first())
-		return countQuery.value(0).toULongLong();
+	//journaled saves only count if they are new. Read from one snapshot, in case the journal is written meanwhile
+	beginReadTransaction(typeName);
+	try {
+		exec(countQuery, typeName);
+		auto count = countQuery.first() ? countQuery.value(0).toULongLong() : 0;
+		countQuery.finish();
+
+		QStringList pendingIds;
+		pendingIds.reserve(pending.size());
+		for(auto it = pending.constBegin(); it != pending.constEnd(); it++)
+			pendingIds.append(it.key().id);
+		count += static_cast<quint64>(pendingIds.size() - storedIds(typeName, pendingIds).size());
+
+		if(!_database->commit())
+			throw LocalStoreException(_defaults, typeName, _database->databaseName(), _database->lastError().text());
+		return count;
+	} catch(...) {
+		_database->rollback();
+		throw;
+	}
+}
+
+quint64 LocalStore::storedSize(const QByteArray &typeName) const
+{
+	flushPending(typeName);
+	PreparedQuery sizeQuery(_database, StoredSizeStatement, QStringLiteral("SELECT Bytes FROM TypeStats WHERE Type = ?"));
+	sizeQuery.addBindValue(typeId(typeName));
+	exec(sizeQuery, typeName);
+
+	if(sizeQuery.first())
+		return sizeQuery.value(0).toULongLong();
 	else
 		return 0;
 }
 
 QStringList LocalStore::keys(const QByteArray &typeName) const
 {
-	QSqlQuery keysQuery(_database);
-	keysQuery.prepare(QStringLiteral("SELECT Id FROM DataIndex WHERE Type = ? AND File IS NOT NULL"));
-	keysQuery.addBindValue(typeName);
+	auto pending = pendingEntries(typeName);
+	PreparedQuery keysQuery(_database, KeysStatement, QStringLiteral("SELECT Id FROM DataIndex WHERE Type = ? AND File IS NOT NULL"));
+	keysQuery.addBindValue(typeId(typeName));
+	exec(keysQuery, typeName);
+
+	QStringList resList;
+	while(keysQuery.next()) {
+		resList.append(keysQuery.value(0).toString());
+		pending.remove({typeName, resList.last()});
+	}
+	//journaled saves that are new
+	for(auto it = pending.constBegin(); it != pending.constEnd(); it++)
+		resList.append(it.key().id);
+	return resList;
+}
+
+QStringList LocalStore::keys(const QByteArray &typeName, int offset, int limit) const
+{
+	flushPending(typeName);
+	PreparedQuery keysQuery(_database, KeysPageStatement, QStringLiteral("SELECT Id FROM DataIndex WHERE Type = ? AND File IS NOT NULL ORDER BY Id LIMIT ? OFFSET ?"));
+	keysQuery.addBindValue(typeId(typeName));
+	keysQuery.addBindValue(limit);
+	keysQuery.addBindValue(offset);
 	exec(keysQuery, typeName);
 
 	QStringList resList;
@@ -116,36 +579,115 @@ QStringList LocalStore::keys(const QByteArray &typeName) const
 	return resList;
 }
 
-QList<QJsonObject> LocalStore::loadAll(const QByteArray &typeName) const
+QList<QPair<QString, QJsonObject>> LocalStore::loadPage(const QByteArray &typeName, const QString &after, int limit) const
 {
-	//read transaction used to prevent writes while reading json files
+	flushPending(typeName);
+	//read transaction, so all rows come from one snapshot. Writers only remove files after their commit
 	beginReadTransaction(typeName);
 
 	try {
-		QSqlQuery loadQuery(_database);
-		loadQuery.prepare(QStringLiteral("SELECT Id, File FROM DataIndex WHERE Type = ? AND File IS NOT NULL"));
-		loadQuery.addBindValue(typeName);
+		//keyset pagination: continue after the last key, using the primary key index
+		PreparedQuery loadQuery(_database, LoadPageStatement, QStringLiteral("SELECT Id, File, Data FROM DataIndex WHERE Type = ? AND Id > ? AND File IS NOT NULL ORDER BY Id LIMIT ?"));
+		loadQuery.addBindValue(typeId(typeName));
+		loadQuery.addBindValue(after.isNull() ? QStringLiteral("") : after);
+		loadQuery.addBindValue(limit);
 		exec(loadQuery, typeName);
 
+		QList<QPair<QString, QJsonObject>> resList;
 		QList<ObjectKey> keys;
 		QList<QJsonObject> array;
 		QList<int> sizes;
 		while(loadQuery.next()) {
 			int size;
 			ObjectKey key {typeName, loadQuery.value(0).toString()};
-			auto json = readJson(key, loadQuery.value(1).toString(), &size);
+			auto json = readJson(key, loadQuery.value(1).toString(), loadQuery.value(2).toByteArray(), &size);
+			resList.append({key.id, json});
 			keys.append(key);
 			array.append(json);
 			sizes.append(size);
 		}
 
+		//commit db
+		if(!_database->commit())
+			throw LocalStoreException(_defaults, typeName, _database->databaseName(), _database->lastError().text());
 		_emitter->putCached(keys, array, sizes);
 
+		return resList;
+	} catch(...) {
+		_database->rollback();
+		throw;
+	}
+}
+
+void LocalStore::iterate(const QByteArray &typeName, const function<bool(ObjectKey, QJsonObject)> &visitor) const
+{
+	auto pending = pendingEntries(typeName);
+	PreparedQuery iterateQuery(_database, IterateStatement, QStringLiteral("SELECT Id, File, Data FROM DataIndex WHERE Type = ? AND File IS NOT NULL"));
+	iterateQuery.setForwardOnly(true);
+	iterateQuery.addBindValue(typeId(typeName));
+	if(pending.isEmpty()) {
+		streamRows(typeName, iterateQuery, visitor);
+		return;
+	}
+
+	//journaled saves replace the stored data, new ones are visited last
+	auto proceed = true;
+	streamRows(typeName, iterateQuery, [&](const ObjectKey &key, const QJsonObject &data) {
+		auto it = pending.find(key);
+		if(it == pending.end())
+			proceed = visitor(key, data);
+		else {
+			proceed = visitor(key, it->second);
+			pending.erase(it);
+		}
+		return proceed;
+	});
+	for(auto it = pending.constBegin(); proceed && it != pending.constEnd(); it++)
+		proceed = visitor(it.key(), it->second);
+}
+
+QList<QJsonObject> LocalStore::loadAll(const QByteArray &typeName) const
+{
+	auto pending = pendingEntries(typeName);
+	//read transaction, so all rows come from one snapshot. Writers only remove files after their commit
+	beginReadTransaction(typeName);
+
+	try {
+		PreparedQuery loadQuery(_database, LoadAllStatement, QStringLiteral("SELECT Id, File, Data FROM DataIndex WHERE Type = ? AND File IS NOT NULL"));
+		loadQuery.addBindValue(typeId(typeName));
+		exec(loadQuery, typeName);
+
+		QList<QJsonObject> resList;
+		QList<ObjectKey> keys;
+		QList<QJsonObject> array;
+		QList<int> sizes;
+		while(loadQuery.next()) {
+			ObjectKey key {typeName, loadQuery.value(0).toString()};
+			//saved again, but not written yet
+			auto it = pending.find(key);
+			if(it != pending.end()) {
+				resList.append(it->second);
+				pending.erase(it);
+				continue;
+			}
+
+			int size;
+			auto json = readJson(key, loadQuery.value(1).toString(), loadQuery.value(2).toByteArray(), &size);
+			resList.append(json);
+			keys.append(key);
+			array.append(json);
+			sizes.append(size);
+		}
+
 		//commit db
 		if(!_database->commit())
 			throw LocalStoreException(_defaults, typeName, _database->databaseName(), _database->lastError().text());
+		_emitter->putCached(keys, array, sizes);
 
-		return array;
+		//journaled saves that are new
+		for(auto it = pending.constBegin(); it != pending.constEnd(); it++)
+			resList.append(it->second);
+		return resList;
 	} catch(...) {
 		_database->rollback();
 		throw;
@@ -154,48 +696,206 @@ QList<QJsonObject> LocalStore::loadAll(const QByteArray &typeName) const
 
 QJsonObject LocalStore::load(const ObjectKey &key) const
 {
-	//check if cached
 	QJsonObject json;
-	if(_emitter->getCached(key, json))
-		return json;
+	if(!tryLoad(key, json))
+		throw NoDataException(_defaults, key);
+	return json;
+}
+
+bool LocalStore::tryLoad(const ObjectKey &key, QJsonObject &data) const
+{
+	quint64 generation;
+	int size;
+	return tryLoad(key, data, generation, size);
+}
+
+bool LocalStore::tryLoad(const ObjectKey &key, QJsonObject &data, quint64 &generation, int &size) const
+{
+	auto tracker = _defaults.accessTracker();
+	if(tracker && tracker->isTracked(key.typeName))
+		tracker->record(key);
+
+	generation = 0;
+	size = 0;
+	switch(lookupCached(key, data, generation, &size)) {
+	case ObjectCache::Cached:
+		return true;
+	case ObjectCache::Missing:
+		return false;
+	case ObjectCache::NotCached:
+		break;
+	}
 
 	if(!_database->transaction())
 		throw LocalStoreException(_defaults, key, _database->databaseName(), _database->lastError().text());
 
 	try {
-		QSqlQuery loadQuery(_database);
-		loadQuery.prepare(QStringLiteral("SELECT File FROM DataIndex WHERE Type = ? AND Id = ? AND File IS NOT NULL"));
-		loadQuery.addBindValue(key.typeName);
+		PreparedQuery loadQuery(_database, LoadStatement, QStringLiteral("SELECT File, Data FROM DataIndex WHERE Type = ? AND Id = ? AND File IS NOT NULL"));
+		loadQuery.addBindValue(typeId(key.typeName));
 		loadQuery.addBindValue(key.id);
 		exec(loadQuery, key);
 
-		if(loadQuery.first()) {
-			int size;
-			json = readJson(key, loadQuery.value(0).toString(), &size);
-			_emitter->putCached(key, json, size);
-		} else
-			throw NoDataException(_defaults, key);
+		auto found = loadQuery.first();
+		if(found) {
+			data = readJson(key, loadQuery.value(0).toString(), loadQuery.value(1).toByteArray(), &size);
+			generation = _emitter->putCached(key, data, size);
+		} else {
+			_emitter->putMissing(key, generation);
+			generation = 0;
+		}
+
+		//commit db
+		if(!_database->commit())
+			throw LocalStoreException(_defaults, key, _database->databaseName(), _database->lastError().text());
+
+		return found;
+	} catch(...) {
+		_database->rollback();
+		throw;
+	}
+}
+
+bool LocalStore::contains(const ObjectKey &key) const
+{
+	QJsonObject json;
+	quint64 generation = 0;
+	switch(lookupCached(key, json, generation)) {
+	case ObjectCache::Cached:
+		return true;
+	case ObjectCache::Missing:
+		return false;
+	case ObjectCache::NotCached:
+		break;
+	}
+
+	if(!_database->transaction())
+		throw LocalStoreException(_defaults, key, _database->databaseName(), _database->lastError().text());
+
+	try {
+		PreparedQuery containsQuery(_database, ContainsStatement, QStringLiteral("SELECT 1 FROM DataIndex WHERE Type = ? AND Id = ? AND File IS NOT NULL"));
+		containsQuery.addBindValue(typeId(key.typeName));
+		containsQuery.addBindValue(key.id);
+		exec(containsQuery, key);
+
+		auto found = containsQuery.first();
+		if(!found)
+			_emitter->putMissing(key, generation);
 
 		//commit db
 		if(!_database->commit())
 			throw LocalStoreException(_defaults, key, _database->databaseName(), _database->lastError().text());
 
-		return json;
+		return found;
 	} catch(...) {
 		_database->rollback();
 		throw;
 	}
 }
 
+QList<QJsonObject> LocalStore::loadMany(const QByteArray &typeName, const QStringList &ids) const
+{
+	//collect journaled and cached entries first, only load the rest
+	QHash<QString, QJsonObject> results;
+	QSet<QString> lookedUp;
+	QStringList loadIds;
+	for(const auto &id : ids) {
+		//duplicates are only looked up and bound once, but returned for every occurrence
+		if(lookedUp.contains(id))
+			continue;
+		lookedUp.insert(id);
+
+		QJsonObject json;
+		quint64 generation;
+		switch(lookupCached({typeName, id}, json, generation)) {
+		case ObjectCache::Cached:
+			results.insert(id, json);
+			break;
+		case ObjectCache::Missing:
+			break;
+		case ObjectCache::NotCached:
+			loadIds.append(id);
+			break;
+		}
+	}
+
+	if(!loadIds.isEmpty()) {
+		//read transaction, so all rows come from one snapshot. Writers only remove files after their commit
+		beginReadTransaction(typeName);
+
+		try {
+			QList<ObjectKey> keys;
+			QList<QJsonObject> array;
+			QList<int> sizes;
+			for(auto offset = 0; offset < loadIds.size(); offset += MaxBatchSize) {
+				const auto chunk = loadIds.mid(offset, MaxBatchSize);
+				QSqlQuery loadQuery(_database);
+				loadQuery.prepare(QStringLiteral("SELECT Id, File, Data FROM DataIndex WHERE Type = ? AND Id IN (%1) AND File IS NOT NULL")
+								  .arg(bindList(chunk.size())));
+				loadQuery.addBindValue(typeId(typeName));
+				for(const auto &id : chunk)
+					loadQuery.addBindValue(id);
+				exec(loadQuery, typeName);
+
+				while(loadQuery.next()) {
+					int size;
+					ObjectKey key {typeName, loadQuery.value(0).toString()};
+					auto json = readJson(key, loadQuery.value(1).toString(), loadQuery.value(2).toByteArray(), &size);
+					results.insert(key.id, json);
+					keys.append(key);
+					array.append(json);
+					sizes.append(size);
+				}
+			}
+
+			//commit db
+			if(!_database->commit())
+				throw LocalStoreException(_defaults, typeName, _database->databaseName(), _database->lastError().text());
+			_emitter->putCached(keys, array, sizes);
+		} catch(...) {
+			_database->rollback();
+			throw;
+		}
+	}
+
+	//return in the order of the requested ids, skipping non existant ones
+	QList<QJsonObject> resList;
+	resList.reserve(results.size());
+	for(const auto &id : ids) {
+		auto it = results.constFind(id);
+		if(it != results.constEnd())
+			resList.append(*it);
+	}
+	return resList;
+}
+
 void LocalStore::save(const ObjectKey &key, const QJsonObject &data)
 {
+	//write behind: only journal it, the store worker writes it later
+	auto journal = _defaults.writeJournal();
+	if(journal) {
+		auto size = journal->append(key, data);
+		//loads see the journal already, so it is announced now. Uploads wait for the ChangeLog entry of the flush
+		_emitter->triggerChange(key, false, false);
+		try {
+			auto worker = _defaults.storeWorker();
+			if(size >= journal->limit)
+				worker->scheduleFlush(0);
+			else if(size == 1)
+				worker->scheduleFlush(journal->delay);
+		} catch(SetupDoesNotExistException &) {
+			//setup is being removed and the worker already flushed, so write it directly
+			flushJournal();
+		}
+		return;
+	}
+
+	registerType(key.typeName);
 	beginWriteTransaction(key);
 
 	try {
 		//check if the file exists
-		QSqlQuery existQuery(_database);
-		existQuery.prepare(QStringLiteral("SELECT Version, File FROM DataIndex WHERE Type = ? AND Id = ?"));
-		existQuery.addBindValue(key.typeName);
+		PreparedQuery existQuery(_database, ExistsStatement, QStringLiteral("SELECT Version, File FROM DataIndex WHERE Type = ? AND Id = ?"));
+		existQuery.addBindValue(typeId(key.typeName));
 		existQuery.addBindValue(key.id);
 		exec(existQuery, key);
 
@@ -220,7 +920,74 @@ void LocalStore::save(const ObjectKey &key, const QJsonObject &data)
 
 		resFn();
 	} catch(...) {
-		_emitter->dropCached(key);
+		_database->rollback();
+		throw;
+	}
+}
+
+void LocalStore::saveBatch(const QByteArray &typeName, const QHash<QString, QJsonObject> &data)
+{
+	if(data.isEmpty())
+		return;
+	flushJournal();
+
+	const ObjectKey typeKey{typeName};
+	registerType(typeName);
+	beginWriteTransaction(typeKey);
+
+	try {
+		auto resFns = saveBatchImpl(_database, typeName, data);
+
+		//commit database changes
+		if(!_database->commit())
+			throw LocalStoreException(_defaults, typeKey, _database->databaseName(), _database->lastError().text());
+
+		for(const auto &fn : qAsConst(resFns))
+			fn();
+		_emitter->triggerChanges(typeName, data.keys(), false, true);
+	} catch(...) {
+		_database->rollback();
+		throw;
+	}
+}
+
+void LocalStore::flushJournal()
+{
+	auto journal = _defaults.writeJournal();
+	if(!journal || journal->isEmpty())
+		return;
+
+	QMutexLocker _(&journal->flushMutex);
+	const auto entries = journal->pending(); //might have been flushed by someone else while waiting
+	if(entries.isEmpty())
+		return;
+
+	QHash<QByteArray, QHash<QString, QJsonObject>> data;
+	for(auto it = entries.constBegin(); it != entries.constEnd(); it++)
+		data[it.key().typeName].insert(it.key().id, it->second);
+	for(auto it = data.constBegin(); it != data.constEnd(); it++)
+		registerType(it.key());
+
+	//write all entries in one transaction, no matter of which type
+	beginWriteTransaction();
+	try {
+		QList<function<void()>> resFns;
+		resFns.reserve(entries.size());
+		for(auto it = data.constBegin(); it != data.constEnd(); it++)
+			resFns.append(saveBatchImpl(_database, it.key(), it.value()));
+
+		//commit database changes
+		if(!_database->commit())
+			throw LocalStoreException(_defaults, ObjectKey{"any"}, _database->databaseName(), _database->lastError().text());
+
+		//only remove them from the journal once committed, so loads can always find them
+		journal->release(entries);
+		for(const auto &fn : qAsConst(resFns))
+			fn();
+		//the changes were announced when journaled
+		_emitter->triggerUpload();
+		logDebug() << "Flushed" << entries.size() << "journaled datasets";
+	} catch(...) {
 		_database->rollback();
 		throw;
 	}
@@ -228,13 +995,13 @@ void LocalStore::save(const ObjectKey &key, const QJsonObject &data)
 
 bool LocalStore::remove(const ObjectKey &key)
 {
+	flushJournal();
 	beginWriteTransaction(key);
 
 	try {
 		//load data of existing entry
-		QSqlQuery loadQuery(_database);
-		loadQuery.prepare(QStringLiteral("SELECT Version, File FROM DataIndex WHERE Type = ? AND Id = ? AND File IS NOT NULL"));
-		loadQuery.addBindValue(key.typeName);
+		PreparedQuery loadQuery(_database, RemoveInfoStatement, QStringLiteral("SELECT Version, File FROM DataIndex WHERE Type = ? AND Id = ? AND File IS NOT NULL"));
+		loadQuery.addBindValue(typeId(key.typeName));
 		loadQuery.addBindValue(key.id);
 		exec(loadQuery, key);
 
@@ -242,22 +1009,23 @@ bool LocalStore::remove(const ObjectKey &key)
 			auto version = loadQuery.value(0).toULongLong() + 1;
 
 			//"remove" from db
-			QSqlQuery removeQuery(_database);
-			removeQuery.prepare(QStringLiteral("UPDATE DataIndex SET Version = ?, File = NULL, Checksum = NULL, Changed = 1 WHERE Type = ? AND Id = ?"));
+			PreparedQuery removeQuery(_database, RemoveStatement, QStringLiteral("UPDATE DataIndex SET Version = ?, File = NULL, Checksum = NULL, Data = NULL WHERE Type = ? AND Id = ?"));
 			removeQuery.addBindValue(version);
-			removeQuery.addBindValue(key.typeName);
+			removeQuery.addBindValue(typeId(key.typeName));
 			removeQuery.addBindValue(key.id);
 			exec(removeQuery, key);
-
-			//delete the file
-			QFile rmFile(filePath(key, loadQuery.value(1).toString()));
-			if(!rmFile.remove())
-				throw LocalStoreException(_defaults, key, rmFile.fileName(), rmFile.errorString());
+			storeChangeLogImpl(_database, key, true);
+			removeIndexImpl(_database, key);
+			removeFullTextImpl(_database, key);
+			const auto fileName = loadQuery.value(1).toString();
 
 			//commit db
 			if(!_database->commit())
 				throw LocalStoreException(_defaults, key, _database->databaseName(), _database->lastError().text());
 
+			//delete the file, if not stored inline. Only now, readers of the old snapshot might still need it
+			if(!fileName.isEmpty())
+				removeObsoleteFiles({filePath(key, fileName)});
 			//update cache
 			_emitter->dropCached(key);
 			//trigger change signals
@@ -276,51 +1044,160 @@ bool LocalStore::remove(const ObjectKey &key)
 	}
 }
 
-QList<QJsonObject> LocalStore::find(const QByteArray &typeName, const QString &query, DataStore::SearchMode mode) const
+QStringList LocalStore::removeMany(const QByteArray &typeName, const QStringList &ids)
 {
-	auto searchQuery = query;
-	if(mode != DataStore::RegexpMode) { //escape any of the like wildcard literals
-		if(mode != DataStore::WildcardMode)
-			searchQuery.replace(QLatin1Char('\\'), QStringLiteral("\\\\"));
-		searchQuery.replace(QLatin1Char('%'), QStringLiteral("\\%"));
-		searchQuery.replace(QLatin1Char('_'), QStringLiteral("\\_"));
+	flushJournal();
+	if(ids.isEmpty())
+		return {};
+
+	beginWriteTransaction(typeName);
+
+	try {
+		const auto tableDir = typeDirectory(typeName);
+		const auto hasIndexes = !indexedProperties(typeName).isEmpty();
+		const auto hasFullText = !fullTextProperties(typeName).isEmpty();
+		QStringList removedIds;
+		QStringList removedFiles;
+		for(auto offset = 0; offset < ids.size(); offset += MaxBatchSize) {
+			const auto chunk = ids.mid(offset, MaxBatchSize);
+			const auto binds = bindList(chunk.size());
+
+			//load data of existing entries
+			QSqlQuery loadQuery(_database);
+			loadQuery.prepare(QStringLiteral("SELECT Id, File FROM DataIndex WHERE Type = ? AND Id IN (%1) AND File IS NOT NULL")
+							  .arg(binds));
+			loadQuery.addBindValue(typeId(typeName));
+			for(const auto &id : chunk)
+				loadQuery.addBindValue(id);
+			exec(loadQuery, typeName);
+
+			auto found = false;
+			while(loadQuery.next()) {
+				found = true;
+				removedIds.append(loadQuery.value(0).toString());
+				storeChangeLogImpl(_database, {typeName, removedIds.last()}, true);
+				if(hasFullText)
+					removeFullTextImpl(_database, {typeName, removedIds.last()});
+				auto fileName = loadQuery.value(1).toString();
+				if(!fileName.isEmpty())
+					removedFiles.append(filePath(tableDir, fileName));
+			}
+			if(!found)
+				continue;
+
+			//"remove" from db
+			QSqlQuery removeQuery(_database);
+			removeQuery.prepare(QStringLiteral("UPDATE DataIndex "
+											   "SET Version = Version + 1, File = NULL, Checksum = NULL, Data = NULL "
+											   "WHERE Type = ? AND Id IN (%1) AND File IS NOT NULL")
+								.arg(binds));
+			removeQuery.addBindValue(typeId(typeName));
+			for(const auto &id : chunk)
+				removeQuery.addBindValue(id);
+			exec(removeQuery, typeName);
+
+			if(hasIndexes) {
+				QSqlQuery indexQuery(_database);
+				indexQuery.prepare(QStringLiteral("DELETE FROM PropertyIndex WHERE Type = ? AND Id IN (%1)")
+								   .arg(binds));
+				indexQuery.addBindValue(typeId(typeName));
+				for(const auto &id : chunk)
+					indexQuery.addBindValue(id);
+				exec(indexQuery, typeName);
+			}
+		}
+
+		//commit db
+		if(!_database->commit())
+			throw LocalStoreException(_defaults, typeName, _database->databaseName(), _database->lastError().text());
+
+		//delete the files, after the commit like clear
+		removeObsoleteFiles(removedFiles);
+
+		if(!removedIds.isEmpty()) {
+			//update cache
+			_emitter->dropCached(typeName, removedIds);
+			//trigger change signals
+			_emitter->triggerClear(typeName, removedIds);
+		}
+		return removedIds;
+	} catch(...) {
+		_database->rollback();
+		throw;
 	}
+}
 
-	switch(mode) {
-	case DataStore::WildcardMode:
-	{
-		//replace any unescaped * or ? by % and _
-		const QRegularExpression searchRepRegex1(QStringLiteral(R"__(((?<!\\)(?:\\\\)*)\*)__"));
-		const QRegularExpression searchRepRegex2(QStringLiteral(R"__(((?<!\\)(?:\\\\)*)\?)__"));
-		searchQuery.replace(searchRepRegex1, QStringLiteral("\\1%"));
-		searchQuery.replace(searchRepRegex2, QStringLiteral("\\1_"));
-		break;
+QList<QJsonObject> LocalStore::find(const QByteArray &typeName, const QString &query, DataStore::SearchMode mode) const
+{
+	flushPending(typeName);
+	beginReadTransaction(typeName);
+
+	try {
+		QSqlQuery findQuery(_database);
+		findQuery.prepare(findStatement(mode));
+		findQuery.addBindValue(typeId(typeName));
+		findQuery.addBindValue(searchPattern(query, mode));
+		exec(findQuery, typeName);
+
+		QList<ObjectKey> keys;
+		QList<QJsonObject> array;
+		QList<int> sizes;
+		while(findQuery.next()) {
+			int size;
+			ObjectKey key {typeName, findQuery.value(0).toString()};
+			auto json = readJson(key, findQuery.value(1).toString(), findQuery.value(2).toByteArray(), &size);
+			keys.append(key);
+			array.append(json);
+			sizes.append(size);
+		}
+
+		if(!_database->commit())
+			throw LocalStoreException(_defaults, typeName, _database->databaseName(), _database->lastError().text());
+		_emitter->putCached(keys, array, sizes);
+
+		return array;
+	} catch(...) {
+		_database->rollback();
+		throw;
 	}
-	case DataStore::ContainsMode:
-		searchQuery = QLatin1Char('%') + searchQuery + QLatin1Char('%');
-		break;
-	case DataStore::StartsWithMode:
-		searchQuery = searchQuery + QLatin1Char('%');
-		break;
-	case DataStore::EndsWithMode:
-		searchQuery = QLatin1Char('%') + searchQuery;
-		break;
-	default:
-		break;
+}
+
+void LocalStore::find(const QByteArray &typeName, const QString &query, DataStore::SearchMode mode, const function<bool(ObjectKey, QJsonObject)> &visitor) const
+{
+	flushPending(typeName);
+	QSqlQuery findQuery(_database);
+	findQuery.setForwardOnly(true);
+	findQuery.prepare(findStatement(mode));
+	findQuery.addBindValue(typeId(typeName));
+	findQuery.addBindValue(searchPattern(query, mode));
+	streamRows(typeName, findQuery, visitor);
+}
+
+QList<QJsonObject> LocalStore::findBy(const QByteArray &typeName, const QString &property, const QJsonValue &value) const
+{
+	flushPending(typeName);
+	if(!indexedProperties(typeName).contains(property)) {
+		throw LocalStoreException(_defaults,
+								  typeName,
+								  property,
+								  QStringLiteral("The property is not indexed. Use Setup::addIndex to declare an index for it"));
 	}
 
+	const auto sqlValue = indexValue(value);
+	if(!sqlValue.isValid()) //such values are never indexed
+		return {};
+
 	beginReadTransaction(typeName);
 
 	try {
-		QSqlQuery findQuery(_database);
-		auto queryStr = QStringLiteral("SELECT Id, File FROM DataIndex WHERE Type = ? AND %1 AND File IS NOT NULL");
-		if(mode == DataStore::RegexpMode)
-			queryStr = queryStr.arg(QStringLiteral("Id REGEXP ?"));
-		else
-			queryStr = queryStr.arg(QStringLiteral("Id LIKE ? ESCAPE '\\'"));
-		findQuery.prepare(queryStr);
-		findQuery.addBindValue(typeName);
-		findQuery.addBindValue(searchQuery);
+		PreparedQuery findQuery(_database, FindByStatement, QStringLiteral("SELECT DataIndex.Id, DataIndex.File, DataIndex.Data FROM PropertyIndex "
+																		   "INNER JOIN DataIndex ON DataIndex.Type = PropertyIndex.Type AND DataIndex.Id = PropertyIndex.Id "
+																		   "WHERE PropertyIndex.Type = ? AND PropertyIndex.Property = ? AND PropertyIndex.Value = ? "
+																		   "AND DataIndex.File IS NOT NULL "
+																		   "ORDER BY PropertyIndex.Id"));
+		findQuery.addBindValue(typeId(typeName));
+		findQuery.addBindValue(property);
+		findQuery.addBindValue(sqlValue);
 		exec(findQuery, typeName);
 
 		QList<ObjectKey> keys;
@@ -329,16 +1206,62 @@ QList<QJsonObject> LocalStore::find(const QByteArray &typeName, const QString &q
 		while(findQuery.next()) {
 			int size;
 			ObjectKey key {typeName, findQuery.value(0).toString()};
-			auto json = readJson(key, findQuery.value(1).toString(), &size);
+			auto json = readJson(key, findQuery.value(1).toString(), findQuery.value(2).toByteArray(), &size);
 			keys.append(key);
 			array.append(json);
 			sizes.append(size);
 		}
 
+		if(!_database->commit())
+			throw LocalStoreException(_defaults, typeName, _database->databaseName(), _database->lastError().text());
 		_emitter->putCached(keys, array, sizes);
 
+		return array;
+	} catch(...) {
+		_database->rollback();
+		throw;
+	}
+}
+
+QList<QJsonObject> LocalStore::fullTextSearch(const QByteArray &typeName, const QString &query, int limit) const
+{
+	flushPending(typeName);
+	if(fullTextProperties(typeName).isEmpty()) {
+		throw LocalStoreException(_defaults,
+								  typeName,
+								  query,
+								  QStringLiteral("The type has no full text index. Use Setup::addFullTextIndex to declare one"));
+	}
+
+	beginReadTransaction(typeName);
+
+	try {
+		PreparedQuery searchQuery(_database, FullTextSearchStatement, QStringLiteral("SELECT FullTextKeys.Id, DataIndex.File, DataIndex.Data FROM FullTextIndex "
+																					 "INNER JOIN FullTextKeys ON FullTextKeys.Key = FullTextIndex.rowid "
+																					 "INNER JOIN DataIndex ON DataIndex.Type = FullTextKeys.Type AND DataIndex.Id = FullTextKeys.Id "
+																					 "WHERE FullTextIndex MATCH ? AND FullTextKeys.Type = ? AND DataIndex.File IS NOT NULL "
+																					 "ORDER BY FullTextIndex.rank "
+																					 "LIMIT ?"));
+		searchQuery.addBindValue(query);
+		searchQuery.addBindValue(typeId(typeName));
+		searchQuery.addBindValue(limit);
+		exec(searchQuery, typeName);
+
+		QList<ObjectKey> keys;
+		QList<QJsonObject> array;
+		QList<int> sizes;
+		while(searchQuery.next()) {
+			int size;
+			ObjectKey key {typeName, searchQuery.value(0).toString()};
+			auto json = readJson(key, searchQuery.value(1).toString(), searchQuery.value(2).toByteArray(), &size);
+			keys.append(key);
+			array.append(json);
+			sizes.append(size);
+		}
+
 		if(!_database->commit())
 			throw LocalStoreException(_defaults, typeName, _database->databaseName(), _database->lastError().text());
+		_emitter->putCached(keys, array, sizes);
 
 		return array;
 	} catch(...) {
@@ -349,36 +1272,71 @@ QList<QJsonObject> LocalStore::find(const QByteArray &typeName, const QString &q
 
 void LocalStore::clear(const QByteArray &typeName)
 {
+	flushJournal();
 	beginWriteTransaction(typeName, true);
 
 	try {
-		// get all keys that are to be cleared
+		// get all keys that are to be cleared, and their files
 		QSqlQuery clearInfoQuery(_database);
-		clearInfoQuery.prepare(QStringLiteral("SELECT Id FROM DataIndex "
+		clearInfoQuery.prepare(QStringLiteral("SELECT Id, File FROM DataIndex "
 											  "WHERE Type = ? AND File IS NOT NULL"));
-		clearInfoQuery.addBindValue(typeName);
+		clearInfoQuery.addBindValue(typeId(typeName));
 		exec(clearInfoQuery, typeName);
+		const auto tableDir = typeDirectory(typeName);
 		QStringList clearKeys;
-		while(clearInfoQuery.next())
+		QStringList clearFiles;
+		while(clearInfoQuery.next()) {
 			clearKeys.append(clearInfoQuery.value(0).toString());
+			const auto fileName = clearInfoQuery.value(1).toString();
+			if(!fileName.isEmpty())
+				clearFiles.append(filePath(tableDir, fileName));
+		}
 
 		// clear them
+		QSqlQuery unlogQuery(_database);
+		unlogQuery.prepare(QStringLiteral("DELETE FROM ChangeLog WHERE Type = ? AND Id IN ("
+										  "SELECT Id FROM DataIndex WHERE Type = ? AND File IS NOT NULL)"));
+		unlogQuery.addBindValue(typeId(typeName));
+		unlogQuery.addBindValue(typeId(typeName));
+		exec(unlogQuery, typeName);
+
+		QSqlQuery logQuery(_database);
+		logQuery.prepare(QStringLiteral("INSERT INTO ChangeLog (Type, Id) "
+										"SELECT Type, Id FROM DataIndex WHERE Type = ? AND File IS NOT NULL"));
+		logQuery.addBindValue(typeId(typeName));
+		exec(logQuery, typeName);
+
 		QSqlQuery clearQuery(_database);
 		clearQuery.prepare(QStringLiteral("UPDATE DataIndex "
-										  "SET Version = Version + 1, File = NULL, Checksum = NULL, Changed = 1 "
+										  "SET Version = Version + 1, File = NULL, Checksum = NULL, Data = NULL "
 										  "WHERE Type = ? AND File IS NOT NULL"));
-		clearQuery.addBindValue(typeName);
+		clearQuery.addBindValue(typeId(typeName));
 		exec(clearQuery, typeName);
 
-		auto tableDir = typeDirectory(typeName);
-		if(!tableDir.removeRecursively()) {
-			logWarning() << "Failed to delete cleared data directory for type"
-						 << typeName;
+		QSqlQuery clearIndexQuery(_database);
+		clearIndexQuery.prepare(QStringLiteral("DELETE FROM PropertyIndex WHERE Type = ?"));
+		clearIndexQuery.addBindValue(typeId(typeName));
+		exec(clearIndexQuery, typeName);
+
+		if(!fullTextProperties(typeName).isEmpty()) {
+			QSqlQuery clearFtsQuery(_database);
+			clearFtsQuery.prepare(QStringLiteral("DELETE FROM FullTextIndex WHERE rowid IN (SELECT Key FROM FullTextKeys WHERE Type = ?)"));
+			clearFtsQuery.addBindValue(typeId(typeName));
+			exec(clearFtsQuery, typeName);
+
+			QSqlQuery clearKeysQuery(_database);
+			clearKeysQuery.prepare(QStringLiteral("DELETE FROM FullTextKeys WHERE Type = ?"));
+			clearKeysQuery.addBindValue(typeId(typeName));
+			exec(clearKeysQuery, typeName);
 		}
 
 		if(!_database->commit())
 			throw LocalStoreException(_defaults, typeName, _database->databaseName(), _database->lastError().text());
 
+		//the files are only deleted now, readers of the old snapshot might still need them
+		//the directory stays, as other writers can already add new files to it. Segments are removed by compactSegments
+		removeObsoleteFiles(clearFiles);
+
 		//clear cache
 		_emitter->dropCached(typeName, clearKeys);
 		//trigger change signals
@@ -391,12 +1349,18 @@ void LocalStore::clear(const QByteArray &typeName)
 
 void LocalStore::reset(bool keepData)
 {
+	flushJournal();
 	beginWriteTransaction(ObjectKey{"any"}, true);
 
 	try {
 		if(keepData) { //mark everything changed, to upload if needed
+			QSqlQuery unlogQuery(_database);
+			unlogQuery.prepare(QStringLiteral("DELETE FROM ChangeLog"));
+			exec(unlogQuery);
+
+			//except for broken entries, see repairDataFiles
 			QSqlQuery resetQuery(_database);
-			resetQuery.prepare(QStringLiteral("UPDATE DataIndex SET Changed = 1"));
+			resetQuery.prepare(QStringLiteral("INSERT INTO ChangeLog (Type, Id) SELECT Type, Id FROM DataIndex WHERE Version != 0"));
 			exec(resetQuery);
 
 			//also: delete all not done device changes
@@ -408,6 +1372,28 @@ void LocalStore::reset(bool keepData)
 			resetQuery.prepare(QStringLiteral("DELETE FROM DataIndex"));
 			exec(resetQuery);
 
+			QSqlQuery resetLogQuery(_database);
+			resetLogQuery.prepare(QStringLiteral("DELETE FROM ChangeLog"));
+			exec(resetLogQuery);
+
+			QSqlQuery resetIndexQuery(_database);
+			resetIndexQuery.prepare(QStringLiteral("DELETE FROM PropertyIndex"));
+			exec(resetIndexQuery);
+
+			QSqlQuery resetCountsQuery(_database);
+			resetCountsQuery.prepare(QStringLiteral("DELETE FROM AccessCounts"));
+			exec(resetCountsQuery);
+
+			if(_database->tables().contains(QStringLiteral("FullTextIndex"))) {
+				QSqlQuery resetFtsQuery(_database);
+				resetFtsQuery.prepare(QStringLiteral("DELETE FROM FullTextIndex"));
+				exec(resetFtsQuery);
+
+				QSqlQuery resetKeysQuery(_database);
+				resetKeysQuery.prepare(QStringLiteral("DELETE FROM FullTextKeys"));
+				exec(resetKeysQuery);
+			}
+
 			//note: resets are local only, so they dont trigger any changecontroller stuff
 
 			auto tableDir = _defaults.storageDir();
@@ -424,6 +1410,9 @@ void LocalStore::reset(bool keepData)
 		if(!keepData) {
 			//clear cache
 			_emitter->dropCached();
+			auto tracker = _defaults.accessTracker();
+			if(tracker)
+				tracker->clear();
 			//trigger change signals
 			_emitter->triggerReset();
 		}
@@ -435,17 +1424,9 @@ void LocalStore::reset(bool keepData)
 
 quint32 LocalStore::changeCount() const
 {
-	QSqlQuery countQuery(_database);
-	countQuery.prepare(QStringLiteral("SELECT Sum(rows) FROM ( "
-									  "		SELECT Count(*) AS rows FROM DataIndex "
-									  "		WHERE Changed = 1"
-									  "		UNION ALL"
-									  "		SELECT Count(*) AS rows FROM DataIndex "
-									  "		INNER JOIN DeviceUploads "
-									  "		ON DataIndex.Type = DeviceUploads.Type "
-									  "		AND DataIndex.Id = DeviceUploads.Id "
-									  "		WHERE NOT (DataIndex.Changed = 1 AND File IS NULL)"
-									  ")"));
+	PreparedQuery countQuery(_database,
+							 ChangeCountStatement,
+							 QStringLiteral("SELECT IFNULL(Sum(Changes + DeviceChanges), 0) FROM TypeStats"));
 	exec(countQuery);
 
 	if(countQuery.first())
@@ -455,12 +1436,26 @@ quint32 LocalStore::changeCount() const
 }
 
 void LocalStore::loadChanges(int limit, const function<bool(ObjectKey, quint64, QString, QUuid)> &visitor) const
+{
+	loadChanges(limit, 0, [&](quint64, const ObjectKey &key, quint64 version, const QString &file, QUuid deviceId) {
+		return visitor(key, version, file, deviceId);
+	});
+}
+
+void LocalStore::loadChanges(int limit, quint64 afterSeq, const function<bool(quint64, ObjectKey, quint64, QString, QUuid)> &visitor) const
 {
 	beginReadTransaction();
 
 	try {
-		QSqlQuery readChangesQuery(_database);
-		readChangesQuery.prepare(QStringLiteral("SELECT Type, Id, Version, File FROM DataIndex WHERE Changed = 1 LIMIT ?"));
+		PreparedQuery readChangesQuery(_database, LoadChangesStatement, QStringLiteral("SELECT ChangeLog.Seq, Types.Name, ChangeLog.Id, DataIndex.Version, DataIndex.File "
+																					   "FROM ChangeLog "
+																					   "INNER JOIN DataIndex "
+																					   "ON (ChangeLog.Type = DataIndex.Type AND ChangeLog.Id = DataIndex.Id) "
+																					   "INNER JOIN Types ON Types.Id = ChangeLog.Type "
+																					   "WHERE ChangeLog.Seq > ? "
+																					   "ORDER BY ChangeLog.Seq "
+																					   "LIMIT ?"));
+		readChangesQuery.addBindValue(afterSeq);
 		readChangesQuery.addBindValue(limit);
 		exec(readChangesQuery);
 
@@ -468,9 +1463,10 @@ void LocalStore::loadChanges(int limit, const function<bool(ObjectKey, quint64,
 		auto skip = false;
 		while(readChangesQuery.next()) {
 			cnt++;
-			if(!visitor({readChangesQuery.value(0).toByteArray(), readChangesQuery.value(1).toString()},
-						readChangesQuery.value(2).toULongLong(),
-						readChangesQuery.value(3).toString(),
+			if(!visitor(readChangesQuery.value(0).toULongLong(),
+						{readChangesQuery.value(1).toByteArray(), readChangesQuery.value(2).toString()},
+						readChangesQuery.value(3).toULongLong(),
+						readChangesQuery.value(4).toString(),
 						QUuid())) {
 				skip = true;
 				break;
@@ -478,18 +1474,23 @@ void LocalStore::loadChanges(int limit, const function<bool(ObjectKey, quint64,
 		}
 
 		if(!skip && cnt < limit) {
-			QSqlQuery readDeviceChangesQuery(_database);
-			readDeviceChangesQuery.prepare(QStringLiteral("SELECT DeviceUploads.Type, DeviceUploads.Id, DataIndex.Version, DataIndex.File, DeviceUploads.Device "
-														  "FROM DeviceUploads "
-														  "INNER JOIN DataIndex "
-														  "ON (DeviceUploads.Type = DataIndex.Type AND DeviceUploads.Id = DataIndex.Id) "
-														  "WHERE NOT (DataIndex.Changed = 1 AND File IS NULL) " //only those that haven't been operated on before
-														  "LIMIT ?"));
+			PreparedQuery readDeviceChangesQuery(_database,
+												 LoadDeviceChangesStatement,
+												 QStringLiteral("SELECT Types.Name, DeviceUploads.Id, DataIndex.Version, DataIndex.File, DeviceUploads.Device "
+																"FROM DeviceUploads "
+																"INNER JOIN DataIndex "
+																"ON (DeviceUploads.Type = DataIndex.Type AND DeviceUploads.Id = DataIndex.Id) "
+																"INNER JOIN Types ON Types.Id = DeviceUploads.Type "
+																"LEFT JOIN ChangeLog "
+																"ON (DeviceUploads.Type = ChangeLog.Type AND DeviceUploads.Id = ChangeLog.Id) "
+																"WHERE NOT (ChangeLog.Seq IS NOT NULL AND File IS NULL) " //only those that haven't been operated on before
+																"LIMIT ?"));
 			readDeviceChangesQuery.addBindValue(limit - cnt);
 			exec(readDeviceChangesQuery);
 
 			while(readDeviceChangesQuery.next()) {
-				if(!visitor({readDeviceChangesQuery.value(0).toByteArray(), readDeviceChangesQuery.value(1).toString()},
+				if(!visitor(0,
+							{readDeviceChangesQuery.value(0).toByteArray(), readDeviceChangesQuery.value(1).toString()},
 							readDeviceChangesQuery.value(2).toULongLong(),
 							readDeviceChangesQuery.value(3).toString(),
 							readDeviceChangesQuery.value(4).toUuid())) {
@@ -514,9 +1515,8 @@ void LocalStore::markUnchanged(const ObjectKey &key, quint64 version, bool isDel
 
 void LocalStore::removeDeviceChange(const ObjectKey &key, QUuid deviceId)
 {
-	QSqlQuery rmDeviceQuery(_database);
-	rmDeviceQuery.prepare(QStringLiteral("DELETE FROM DeviceUploads WHERE Type = ? AND Id = ? AND Device = ?"));
-	rmDeviceQuery.addBindValue(key.typeName);
+	PreparedQuery rmDeviceQuery(_database, RemoveDeviceChangeStatement, QStringLiteral("DELETE FROM DeviceUploads WHERE Type = ? AND Id = ? AND Device = ?"));
+	rmDeviceQuery.addBindValue(typeId(key.typeName));
 	rmDeviceQuery.addBindValue(key.id);
 	rmDeviceQuery.addBindValue(deviceId);
 	exec(rmDeviceQuery);
@@ -524,6 +1524,8 @@ void LocalStore::removeDeviceChange(const ObjectKey &key, QUuid deviceId)
 
 LocalStore::SyncScope LocalStore::startSync(const ObjectKey &key) const
 {
+	flushPending(key.typeName);
+	const_cast<LocalStore*>(this)->registerType(key.typeName); //before the transaction, see registerType
 	return SyncScope(_defaults, key, const_cast<LocalStore*>(this));
 }
 
@@ -531,9 +1533,8 @@ tuple<LocalStore::ChangeType, quint64, QString, QByteArray> LocalStore::loadChan
 {
 	SCOPE_ASSERT();
 
-	QSqlQuery loadChangeQuery(scope.d->database);
-	loadChangeQuery.prepare(QStringLiteral("SELECT Version, File, Checksum FROM DataIndex WHERE Type = ? AND Id = ?"));
-	loadChangeQuery.addBindValue(scope.d->key.typeName);
+	PreparedQuery loadChangeQuery(scope.d->database, LoadChangeInfoStatement, QStringLiteral("SELECT Version, File, Checksum FROM DataIndex WHERE Type = ? AND Id = ?"));
+	loadChangeQuery.addBindValue(typeId(scope.d->key.typeName));
 	loadChangeQuery.addBindValue(scope.d->key.id);
 	exec(loadChangeQuery);
 
@@ -552,14 +1553,14 @@ tuple<LocalStore::ChangeType, quint64, QString, QByteArray> LocalStore::loadChan
 void LocalStore::updateVersion(SyncScope &scope, quint64 oldVersion, quint64 newVersion, bool changed)
 {
 	SCOPE_ASSERT();
-	QSqlQuery updateQuery(scope.d->database);
-	updateQuery.prepare(QStringLiteral("UPDATE DataIndex SET Version = ?, Changed = ? WHERE Type = ? AND Id = ? AND Version = ?"));
+	PreparedQuery updateQuery(scope.d->database, UpdateVersionStatement, QStringLiteral("UPDATE DataIndex SET Version = ? WHERE Type = ? AND Id = ? AND Version = ?"));
 	updateQuery.addBindValue(newVersion);
-	updateQuery.addBindValue(changed);
-	updateQuery.addBindValue(scope.d->key.typeName);
+	updateQuery.addBindValue(typeId(scope.d->key.typeName));
 	updateQuery.addBindValue(scope.d->key.id);
 	updateQuery.addBindValue(oldVersion);
 	exec(updateQuery, scope.d->key);
+	if(updateQuery.numRowsAffected() != 0)
+		storeChangeLogImpl(scope.d->database, scope.d->key, changed);
 
 	//notify change controller
 	if(changed) {
@@ -587,13 +1588,12 @@ void LocalStore::storeDeleted(SyncScope &scope, quint64 version, bool changed, C
 	switch (localState) {
 	case Exists:
 	{
-		QSqlQuery loadQuery(scope.d->database);
-		loadQuery.prepare(QStringLiteral("SELECT File FROM DataIndex WHERE Type = ? AND Id = ? AND File IS NOT NULL"));
-		loadQuery.addBindValue(scope.d->key.typeName);
+		PreparedQuery loadQuery(scope.d->database, LoadFileStatement, QStringLiteral("SELECT File FROM DataIndex WHERE Type = ? AND Id = ? AND File IS NOT NULL"));
+		loadQuery.addBindValue(typeId(scope.d->key.typeName));
 		loadQuery.addBindValue(scope.d->key.id);
 		exec(loadQuery, scope.d->key);
 
-		if(loadQuery.first())
+		if(loadQuery.first() && !loadQuery.value(0).toString().isEmpty()) //not for inline data
 			fileName = filePath(scope.d->key, loadQuery.value(0).toString());
 		Q_FALLTHROUGH();
 	}
@@ -609,34 +1609,29 @@ void LocalStore::storeDeleted(SyncScope &scope, quint64 version, bool changed, C
 	}
 
 	if(existing) {
-		QSqlQuery updateQuery(scope.d->database);
-		updateQuery.prepare(QStringLiteral("UPDATE DataIndex SET Version = ?, File = NULL, Checksum = NULL, Changed = ? WHERE Type = ? AND Id = ?"));
+		PreparedQuery updateQuery(scope.d->database, StoreDeletedStatement, QStringLiteral("UPDATE DataIndex SET Version = ?, File = NULL, Checksum = NULL, Data = NULL WHERE Type = ? AND Id = ?"));
 		updateQuery.addBindValue(version);
-		updateQuery.addBindValue(changed);
-		updateQuery.addBindValue(scope.d->key.typeName);
+		updateQuery.addBindValue(typeId(scope.d->key.typeName));
 		updateQuery.addBindValue(scope.d->key.id);
 		exec(updateQuery, scope.d->key);
+		removeIndexImpl(scope.d->database, scope.d->key);
+		removeFullTextImpl(scope.d->database, scope.d->key);
 	} else {
-		QSqlQuery insertQuery(scope.d->database);
-		insertQuery.prepare(QStringLiteral("INSERT INTO DataIndex (Type, Id, Version, File, Checksum, Changed) VALUES(?, ?, ?, NULL, NULL, ?)"));
-		insertQuery.addBindValue(scope.d->key.typeName);
+		PreparedQuery insertQuery(scope.d->database, InsertDeletedStatement, QStringLiteral("INSERT INTO DataIndex (Type, Id, Version, File, Checksum) VALUES(?, ?, ?, NULL, NULL)"));
+		insertQuery.addBindValue(knownTypeId(scope.d->key));
 		insertQuery.addBindValue(scope.d->key.id);
 		insertQuery.addBindValue(version);
-		insertQuery.addBindValue(changed);
 		exec(insertQuery, scope.d->key);
 	}
-
-	//delete the file, if one exists
-	if(!fileName.isNull()) {
-		QFile rmFile(fileName);
-		if(!rmFile.remove())
-			throw LocalStoreException(_defaults, scope.d->key, rmFile.fileName(), rmFile.errorString());
-	}
+	storeChangeLogImpl(scope.d->database, scope.d->key, changed);
 
 	Q_ASSERT_X(!scope.d->afterCommit, Q_FUNC_INFO, "Only 1 after commit action can be defined");
 	if(localState == Exists) {
 		auto key = scope.d->key;
-		scope.d->afterCommit = [this, key, changed]() {
+		scope.d->afterCommit = [this, key, changed, fileName]() {
+			//delete the file, if one exists. Only now, readers of the old snapshot might still need it
+			if(!fileName.isNull())
+				removeObsoleteFiles({fileName});
 			//update cache
 			_emitter->dropCached(key);
 			//notify others
@@ -673,8 +1668,8 @@ void LocalStore::prepareAccountAdded(QUuid deviceId)
 {
 	try {
 		QSqlQuery insertQuery(_database);
-		insertQuery.prepare(QStringLiteral("INSERT OR REPLACE INTO DeviceUploads (Type, Id, Device) "
-										   "SELECT Type, Id, ? FROM DataIndex"));
+		insertQuery.prepare(QStringLiteral("INSERT OR IGNORE INTO DeviceUploads (Type, Id, Device) "
+										   "SELECT Type, Id, ? FROM DataIndex WHERE Version != 0")); //except for broken entries, see repairDataFiles
 		insertQuery.addBindValue(deviceId);
 		exec(insertQuery);
 
@@ -707,119 +1702,1635 @@ QString LocalStore::filePath(const ObjectKey &key, const QString &baseName) cons
 	return filePath(typeDirectory(key), baseName);
 }
 
-void LocalStore::beginReadTransaction(const ObjectKey &key) const
+QString LocalStore::segmentPath(const QDir &typeDir, qint64 segment) const
 {
-	if(!_database->transaction())
-		throw LocalStoreException(_defaults, key, _database->databaseName(), _database->lastError().text());
+	return typeDir.absoluteFilePath(QStringLiteral("segment_%1.pack").arg(segment));
 }
 
-void LocalStore::beginWriteTransaction(const ObjectKey &key, bool exclusive)
+QByteArray LocalStore::toStorageFormat(const QJsonObject &data)
 {
-	QSqlQuery transactQuery(_database);
-	if(!transactQuery.exec(QStringLiteral("BEGIN %1 TRANSACTION")
-						   .arg(exclusive ? QStringLiteral("EXCLUSIVE") : QStringLiteral("IMMEDIATE")))) {
-		throw LocalStoreException(_defaults,
-								  key,
-								  transactQuery.executedQuery().simplified(),
-								  transactQuery.lastError().text());
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+	return QCborValue{QCborKnownTags::Signature, QCborMap::fromJsonObject(data)}.toCbor();
+#else
+	return QJsonDocument{data}.toBinaryData();
+#endif
+}
+
+QJsonDocument LocalStore::fromStorageFormat(const QByteArray &data)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+	//data written by older versions is binary json, it is converted once it is saved again
+	if(data.startsWith(CborSignature)) {
+		QCborStreamReader reader{data};
+		const auto value = readCborValue(reader);
+		if(reader.lastError() != QCborError::NoError || !value.isObject())
+			return {};
+		return QJsonDocument{value.toObject()};
 	}
+#endif
+	return QJsonDocument::fromBinaryData(data);
 }
 
-void LocalStore::exec(QSqlQuery &query, const ObjectKey &key) const
+QString LocalStore::shardedName(const QString &baseName)
 {
-	if(!query.exec()) {
-			throw LocalStoreException(_defaults,
-									  key,
-									  query.executedQuery().simplified(),
-									  query.lastError().text());
+	//names start with random hex digits, so two levels of 256 directories are evenly filled
+	return QStringLiteral("%1/%2/%3")
+			.arg(baseName.mid(0, 2), baseName.mid(2, 2), baseName);
+}
+
+QString LocalStore::bindList(int count)
+{
+	QStringList binds;
+	binds.reserve(count);
+	for(auto i = 0; i < count; i++)
+		binds.append(QStringLiteral("?"));
+	return binds.join(QStringLiteral(", "));
+}
+
+QString LocalStore::searchPattern(const QString &query, DataStore::SearchMode mode)
+{
+	auto searchQuery = query;
+	if(mode != DataStore::RegexpMode) { //escape any of the like wildcard literals
+		if(mode != DataStore::WildcardMode)
+			searchQuery.replace(QLatin1Char('\\'), QStringLiteral("\\\\"));
+		searchQuery.replace(QLatin1Char('%'), QStringLiteral("\\%"));
+		searchQuery.replace(QLatin1Char('_'), QStringLiteral("\\_"));
+	}
+
+	switch(mode) {
+	case DataStore::WildcardMode:
+	{
+		//replace any unescaped * or ? by % and _
+		const QRegularExpression searchRepRegex1(QStringLiteral(R"__(((?<!\\)(?:\\\\)*)\*)__"));
+		const QRegularExpression searchRepRegex2(QStringLiteral(R"__(((?<!\\)(?:\\\\)*)\?)__"));
+		searchQuery.replace(searchRepRegex1, QStringLiteral("\\1%"));
+		searchQuery.replace(searchRepRegex2, QStringLiteral("\\1_"));
+		break;
+	}
+	case DataStore::ContainsMode:
+		searchQuery = QLatin1Char('%') + searchQuery + QLatin1Char('%');
+		break;
+	case DataStore::StartsWithMode:
+		searchQuery = searchQuery + QLatin1Char('%');
+		break;
+	case DataStore::EndsWithMode:
+		searchQuery = QLatin1Char('%') + searchQuery;
+		break;
+	default:
+		break;
 	}
+
+	return searchQuery;
 }
 
-function<void()> LocalStore::storeChangedImpl(const DatabaseRef &db, const ObjectKey &key, quint64 version, const QString &fileName, const QJsonObject &data, bool changed, bool existing)
+QString LocalStore::findStatement(DataStore::SearchMode mode)
 {
-	auto tableDir = typeDirectory(key);
-	QScopedPointer<QFileDevice> device;
-	function<bool(QFileDevice*)> fileCommitFn;
+	auto queryStr = QStringLiteral("SELECT Id, File, Data FROM DataIndex WHERE Type = ? AND %1 AND File IS NOT NULL");
+	if(mode == DataStore::RegexpMode)
+		return queryStr.arg(QStringLiteral("Id REGEXP ?"));
+	else
+		return queryStr.arg(QStringLiteral("Id LIKE ? ESCAPE '\\'"));
+}
 
-	if(existing && !fileName.isNull()) {
-		auto file = new QSaveFile(filePath(tableDir, fileName));
-		device.reset(file);
-		if(!file->open(QIODevice::WriteOnly))
-			throw LocalStoreException(_defaults, key, file->fileName(), file->errorString());
-		fileCommitFn = [](QFileDevice *d){
-			return static_cast<QSaveFile*>(d)->commit();
-		};
-	} else {
-		auto newFileName = QStringLiteral("%1XXXXXX")
-						   .arg(QString::fromUtf8(QUuid::createUuid().toRfc4122().toHex()));
-		auto file = new QTemporaryFile(filePath(tableDir, newFileName));
-		device.reset(file);
-		if(!file->open())
-			throw LocalStoreException(_defaults, key, file->fileName(), file->errorString());
-		fileCommitFn = [](QFileDevice *d){
-			auto f = static_cast<QTemporaryFile*>(d);
-			f->close();
-			if(f->error() == QFile::NoError) {
-				f->setAutoRemove(false);
-				return true;
-			} else
-				return false;
-		};
+void LocalStore::streamRows(const QByteArray &typeName, QSqlQuery &query, const function<bool(ObjectKey, QJsonObject)> &visitor) const
+{
+	//read transaction, so all rows come from one snapshot. Writers only remove files after their commit
+	beginReadTransaction(typeName);
+
+	try {
+		exec(query, typeName);
+		//only one row at a time, no caching, to keep the memory usage constant
+		while(query.next()) {
+			ObjectKey key {typeName, query.value(0).toString()};
+			auto json = readJson(key, query.value(1).toString(), query.value(2).toByteArray(), nullptr);
+			if(!visitor(key, json))
+				break;
+		}
+		query.finish();
+
+		if(!_database->commit())
+			throw LocalStoreException(_defaults, typeName, _database->databaseName(), _database->lastError().text());
+	} catch(...) {
+		_database->rollback();
+		throw;
 	}
+}
 
-	//write the data & get the hash
-	device->write(QJsonDocument(data).toBinaryData());
-	if(device->error() != QFile::NoError)
-		throw LocalStoreException(_defaults, key, device->fileName(), device->errorString());
+void LocalStore::upgradeSchema()
+{
+	auto oldVersion = 0;
+	{
+		QSqlQuery versionQuery(_database);
+		versionQuery.prepare(QStringLiteral("PRAGMA user_version"));
+		exec(versionQuery);
+		if(versionQuery.first())
+			oldVersion = versionQuery.value(0).toInt();
+		if(oldVersion >= SchemaVersion)
+			return;
+	}
 
-	//save key in database
-	QFileInfo info(device->fileName());
-	if(existing) {
-		QSqlQuery updateQuery(db);
-		updateQuery.prepare(QStringLiteral("UPDATE DataIndex SET Version = ?, File = ?, Checksum = ?, Changed = ? WHERE Type = ? AND Id = ?"));
-		updateQuery.addBindValue(version);
-		updateQuery.addBindValue(tableDir.relativeFilePath(info.completeBaseName())); //still update file, in case it was set to NULL
-		updateQuery.addBindValue(SyncHelper::jsonHash(data));
-		updateQuery.addBindValue(changed);
-		updateQuery.addBindValue(key.typeName);
-		updateQuery.addBindValue(key.id);
-		exec(updateQuery, key);
-	} else {
-		QSqlQuery insertQuery(db);
-		insertQuery.prepare(QStringLiteral("INSERT INTO DataIndex (Type, Id, Version, File, Checksum, Changed) VALUES(?, ?, ?, ?, ?, ?)"));
-		insertQuery.addBindValue(key.typeName);
-		insertQuery.addBindValue(key.id);
-		insertQuery.addBindValue(version);
-		insertQuery.addBindValue(tableDir.relativeFilePath(info.completeBaseName()));
-		insertQuery.addBindValue(SyncHelper::jsonHash(data));
-		insertQuery.addBindValue(changed);
-		exec(insertQuery, key);
+	beginWriteTransaction(ObjectKey{"any"}, true);
+	try {
+		//version 1: inline data
+		if(!_database->record(QStringLiteral("DataIndex")).contains(QStringLiteral("Data"))) {
+			QSqlQuery alterQuery(_database);
+			alterQuery.prepare(QStringLiteral("ALTER TABLE DataIndex ADD COLUMN Data BLOB"));
+			exec(alterQuery);
+			logDebug() << "Added Data column to DataIndex table";
+		}
+
+		//version 2: segment files
+		if(!_database->record(QStringLiteral("DataIndex")).contains(QStringLiteral("Segment"))) {
+			for(const auto &column : {QStringLiteral("Segment"), QStringLiteral("Offset"), QStringLiteral("Length")}) {
+				QSqlQuery alterQuery(_database);
+				alterQuery.prepare(QStringLiteral("ALTER TABLE DataIndex ADD COLUMN %1 INTEGER").arg(column));
+				exec(alterQuery);
+			}
+			logDebug() << "Added segment columns to DataIndex table";
+		}
+
+		//version 3: change log instead of the changed flag (the column stays, but is not used anymore)
+		if(oldVersion < 3 && _database->record(QStringLiteral("DataIndex")).contains(QStringLiteral("Changed"))) {
+			QSqlQuery createQuery(_database);
+			createQuery.prepare(QStringLiteral("CREATE TABLE IF NOT EXISTS ChangeLog ( "
+											   "	Seq		INTEGER PRIMARY KEY AUTOINCREMENT, "
+											   "	Type	TEXT NOT NULL, "
+											   "	Id		TEXT NOT NULL, "
+											   "	UNIQUE(Type, Id) "
+											   ");"));
+			exec(createQuery);
+
+			QSqlQuery logQuery(_database);
+			logQuery.prepare(QStringLiteral("INSERT OR IGNORE INTO ChangeLog (Type, Id) "
+											"SELECT Type, Id FROM DataIndex WHERE Changed = 1"));
+			exec(logQuery);
+			logDebug() << "Moved" << logQuery.numRowsAffected() << "pending changes to the ChangeLog table";
+		}
+
+		//version 4: per type statistics
+		if(!_database->tables().contains(QStringLiteral("TypeStats")))
+			createTypeStats();
+
+		//version 5: type dictionary
+		if(!_database->tables().contains(QStringLiteral("Types")))
+			convertTypeNames();
+
+		//version 6: load counts, all other tables exist already
+		if(!_database->tables().contains(QStringLiteral("AccessCounts")))
+			createDataTables();
+
+		QSqlQuery versionQuery(_database);
+		versionQuery.prepare(QStringLiteral("PRAGMA user_version = %1").arg(SchemaVersion));
+		exec(versionQuery);
+
+		if(!_database->commit())
+			throw LocalStoreException(_defaults, QByteArray("<any>"), _database->databaseName(), _database->lastError().text());
+		logDebug() << "Upgraded database schema to version" << SchemaVersion;
+	} catch(...) {
+		_database->rollback();
+		throw;
 	}
+}
 
-	//complete the file-save (last before commit!)
-	if(!fileCommitFn(device.data()))
-		throw LocalStoreException(_defaults, key, device->fileName(), device->errorString());
+void LocalStore::createDataTables()
+{
+	const QStringList statements {
+		//type names are stored once, all other tables use the id
+		QStringLiteral("CREATE TABLE IF NOT EXISTS Types ( "
+					   "	Id		INTEGER PRIMARY KEY, "
+					   "	Name	TEXT NOT NULL UNIQUE "
+					   ");"),
+		QStringLiteral("CREATE TABLE IF NOT EXISTS DataIndex ("
+					   "	Type		INTEGER NOT NULL,"
+					   "	Id			TEXT NOT NULL,"
+					   "	Version		INTEGER NOT NULL,"
+					   "	File		TEXT,"
+					   "	Checksum	BLOB,"
+					   "	Data		BLOB,"
+					   "	Segment		INTEGER,"
+					   "	Offset		INTEGER,"
+					   "	Length		INTEGER,"
+					   "	Size		INTEGER,"
+					   "	PRIMARY KEY(Type, Id)"
+					   ") WITHOUT ROWID;"),
+		QStringLiteral("CREATE TABLE IF NOT EXISTS DeviceUploads ( "
+					   "	Type	INTEGER NOT NULL, "
+					   "	Id		TEXT NOT NULL, "
+					   "	Device	TEXT NOT NULL, "
+					   "	PRIMARY KEY(Type, Id, Device), "
+					   "	FOREIGN KEY(Type, Id) REFERENCES DataIndex ON DELETE CASCADE "
+					   ") WITHOUT ROWID;"),
+		QStringLiteral("CREATE TABLE IF NOT EXISTS ChangeLog ( "
+					   "	Seq		INTEGER PRIMARY KEY AUTOINCREMENT, "
+					   "	Type	INTEGER NOT NULL, "
+					   "	Id		TEXT NOT NULL, "
+					   "	UNIQUE(Type, Id), "
+					   "	FOREIGN KEY(Type, Id) REFERENCES DataIndex ON DELETE CASCADE "
+					   ");"),
+		//load counts for Setup::PreloadMostUsed, keys may no longer exist
+		QStringLiteral("CREATE TABLE IF NOT EXISTS AccessCounts ( "
+					   "	Type	INTEGER NOT NULL, "
+					   "	Id		TEXT NOT NULL, "
+					   "	Count	INTEGER NOT NULL, "
+					   "	PRIMARY KEY(Type, Id) "
+					   ") WITHOUT ROWID;")
+	};
+	for(const auto &statement : statements) {
+		QSqlQuery createQuery(_database);
+		createQuery.prepare(statement);
+		exec(createQuery);
+	}
+	logDebug() << "Created data tables";
+}
 
-	//update cache
-	_emitter->putCached(key, data, static_cast<int>(info.size()));
+void LocalStore::createIndexTables()
+{
+	const QStringList statements {
+		QStringLiteral("CREATE TABLE IF NOT EXISTS PropertyIndex ( "
+					   "	Type		INTEGER NOT NULL, "
+					   "	Property	TEXT NOT NULL, "
+					   "	Value		NOT NULL, "
+					   "	Id			TEXT NOT NULL, "
+					   "	PRIMARY KEY(Type, Property, Value, Id) "
+					   ") WITHOUT ROWID;"),
+		//needed to remove the entries of a dataset
+		QStringLiteral("CREATE INDEX IF NOT EXISTS PropertyIndexIds ON PropertyIndex (Type, Id)"),
+		QStringLiteral("CREATE TABLE IF NOT EXISTS IndexedProperties ( "
+					   "	Type		INTEGER NOT NULL, "
+					   "	Property	TEXT NOT NULL, "
+					   "	PRIMARY KEY(Type, Property) "
+					   ") WITHOUT ROWID;")
+	};
+	for(const auto &statement : statements) {
+		QSqlQuery createQuery(_database);
+		createQuery.prepare(statement);
+		exec(createQuery);
+	}
+	logDebug() << "Created index tables";
+}
 
-	return [this, key, changed]() {
-		//trigger change signals
-		_emitter->triggerChange(key, false, changed);
+void LocalStore::createFullTextKeyTables()
+{
+	const QStringList statements {
+		//maps the rowids of the virtual table to the datasets
+		QStringLiteral("CREATE TABLE IF NOT EXISTS FullTextKeys ( "
+					   "	Key			INTEGER PRIMARY KEY, "
+					   "	Type		INTEGER NOT NULL, "
+					   "	Id			TEXT NOT NULL, "
+					   "	UNIQUE(Type, Id) "
+					   ");"),
+		QStringLiteral("CREATE TABLE IF NOT EXISTS FullTextTypes ( "
+					   "	Type		INTEGER NOT NULL PRIMARY KEY, "
+					   "	Properties	TEXT NOT NULL "
+					   ") WITHOUT ROWID;")
 	};
+	for(const auto &statement : statements) {
+		QSqlQuery createQuery(_database);
+		createQuery.prepare(statement);
+		exec(createQuery);
+	}
 }
 
-void LocalStore::markUnchangedImpl(const DatabaseRef &db, const ObjectKey &key, quint64 version, bool isDelete)
+void LocalStore::convertTypeNames()
 {
-	QSqlQuery completeQuery(db);
-	if(isDelete && !_defaults.property(Defaults::PersistDeleted).toBool())
-		completeQuery.prepare(QStringLiteral("DELETE FROM DataIndex WHERE Type = ? AND Id = ? AND Version = ? AND File IS NULL"));
+	//the tables are recreated, as SQLite cannot change the type of a primary key column
+	//note: children are dropped first, so the cascading deletes have nothing to remove
+	QStringList prepareStatements {
+		QStringLiteral("CREATE TEMP TABLE DataIndexCopy AS SELECT * FROM DataIndex"),
+		QStringLiteral("CREATE TEMP TABLE DeviceUploadsCopy AS SELECT * FROM DeviceUploads"),
+		QStringLiteral("CREATE TEMP TABLE ChangeLogCopy AS SELECT * FROM ChangeLog"),
+		QStringLiteral("DROP TABLE IF EXISTS TypeStats"),
+		QStringLiteral("DROP TABLE ChangeLog"),
+		QStringLiteral("DROP TABLE DeviceUploads"),
+		QStringLiteral("DROP TABLE DataIndex")
+	};
+	//the index tables have one row per dataset and property, the full text tables only exist once used
+	QStringList indexTables {QStringLiteral("PropertyIndex"), QStringLiteral("IndexedProperties")};
+	const auto hasFullText = _database->tables().contains(QStringLiteral("FullTextKeys"));
+	if(hasFullText)
+		indexTables += {QStringLiteral("FullTextKeys"), QStringLiteral("FullTextTypes")};
+	for(const auto &table : qAsConst(indexTables)) {
+		prepareStatements.append(QStringLiteral("CREATE TEMP TABLE %1Copy AS SELECT * FROM %1").arg(table));
+		prepareStatements.append(QStringLiteral("DROP TABLE %1").arg(table));
+	}
+	for(const auto &statement : qAsConst(prepareStatements)) {
+		QSqlQuery prepareQuery(_database);
+		prepareQuery.prepare(statement);
+		exec(prepareQuery);
+	}
+
+	createDataTables();
+	createIndexTables();
+	if(hasFullText)
+		createFullTextKeyTables();
+
+	QStringList copyStatements {
+		QStringLiteral("INSERT INTO Types (Name) SELECT DISTINCT Type FROM DataIndexCopy"),
+		//indexes can be declared for types without data
+		QStringLiteral("INSERT OR IGNORE INTO Types (Name) SELECT DISTINCT Type FROM IndexedPropertiesCopy"),
+		QStringLiteral("INSERT INTO DataIndex (Type, Id, Version, File, Checksum, Data, Segment, Offset, Length, Size) "
+					   "SELECT Types.Id, c.Id, c.Version, c.File, c.Checksum, c.Data, c.Segment, c.Offset, c.Length, c.Size "
+					   "FROM DataIndexCopy c INNER JOIN Types ON Types.Name = c.Type"),
+		QStringLiteral("INSERT INTO DeviceUploads (Type, Id, Device) "
+					   "SELECT Types.Id, c.Id, c.Device "
+					   "FROM DeviceUploadsCopy c INNER JOIN Types ON Types.Name = c.Type"),
+		QStringLiteral("INSERT INTO ChangeLog (Seq, Type, Id) " //keeps the sequence, so upload order does not change
+					   "SELECT c.Seq, Types.Id, c.Id "
+					   "FROM ChangeLogCopy c INNER JOIN Types ON Types.Name = c.Type"),
+		QStringLiteral("INSERT INTO PropertyIndex (Type, Property, Value, Id) "
+					   "SELECT Types.Id, c.Property, c.Value, c.Id "
+					   "FROM PropertyIndexCopy c INNER JOIN Types ON Types.Name = c.Type"),
+		QStringLiteral("INSERT INTO IndexedProperties (Type, Property) "
+					   "SELECT Types.Id, c.Property "
+					   "FROM IndexedPropertiesCopy c INNER JOIN Types ON Types.Name = c.Type"),
+		QStringLiteral("DROP TABLE DataIndexCopy"),
+		QStringLiteral("DROP TABLE DeviceUploadsCopy"),
+		QStringLiteral("DROP TABLE ChangeLogCopy"),
+		QStringLiteral("DROP TABLE PropertyIndexCopy"),
+		QStringLiteral("DROP TABLE IndexedPropertiesCopy")
+	};
+	if(hasFullText) {
+		copyStatements += {
+			QStringLiteral("INSERT OR IGNORE INTO Types (Name) SELECT DISTINCT Type FROM FullTextTypesCopy"),
+			QStringLiteral("INSERT INTO FullTextKeys (Key, Type, Id) " //keeps the keys, as they are the rowids of the full text index
+						   "SELECT c.Key, Types.Id, c.Id "
+						   "FROM FullTextKeysCopy c INNER JOIN Types ON Types.Name = c.Type"),
+			QStringLiteral("INSERT INTO FullTextTypes (Type, Properties) "
+						   "SELECT Types.Id, c.Properties "
+						   "FROM FullTextTypesCopy c INNER JOIN Types ON Types.Name = c.Type"),
+			QStringLiteral("DROP TABLE FullTextKeysCopy"),
+			QStringLiteral("DROP TABLE FullTextTypesCopy")
+		};
+	}
+	for(const auto &statement : qAsConst(copyStatements)) {
+		QSqlQuery copyQuery(_database);
+		copyQuery.prepare(statement);
+		exec(copyQuery);
+	}
+
+	createTypeStats();
+	logDebug() << "Replaced type names by type ids";
+}
+
+void LocalStore::createTypeStats()
+{
+	//the size of the stored data, to sum it up without reading all the files
+	if(!_database->record(QStringLiteral("DataIndex")).contains(QStringLiteral("Size"))) {
+		QSqlQuery alterQuery(_database);
+		alterQuery.prepare(QStringLiteral("ALTER TABLE DataIndex ADD COLUMN Size INTEGER"));
+		exec(alterQuery);
+
+		QSqlQuery dbSizeQuery(_database);
+		dbSizeQuery.prepare(QStringLiteral("UPDATE DataIndex SET Size = IFNULL(Length, length(Data)) WHERE File = ''"));
+		exec(dbSizeQuery);
+
+		QSqlQuery filesQuery(_database);
+		filesQuery.prepare(QStringLiteral("SELECT Type, Id, File FROM DataIndex WHERE File IS NOT NULL AND File != ''"));
+		exec(filesQuery);
+		QSqlQuery fileSizeQuery(_database);
+		fileSizeQuery.prepare(QStringLiteral("UPDATE DataIndex SET Size = ? WHERE Type = ? AND Id = ?"));
+		while(filesQuery.next()) {
+			const ObjectKey key {filesQuery.value(0).toByteArray(), filesQuery.value(1).toString()};
+			fileSizeQuery.addBindValue(QFileInfo{filePath(key, filesQuery.value(2).toString())}.size());
+			fileSizeQuery.addBindValue(key.typeName);
+			fileSizeQuery.addBindValue(key.id);
+			exec(fileSizeQuery, key);
+		}
+		logDebug() << "Added Size column to DataIndex table";
+	}
+
+	QSqlQuery createQuery(_database);
+	createQuery.prepare(QStringLiteral("CREATE TABLE TypeStats ( "
+									   "	Type	INTEGER NOT NULL, "
+									   "	Objects	INTEGER NOT NULL DEFAULT 0, "
+									   "	Bytes	INTEGER NOT NULL DEFAULT 0, "
+									   "	Changes	INTEGER NOT NULL DEFAULT 0, "
+									   "	DeviceChanges	INTEGER NOT NULL DEFAULT 0, "
+									   "	PRIMARY KEY(Type) "
+									   ") WITHOUT ROWID;"));
+	exec(createQuery);
+
+	//kept up to date by triggers, so every write (including sync and bulk updates) counts within its own transaction
+	//note: INSERT OR REPLACE must not be used on these tables, as the implicit delete does not fire the triggers
+	//DeviceChanges counts the device uploads loadChanges reports, i.e. all except those of datasets with a pending delete
+	const QStringList triggers {
+		QStringLiteral("CREATE TRIGGER TypeStatsInsert AFTER INSERT ON DataIndex BEGIN "
+					   "	INSERT OR IGNORE INTO TypeStats (Type) VALUES(NEW.Type); "
+					   "	UPDATE TypeStats SET "
+					   "		Objects = Objects + (NEW.File IS NOT NULL), "
+					   "		Bytes = Bytes + (CASE WHEN NEW.File IS NULL THEN 0 ELSE IFNULL(NEW.Size, 0) END) "
+					   "	WHERE Type = NEW.Type; "
+					   "END"),
+		QStringLiteral("CREATE TRIGGER TypeStatsUpdate AFTER UPDATE OF File, Size ON DataIndex BEGIN "
+					   "	UPDATE TypeStats SET "
+					   "		Objects = Objects + (NEW.File IS NOT NULL) - (OLD.File IS NOT NULL), "
+					   "		Bytes = Bytes "
+					   "			+ (CASE WHEN NEW.File IS NULL THEN 0 ELSE IFNULL(NEW.Size, 0) END) "
+					   "			- (CASE WHEN OLD.File IS NULL THEN 0 ELSE IFNULL(OLD.Size, 0) END), "
+					   "		DeviceChanges = DeviceChanges "
+					   "			+ ((NEW.File IS NOT NULL) - (OLD.File IS NOT NULL)) "
+					   "			* EXISTS(SELECT 1 FROM ChangeLog WHERE ChangeLog.Type = NEW.Type AND ChangeLog.Id = NEW.Id) "
+					   "			* (SELECT Count(*) FROM DeviceUploads WHERE DeviceUploads.Type = NEW.Type AND DeviceUploads.Id = NEW.Id) "
+					   "	WHERE Type = NEW.Type; "
+					   "END"),
+		QStringLiteral("CREATE TRIGGER TypeStatsDelete AFTER DELETE ON DataIndex BEGIN "
+					   "	UPDATE TypeStats SET "
+					   "		Objects = Objects - (OLD.File IS NOT NULL), "
+					   "		Bytes = Bytes - (CASE WHEN OLD.File IS NULL THEN 0 ELSE IFNULL(OLD.Size, 0) END) "
+					   "	WHERE Type = OLD.Type; "
+					   "END"),
+		QStringLiteral("CREATE TRIGGER TypeStatsLogInsert AFTER INSERT ON ChangeLog BEGIN "
+					   "	INSERT OR IGNORE INTO TypeStats (Type) VALUES(NEW.Type); "
+					   "	UPDATE TypeStats SET "
+					   "		Changes = Changes + 1, "
+					   "		DeviceChanges = DeviceChanges - (SELECT Count(*) FROM DeviceUploads "
+					   "			INNER JOIN DataIndex ON DataIndex.Type = DeviceUploads.Type AND DataIndex.Id = DeviceUploads.Id "
+					   "			WHERE DeviceUploads.Type = NEW.Type AND DeviceUploads.Id = NEW.Id AND DataIndex.File IS NULL) "
+					   "	WHERE Type = NEW.Type; "
+					   "END"),
+		QStringLiteral("CREATE TRIGGER TypeStatsLogDelete AFTER DELETE ON ChangeLog BEGIN "
+					   "	UPDATE TypeStats SET "
+					   "		Changes = Changes - 1, "
+					   "		DeviceChanges = DeviceChanges + (SELECT Count(*) FROM DeviceUploads "
+					   "			INNER JOIN DataIndex ON DataIndex.Type = DeviceUploads.Type AND DataIndex.Id = DeviceUploads.Id "
+					   "			WHERE DeviceUploads.Type = OLD.Type AND DeviceUploads.Id = OLD.Id AND DataIndex.File IS NULL) "
+					   "	WHERE Type = OLD.Type; "
+					   "END"),
+		QStringLiteral("CREATE TRIGGER TypeStatsDeviceInsert AFTER INSERT ON DeviceUploads BEGIN "
+					   "	INSERT OR IGNORE INTO TypeStats (Type) VALUES(NEW.Type); "
+					   "	UPDATE TypeStats SET DeviceChanges = DeviceChanges + (SELECT Count(*) FROM DataIndex "
+					   "		WHERE DataIndex.Type = NEW.Type AND DataIndex.Id = NEW.Id AND NOT (DataIndex.File IS NULL AND "
+					   "			EXISTS(SELECT 1 FROM ChangeLog WHERE ChangeLog.Type = NEW.Type AND ChangeLog.Id = NEW.Id))) "
+					   "	WHERE Type = NEW.Type; "
+					   "END"),
+		QStringLiteral("CREATE TRIGGER TypeStatsDeviceDelete AFTER DELETE ON DeviceUploads BEGIN "
+					   "	UPDATE TypeStats SET DeviceChanges = DeviceChanges - (SELECT Count(*) FROM DataIndex "
+					   "		WHERE DataIndex.Type = OLD.Type AND DataIndex.Id = OLD.Id AND NOT (DataIndex.File IS NULL AND "
+					   "			EXISTS(SELECT 1 FROM ChangeLog WHERE ChangeLog.Type = OLD.Type AND ChangeLog.Id = OLD.Id))) "
+					   "	WHERE Type = OLD.Type; "
+					   "END"),
+		//the cascading delete runs after the dataset is gone, so its uploads could not be counted anymore
+		QStringLiteral("CREATE TRIGGER TypeStatsDeviceCascade BEFORE DELETE ON DataIndex BEGIN "
+					   "	DELETE FROM DeviceUploads WHERE Type = OLD.Type AND Id = OLD.Id; "
+					   "END")
+	};
+	for(const auto &trigger : triggers) {
+		QSqlQuery triggerQuery(_database);
+		triggerQuery.prepare(trigger);
+		exec(triggerQuery);
+	}
+
+	//initial values from the existing data
+	QSqlQuery fillQuery(_database);
+	fillQuery.prepare(QStringLiteral("INSERT INTO TypeStats (Type, Objects, Bytes, Changes, DeviceChanges) "
+									 "SELECT Type, "
+									 "	Sum(File IS NOT NULL), "
+									 "	Sum(CASE WHEN File IS NULL THEN 0 ELSE IFNULL(Size, 0) END), "
+									 "	(SELECT Count(*) FROM ChangeLog WHERE ChangeLog.Type = DataIndex.Type), "
+									 "	(SELECT Count(*) FROM DeviceUploads u "
+									 "		INNER JOIN DataIndex d ON d.Type = u.Type AND d.Id = u.Id "
+									 "		LEFT JOIN ChangeLog c ON c.Type = u.Type AND c.Id = u.Id "
+									 "		WHERE u.Type = DataIndex.Type AND NOT (c.Seq IS NOT NULL AND d.File IS NULL)) "
+									 "FROM DataIndex GROUP BY Type"));
+	exec(fillQuery);
+	logDebug() << "Created TypeStats table";
+}
+
+void LocalStore::updateIndexes()
+{
+	using IndexSet = QSet<QPair<QString, QString>>; //(type, property)
+
+	IndexSet declared;
+	const auto indexes = _defaults.property(Defaults::PropertyIndexes).toHash();
+	for(auto it = indexes.constBegin(); it != indexes.constEnd(); it++) {
+		for(const auto &property : it.value().toStringList())
+			declared.insert({it.key(), property});
+	}
+
+	auto loadRegistered = [this]() {
+		QSqlQuery registeredQuery(_database);
+		registeredQuery.prepare(QStringLiteral("SELECT Types.Name, IndexedProperties.Property FROM IndexedProperties "
+											   "INNER JOIN Types ON Types.Id = IndexedProperties.Type"));
+		exec(registeredQuery);
+		IndexSet registered;
+		while(registeredQuery.next())
+			registered.insert({registeredQuery.value(0).toString(), registeredQuery.value(1).toString()});
+		return registered;
+	};
+
+	//quick check without locking the database, as this is the normal case
+	if(loadRegistered() == declared)
+		return;
+
+	//indexes can be declared for types without data, see registerType
+	for(const auto &index : declared)
+		registerType(index.first.toUtf8());
+
+	beginWriteTransaction(ObjectKey{"any"}, true);
+	try {
+		const auto registered = loadRegistered(); //reload, another store might have already updated them
+
+		//drop indexes that are no longer declared
+		for(const auto &index : registered) {
+			if(declared.contains(index))
+				continue;
+			const auto indexTypeId = typeId(index.first.toUtf8());
+			QSqlQuery dropQuery(_database);
+			dropQuery.prepare(QStringLiteral("DELETE FROM PropertyIndex WHERE Type = ? AND Property = ?"));
+			dropQuery.addBindValue(indexTypeId);
+			dropQuery.addBindValue(index.second);
+			exec(dropQuery);
+
+			QSqlQuery unregisterQuery(_database);
+			unregisterQuery.prepare(QStringLiteral("DELETE FROM IndexedProperties WHERE Type = ? AND Property = ?"));
+			unregisterQuery.addBindValue(indexTypeId);
+			unregisterQuery.addBindValue(index.second);
+			exec(unregisterQuery);
+			logDebug() << "Dropped index on property" << index.second << "of type" << index.first;
+		}
+
+		//build indexes that are new from the existing data
+		for(const auto &index : declared) {
+			if(registered.contains(index))
+				continue;
+			const auto typeName = index.first.toUtf8();
+
+			QSqlQuery dataQuery(_database);
+			dataQuery.setForwardOnly(true);
+			dataQuery.prepare(QStringLiteral("SELECT Id, File, Data FROM DataIndex WHERE Type = ? AND File IS NOT NULL"));
+			dataQuery.addBindValue(typeId(typeName));
+			exec(dataQuery, typeName);
+			while(dataQuery.next()) {
+				ObjectKey key {typeName, dataQuery.value(0).toString()};
+				auto json = readJson(key, dataQuery.value(1).toString(), dataQuery.value(2).toByteArray(), nullptr);
+				const auto value = indexValue(json.value(index.second));
+				if(!value.isValid())
+					continue;
+
+				PreparedQuery insertQuery(_database, InsertIndexStatement, QStringLiteral("INSERT OR REPLACE INTO PropertyIndex (Type, Property, Value, Id) VALUES(?, ?, ?, ?)"));
+				insertQuery.addBindValue(knownTypeId(key));
+				insertQuery.addBindValue(index.second);
+				insertQuery.addBindValue(value);
+				insertQuery.addBindValue(key.id);
+				exec(insertQuery, key);
+			}
+
+			QSqlQuery registerQuery(_database);
+			registerQuery.prepare(QStringLiteral("INSERT INTO IndexedProperties (Type, Property) VALUES(?, ?)"));
+			registerQuery.addBindValue(knownTypeId(ObjectKey{typeName}));
+			registerQuery.addBindValue(index.second);
+			exec(registerQuery, typeName);
+			logDebug() << "Built index on property" << index.second << "of type" << index.first;
+		}
+
+		if(!_database->commit())
+			throw LocalStoreException(_defaults, QByteArray("<any>"), _database->databaseName(), _database->lastError().text());
+	} catch(...) {
+		_database->rollback();
+		throw;
+	}
+}
+
+QStringList LocalStore::indexedProperties(const QByteArray &typeName) const
+{
+	return _defaults.property(Defaults::PropertyIndexes)
+			.toHash()
+			.value(QString::fromUtf8(typeName))
+			.toStringList();
+}
+
+QVariant LocalStore::indexValue(const QJsonValue &value)
+{
+	switch(value.type()) {
+	case QJsonValue::Bool: //as blob, as SQLite has no boolean type and would compare 0 and 1 equal to numbers
+		return value.toBool() ? QByteArrayLiteral("true") : QByteArrayLiteral("false");
+	case QJsonValue::Double:
+		return value.toDouble();
+	case QJsonValue::String:
+		return value.toString();
+	default: //null, undefined, arrays and objects cannot be indexed
+		return {};
+	}
+}
+
+void LocalStore::updateFullTextIndexes()
+{
+	QHash<QString, QString> declared; //type -> properties
+	const auto indexes = _defaults.property(Defaults::FullTextIndexes).toHash();
+	for(auto it = indexes.constBegin(); it != indexes.constEnd(); it++)
+		declared.insert(it.key(), it.value().toStringList().join(QLatin1Char(',')));
+
+	//the virtual table needs sqlite with FTS5, so it is only created once needed
+	if(!_database->tables().contains(QStringLiteral("FullTextIndex"))) {
+		if(declared.isEmpty())
+			return;
+
+		QSqlQuery createQuery(_database);
+		createQuery.prepare(QStringLiteral("CREATE VIRTUAL TABLE IF NOT EXISTS FullTextIndex USING fts5(Content)"));
+		if(!createQuery.exec()) {
+			throw LocalStoreException(_defaults,
+									  QByteArrayLiteral("any"),
+									  createQuery.executedQuery().simplified(),
+									  QStringLiteral("Failed to create full text index, sqlite must support FTS5: %1")
+									  .arg(createQuery.lastError().text()));
+		}
+
+		createFullTextKeyTables();
+		logDebug() << "Created FullTextIndex table";
+	}
+
+	auto loadRegistered = [this]() {
+		QSqlQuery registeredQuery(_database);
+		registeredQuery.prepare(QStringLiteral("SELECT Types.Name, FullTextTypes.Properties FROM FullTextTypes "
+											   "INNER JOIN Types ON Types.Id = FullTextTypes.Type"));
+		exec(registeredQuery);
+		QHash<QString, QString> registered;
+		while(registeredQuery.next())
+			registered.insert(registeredQuery.value(0).toString(), registeredQuery.value(1).toString());
+		return registered;
+	};
+
+	//quick check without locking the database, as this is the normal case
+	if(loadRegistered() == declared)
+		return;
+
+	//indexes can be declared for types without data, see registerType
+	for(auto it = declared.constBegin(); it != declared.constEnd(); it++)
+		registerType(it.key().toUtf8());
+
+	beginWriteTransaction(ObjectKey{"any"}, true);
+	try {
+		const auto registered = loadRegistered(); //reload, another store might have already updated them
+
+		//drop indexes that are no longer declared or have changed properties
+		for(auto it = registered.constBegin(); it != registered.constEnd(); it++) {
+			if(declared.value(it.key()) == it.value())
+				continue;
+			const auto indexTypeId = typeId(it.key().toUtf8());
+
+			QSqlQuery dropQuery(_database);
+			dropQuery.prepare(QStringLiteral("DELETE FROM FullTextIndex WHERE rowid IN (SELECT Key FROM FullTextKeys WHERE Type = ?)"));
+			dropQuery.addBindValue(indexTypeId);
+			exec(dropQuery);
+
+			QSqlQuery dropKeysQuery(_database);
+			dropKeysQuery.prepare(QStringLiteral("DELETE FROM FullTextKeys WHERE Type = ?"));
+			dropKeysQuery.addBindValue(indexTypeId);
+			exec(dropKeysQuery);
+
+			QSqlQuery unregisterQuery(_database);
+			unregisterQuery.prepare(QStringLiteral("DELETE FROM FullTextTypes WHERE Type = ?"));
+			unregisterQuery.addBindValue(indexTypeId);
+			exec(unregisterQuery);
+			logDebug() << "Dropped full text index of type" << it.key();
+		}
+
+		//build indexes that are new from the existing data
+		for(auto it = declared.constBegin(); it != declared.constEnd(); it++) {
+			if(registered.value(it.key()) == it.value())
+				continue;
+			const auto typeName = it.key().toUtf8();
+
+			QSqlQuery dataQuery(_database);
+			dataQuery.setForwardOnly(true);
+			dataQuery.prepare(QStringLiteral("SELECT Id, File, Data FROM DataIndex WHERE Type = ? AND File IS NOT NULL"));
+			dataQuery.addBindValue(typeId(typeName));
+			exec(dataQuery, typeName);
+			while(dataQuery.next()) {
+				ObjectKey key {typeName, dataQuery.value(0).toString()};
+				auto json = readJson(key, dataQuery.value(1).toString(), dataQuery.value(2).toByteArray(), nullptr);
+				storeFullTextImpl(_database, key, json, false);
+			}
+
+			QSqlQuery registerQuery(_database);
+			registerQuery.prepare(QStringLiteral("INSERT INTO FullTextTypes (Type, Properties) VALUES(?, ?)"));
+			registerQuery.addBindValue(knownTypeId(ObjectKey{typeName}));
+			registerQuery.addBindValue(it.value());
+			exec(registerQuery, typeName);
+			logDebug() << "Built full text index of type" << it.key();
+		}
+
+		if(!_database->commit())
+			throw LocalStoreException(_defaults, QByteArray("<any>"), _database->databaseName(), _database->lastError().text());
+	} catch(...) {
+		_database->rollback();
+		throw;
+	}
+}
+
+QStringList LocalStore::fullTextProperties(const QByteArray &typeName) const
+{
+	return _defaults.property(Defaults::FullTextIndexes)
+			.toHash()
+			.value(QString::fromUtf8(typeName))
+			.toStringList();
+}
+
+QString LocalStore::fullTextContent(const QJsonObject &data, const QStringList &properties)
+{
+	QStringList content;
+	for(const auto &property : properties) {
+		const auto value = data.value(property);
+		if(value.isString())
+			content.append(value.toString());
+	}
+	return content.join(QLatin1Char('\n'));
+}
+
+QJsonObject LocalStore::readJson(const ObjectKey &key, const QString &fileName, const QByteArray &inlineData, int *costs) const
+{
+	QJsonDocument doc;
+	QString context;
+	if(fileName.isEmpty()) {
+		if(inlineData.isNull()) //neither a file nor inline: appended to a segment
+			return readSegment(key, costs);
+		doc = parseDocument(inlineData, costs);
+		context = _database->databaseName();
+	} else {
+		QFile file(filePath(key, fileName));
+		if(!file.open(QIODevice::ReadOnly))
+			throw LocalStoreException(_defaults, key, file.fileName(), file.errorString());
+
+		doc = readDocument(file, 0, file.size(), costs);
+		file.close();
+		context = file.fileName();
+	}
+
+	if(!doc.isObject())
+		throw LocalStoreException(_defaults, key, context, QStringLiteral("Stored data contains invalid json data"));
+	return doc.object();
+}
+
+QJsonObject LocalStore::readSegment(const ObjectKey &key, int *costs) const
+{
+	PreparedQuery segmentQuery(_database, LoadSegmentStatement, QStringLiteral("SELECT Segment, Offset, Length FROM DataIndex WHERE Type = ? AND Id = ? AND File IS NOT NULL"));
+	segmentQuery.addBindValue(typeId(key.typeName));
+	segmentQuery.addBindValue(key.id);
+	exec(segmentQuery, key);
+
+	if(!segmentQuery.first() || segmentQuery.value(0).isNull())
+		throw NoDataException(_defaults, key);
+	return readSegment(key,
+					   segmentQuery.value(0).toLongLong(),
+					   segmentQuery.value(1).toLongLong(),
+					   segmentQuery.value(2).toInt(),
+					   costs);
+}
+
+QJsonObject LocalStore::readSegment(const ObjectKey &key, qint64 segment, qint64 offset, int length, int *costs) const
+{
+	QFile file(segmentPath(typeDirectory(key), segment));
+	if(!file.open(QIODevice::ReadOnly))
+		throw LocalStoreException(_defaults, key, file.fileName(), file.errorString());
+
+	auto doc = readDocument(file, offset, length, costs);
+	if(!doc.isObject())
+		throw LocalStoreException(_defaults, key, file.fileName(), QStringLiteral("Stored data contains invalid json data"));
+	return doc.object();
+}
+
+QJsonDocument LocalStore::readDocument(QFile &file, qint64 offset, qint64 size, int *costs)
+{
+	//parse large blocks straight from a mapping, saving the copy into a read buffer
+	auto mapped = size >= MinMapSize ? file.map(offset, size) : nullptr;
+	if(mapped) {
+		auto doc = parseDocument(QByteArray::fromRawData(reinterpret_cast<const char*>(mapped), static_cast<int>(size)), costs);
+		file.unmap(mapped); //the document holds its own copy
+		return doc;
+	} else if(file.seek(offset))
+		return parseDocument(file.read(size), costs);
 	else
-		completeQuery.prepare(QStringLiteral("UPDATE DataIndex SET Changed = 0 WHERE Type = ? AND Id = ? AND Version = ?"));
-	completeQuery.addBindValue(key.typeName);
+		return {};
+}
+
+QJsonDocument LocalStore::parseDocument(const QByteArray &data, int *costs)
+{
+	//compressed data is detected by its header
+	const auto binData = CodecHelper::decode(data);
+	if(costs) //the uncompressed size, as that is what the cache holds
+		*costs = binData.size();
+	return fromStorageFormat(binData);
+}
+
+qint64 LocalStore::typeId(const QByteArray &typeName) const
+{
+	auto it = _typeIds.constFind(typeName);
+	if(it != _typeIds.constEnd())
+		return *it;
+
+	PreparedQuery typeQuery(_database, TypeIdStatement, QStringLiteral("SELECT Id FROM Types WHERE Name = ?"));
+	typeQuery.addBindValue(typeName);
+	exec(typeQuery, typeName);
+	if(!typeQuery.first())
+		return -1; //unknown types have no data, and -1 matches no rows
+	const auto id = typeQuery.value(0).toLongLong();
+	_typeIds.insert(typeName, id);
+	return id;
+}
+
+qint64 LocalStore::knownTypeId(const ObjectKey &key) const
+{
+	const auto id = typeId(key.typeName);
+	if(id == -1) //registerType must be called before any write
+		throw LocalStoreException(_defaults, key, QStringLiteral("Types"), QStringLiteral("Data type was not registered"));
+	return id;
+}
+
+void LocalStore::registerType(const QByteArray &typeName)
+{
+	if(typeId(typeName) != -1)
+		return;
+
+	//committed on its own, before the actual write transaction: a rollback of that one must not invalidate the cached id
+	PreparedQuery insertQuery(_database, InsertTypeStatement, QStringLiteral("INSERT OR IGNORE INTO Types (Name) VALUES(?)"));
+	insertQuery.addBindValue(typeName);
+	exec(insertQuery, typeName);
+	if(typeId(typeName) == -1)
+		throw LocalStoreException(_defaults, typeName, QStringLiteral("Types"), QStringLiteral("Failed to register data type"));
+}
+
+Setup::Durability LocalStore::durability() const
+{
+	return static_cast<Setup::Durability>(_defaults.property(Defaults::Durability).toInt());
+}
+
+void LocalStore::markUnsynced(const QStringList &paths)
+{
+	auto unsynced = _defaults.unsyncedFiles();
+	QMutexLocker _(&unsynced->lock);
+	for(const auto &path : paths)
+		unsynced->paths.insert(path);
+}
+
+void LocalStore::repairDataFiles()
+{
+	//the stored locations are collected first, so the files are read without blocking other connections
+	QList<std::tuple<ObjectKey, QVariantList>> entries;
+	beginReadTransaction();
+	try {
+		QSqlQuery entriesQuery(_database);
+		entriesQuery.setForwardOnly(true);
+		entriesQuery.prepare(QStringLiteral("SELECT Types.Name, DataIndex.Id, DataIndex.Version, DataIndex.File, DataIndex.Segment, DataIndex.Offset, DataIndex.Length FROM DataIndex "
+											"INNER JOIN Types ON Types.Id = DataIndex.Type "
+											"WHERE DataIndex.File IS NOT NULL AND (DataIndex.File != '' OR DataIndex.Segment IS NOT NULL)"));
+		exec(entriesQuery);
+		while(entriesQuery.next()) {
+			entries.append(std::make_tuple(ObjectKey{entriesQuery.value(0).toByteArray(), entriesQuery.value(1).toString()},
+										   QVariantList {
+											   entriesQuery.value(2),
+											   entriesQuery.value(3),
+											   entriesQuery.value(4),
+											   entriesQuery.value(5),
+											   entriesQuery.value(6)
+										   }));
+		}
+
+		if(!_database->commit())
+			throw LocalStoreException(_defaults, ObjectKey{"any"}, _database->databaseName(), _database->lastError().text());
+	} catch(...) {
+		_database->rollback();
+		throw;
+	}
+
+	//find all entries whose file or segment data cannot be read anymore
+	QList<std::tuple<ObjectKey, QVariantList>> brokenEntries;
+	for(const auto &entry : qAsConst(entries)) {
+		const auto &key = std::get<0>(entry);
+		const auto &location = std::get<1>(entry); //version, file, segment, offset, length
+		const auto fileName = location[1].toString();
+		try {
+			if(fileName.isEmpty()) {
+				readSegment(key,
+							location[2].toLongLong(),
+							location[3].toLongLong(),
+							location[4].toInt(),
+							nullptr);
+			} else
+				readJson(key, fileName, QByteArray{}, nullptr);
+		} catch(QException &e) {
+			logWarning() << "Dataset" << key << "has unreadable data. Error:" << e.what();
+			brokenEntries.append(entry);
+		}
+	}
+	entries.clear();
+
+	//files of removed datasets, if the store was stopped before they were deleted
+	removeOrphanedFiles();
+	if(brokenEntries.isEmpty())
+		return;
+
+	//they can't be restored locally, but must not be deleted either, as the delete would be synchronized
+	//instead, they are kept without data and with version 0, so any remote version of them replaces them
+	QList<ObjectKey> brokenKeys;
+	QStringList brokenFiles;
+	beginWriteTransaction();
+	try {
+		//only if still stored at the checked location, a save in between has replaced the data
+		QSqlQuery brokenQuery(_database);
+		brokenQuery.prepare(QStringLiteral("UPDATE DataIndex SET Version = 0, File = NULL, Checksum = NULL, Data = NULL "
+										   "WHERE Type = ? AND Id = ? AND Version = ? AND File = ? AND Segment IS ? AND Offset IS ?"));
+		QSqlQuery uploadsQuery(_database);
+		uploadsQuery.prepare(QStringLiteral("DELETE FROM DeviceUploads WHERE Type = ? AND Id = ?"));
+		for(const auto &entry : qAsConst(brokenEntries)) {
+			const auto &key = std::get<0>(entry);
+			const auto &location = std::get<1>(entry);
+			brokenQuery.addBindValue(typeId(key.typeName));
+			brokenQuery.addBindValue(key.id);
+			brokenQuery.addBindValue(location[0]);
+			brokenQuery.addBindValue(location[1]);
+			brokenQuery.addBindValue(location[2]);
+			brokenQuery.addBindValue(location[3]);
+			exec(brokenQuery, key);
+			if(brokenQuery.numRowsAffected() == 0)
+				continue;
+			brokenKeys.append(key);
+			if(!location[1].toString().isEmpty())
+				brokenFiles.append(filePath(key, location[1].toString()));
+
+			//pending changes would upload a delete
+			storeChangeLogImpl(_database, key, false);
+			uploadsQuery.addBindValue(typeId(key.typeName));
+			uploadsQuery.addBindValue(key.id);
+			exec(uploadsQuery, key);
+			removeIndexImpl(_database, key);
+			removeFullTextImpl(_database, key);
+		}
+
+		if(!_database->commit())
+			throw LocalStoreException(_defaults, ObjectKey{"any"}, _database->databaseName(), _database->lastError().text());
+	} catch(...) {
+		_database->rollback();
+		throw;
+	}
+	if(brokenKeys.isEmpty())
+		return;
+
+	//the files are moved aside, not deleted, so they can still be inspected
+	for(const auto &file : qAsConst(brokenFiles)) {
+		if(!QFile::rename(file, file + QStringLiteral(".broken")))
+			logWarning() << "Failed to move unreadable data file" << file;
+	}
+	for(const auto &key : qAsConst(brokenKeys)) {
+		_emitter->dropCached(key);
+		_emitter->triggerChange(key, true, false);
+	}
+	logWarning() << "Quarantined" << brokenKeys.size()
+				 << "datasets with unreadable data until they are synchronized again:" << brokenKeys;
+}
+
+void LocalStore::removeObsoleteFiles(const QStringList &paths)
+{
+	QStringList failed;
+	for(const auto &path : paths) {
+		if(!QFile::remove(path) && QFile::exists(path)) {
+			logWarning() << "Failed to remove obsolete data file" << path;
+			failed.append(path);
+		}
+	}
+
+	//retried by compactSegments
+	if(!failed.isEmpty()) {
+		auto unsynced = _defaults.unsyncedFiles();
+		QMutexLocker _(&unsynced->lock);
+		for(const auto &path : qAsConst(failed))
+			unsynced->obsolete.insert(path);
+	}
+}
+
+void LocalStore::removeOrphanedFiles()
+{
+	auto storeDir = _defaults.storageDir();
+	if(!storeDir.cd(QStringLiteral("store")))
+		return;
+
+	auto loadReferenced = [this]() {
+		QSqlQuery filesQuery(_database);
+		filesQuery.setForwardOnly(true);
+		filesQuery.prepare(QStringLiteral("SELECT Types.Name, DataIndex.File FROM DataIndex "
+										  "INNER JOIN Types ON Types.Id = DataIndex.Type "
+										  "WHERE DataIndex.File IS NOT NULL AND DataIndex.File != ''"));
+		exec(filesQuery);
+		QHash<QByteArray, QDir> typeDirs;
+		QSet<QString> referenced;
+		while(filesQuery.next()) {
+			const auto typeName = filesQuery.value(0).toByteArray();
+			auto it = typeDirs.find(typeName);
+			if(it == typeDirs.end())
+				it = typeDirs.insert(typeName, typeDirectory(typeName));
+			referenced.insert(filePath(*it, filesQuery.value(1).toString()));
+		}
+		return referenced;
+	};
+
+	QSet<QString> referenced;
+	beginReadTransaction();
+	try {
+		referenced = loadReferenced();
+		if(!_database->commit())
+			throw LocalStoreException(_defaults, ObjectKey{"any"}, _database->databaseName(), _database->lastError().text());
+	} catch(...) {
+		_database->rollback();
+		throw;
+	}
+
+	//walked without a transaction, as this touches the whole store directory
+	QStringList candidates;
+	QDirIterator iterator(storeDir.absolutePath(), {QStringLiteral("*.dat")}, QDir::Files, QDirIterator::Subdirectories);
+	while(iterator.hasNext()) {
+		const auto path = iterator.next();
+		if(!referenced.contains(path))
+			candidates.append(path);
+	}
+
+	//files are only created by writers before their commit, so holding the write lock, unreferenced files are orphans
+	QStringList orphans;
+	if(!candidates.isEmpty()) {
+		beginWriteTransaction();
+		try {
+			referenced = loadReferenced();
+			for(const auto &path : qAsConst(candidates)) {
+				if(!referenced.contains(path))
+					orphans.append(path);
+			}
+			if(!_database->commit())
+				throw LocalStoreException(_defaults, ObjectKey{"any"}, _database->databaseName(), _database->lastError().text());
+		} catch(...) {
+			_database->rollback();
+			throw;
+		}
+	}
+
+	//directories of cleared types, left by older versions
+	for(const auto &trashDir : storeDir.entryList({QStringLiteral("trash_*")}, QDir::Dirs))
+		QDir{storeDir.absoluteFilePath(trashDir)}.removeRecursively();
+
+	for(const auto &orphan : qAsConst(orphans)) {
+		if(!QFile::remove(orphan))
+			logWarning() << "Failed to remove unreferenced data file" << orphan;
+	}
+	if(!orphans.isEmpty())
+		logDebug() << "Removed" << orphans.size() << "unreferenced data files";
+}
+
+void LocalStore::loadAccessCounts(AccessTracker *tracker) const
+{
+	for(const auto &typeName : tracker->trackedTypes()) {
+		const auto type = typeId(typeName);
+		if(type == -1)
+			continue;
+
+		const ObjectKey typeKey{typeName};
+		QSqlQuery countQuery(_database);
+		countQuery.prepare(QStringLiteral("SELECT Id, Count FROM AccessCounts WHERE Type = ?"));
+		countQuery.addBindValue(type);
+		exec(countQuery, typeKey);
+
+		AccessTracker::Counts counts;
+		while(countQuery.next())
+			counts.insert(countQuery.value(0).toString(), countQuery.value(1).toULongLong());
+		tracker->restore(typeName, counts);
+	}
+}
+
+void LocalStore::storeAccessCounts()
+{
+	auto tracker = _defaults.accessTracker();
+	if(!tracker)
+		return;
+	const auto changed = tracker->takeChanged();
+	if(changed.isEmpty())
+		return;
+
+	for(auto it = changed.constBegin(); it != changed.constEnd(); it++)
+		registerType(it.key());
+	beginWriteTransaction();
+	try {
+		//the tracker holds all counted keys, so the stored ones are simply replaced
+		for(auto it = changed.constBegin(); it != changed.constEnd(); it++) {
+			const ObjectKey typeKey{it.key()};
+			const auto type = knownTypeId(typeKey);
+
+			QSqlQuery clearQuery(_database);
+			clearQuery.prepare(QStringLiteral("DELETE FROM AccessCounts WHERE Type = ?"));
+			clearQuery.addBindValue(type);
+			exec(clearQuery, typeKey);
+
+			QSqlQuery insertQuery(_database);
+			insertQuery.prepare(QStringLiteral("INSERT INTO AccessCounts (Type, Id, Count) VALUES(?, ?, ?)"));
+			for(auto cIt = it->constBegin(); cIt != it->constEnd(); cIt++) {
+				insertQuery.bindValue(0, type);
+				insertQuery.bindValue(1, cIt.key());
+				insertQuery.bindValue(2, cIt.value());
+				exec(insertQuery, typeKey);
+			}
+		}
+
+		if(!_database->commit())
+			throw LocalStoreException(_defaults, QByteArray("<any>"), _database->databaseName(), _database->lastError().text());
+	} catch(...) {
+		_database->rollback();
+		throw;
+	}
+}
+
+void LocalStore::flushPending(const QByteArray &typeName) const
+{
+	//writing the journal does not change what is visible via the store
+	auto journal = _defaults.writeJournal();
+	if(journal && journal->contains(typeName))
+		const_cast<LocalStore*>(this)->flushJournal();
+}
+
+WriteJournal::Entries LocalStore::pendingEntries(const QByteArray &typeName) const
+{
+	auto journal = _defaults.writeJournal();
+	return journal ? journal->pending(typeName) : WriteJournal::Entries{};
+}
+
+QSet<QString> LocalStore::storedIds(const QByteArray &typeName, const QStringList &ids) const
+{
+	QSet<QString> stored;
+	for(auto offset = 0; offset < ids.size(); offset += MaxBatchSize) {
+		const auto chunk = ids.mid(offset, MaxBatchSize);
+		QSqlQuery storedQuery(_database);
+		storedQuery.prepare(QStringLiteral("SELECT Id FROM DataIndex WHERE Type = ? AND Id IN (%1) AND File IS NOT NULL")
+							.arg(bindList(chunk.size())));
+		storedQuery.addBindValue(typeId(typeName));
+		for(const auto &id : chunk)
+			storedQuery.addBindValue(id);
+		exec(storedQuery, typeName);
+		while(storedQuery.next())
+			stored.insert(storedQuery.value(0).toString());
+	}
+	return stored;
+}
+
+ObjectCache::LookupResult LocalStore::lookupCached(const ObjectKey &key, QJsonObject &json, quint64 &generation, int *size) const
+{
+	//check if saved, but not written yet. Such data has no generation yet
+	auto journal = _defaults.writeJournal();
+	if(journal && journal->lookup(key, json)) {
+		generation = 0;
+		return ObjectCache::Cached;
+	}
+
+	//check if cached, or known to not exist
+	return _emitter->findCached(key, json, generation, size);
+}
+
+QList<function<void()>> LocalStore::saveBatchImpl(const DatabaseRef &db, const QByteArray &typeName, const QHash<QString, QJsonObject> &data)
+{
+	const ObjectKey typeKey{typeName};
+	const auto ids = data.keys();
+
+	//check which of the entries already exist, in chunks to stay below the bind limit
+	QHash<QString, QPair<quint64, QString>> existing; //id -> (version, file)
+	for(auto offset = 0; offset < ids.size(); offset += MaxBatchSize) {
+		const auto chunk = ids.mid(offset, MaxBatchSize);
+		QSqlQuery existQuery(db);
+		existQuery.prepare(QStringLiteral("SELECT Id, Version, File FROM DataIndex WHERE Type = ? AND Id IN (%1)")
+						   .arg(bindList(chunk.size())));
+		existQuery.addBindValue(typeId(typeName));
+		for(const auto &id : chunk)
+			existQuery.addBindValue(id);
+		exec(existQuery, typeKey);
+		while(existQuery.next()) {
+			existing.insert(existQuery.value(0).toString(),
+							{existQuery.value(1).toULongLong(), existQuery.value(2).toString()});
+		}
+	}
+
+	//perform all store operations, but delay the change signals
+	QList<function<void()>> resFns;
+	resFns.reserve(ids.size());
+	for(auto it = data.constBegin(); it != data.constEnd(); it++) {
+		const auto exists = existing.constFind(it.key());
+		const auto isExisting = exists != existing.constEnd();
+		resFns.append(storeChangedImpl(db,
+									   {typeName, it.key()},
+									   isExisting ? exists->first + 1ull : 1ull,
+									   isExisting ? exists->second : QString(),
+									   it.value(),
+									   true,
+									   isExisting,
+									   false));
+	}
+	return resFns;
+}
+
+QPair<qint64, qint64> LocalStore::appendSegment(const DatabaseRef &db, const ObjectKey &key, const QByteArray &data, int segmentSize, Setup::Durability durability)
+{
+	//continue with the newest segment that is still in use
+	PreparedQuery segmentQuery(db, ActiveSegmentStatement, QStringLiteral("SELECT MAX(Segment) FROM DataIndex WHERE Type = ? AND File IS NOT NULL"));
+	segmentQuery.addBindValue(typeId(key.typeName));
+	exec(segmentQuery, key);
+	qint64 segment = 1;
+	if(segmentQuery.first() && !segmentQuery.value(0).isNull())
+		segment = segmentQuery.value(0).toLongLong();
+
+	const auto tableDir = typeDirectory(key);
+	QFile file(segmentPath(tableDir, segment));
+	while(file.size() >= segmentSize) //full -> start the next one
+		file.setFileName(segmentPath(tableDir, ++segment));
+
+	//appended before the commit: if the transaction fails, the bytes are simply never referenced
+	if(!file.open(QIODevice::WriteOnly | QIODevice::Append))
+		throw LocalStoreException(_defaults, key, file.fileName(), file.errorString());
+	const auto offset = file.size();
+	if(file.write(data) != data.size() || !file.flush())
+		throw LocalStoreException(_defaults, key, file.fileName(), file.errorString());
+	file.close();
+	if(durability == Setup::Full) {
+		if(!syncToDisk(file.fileName()))
+			throw LocalStoreException(_defaults, key, file.fileName(), QStringLiteral("Failed to flush segment file to disk"));
+	} else if(durability == Setup::Normal)
+		markUnsynced({file.fileName(), tableDir.absolutePath()});
+	return {segment, offset};
+}
+
+void LocalStore::compactSegments(const QByteArray &typeName, double threshold)
+{
+	const auto tableDir = typeDirectory(typeName);
+	const auto segmentFiles = tableDir.entryInfoList({QStringLiteral("segment_*.pack")}, QDir::Files);
+	if(segmentFiles.isEmpty())
+		return;
+
+	//write transaction, so no new data is appended while compacting
+	beginWriteTransaction(typeName);
+	try {
+		QSqlQuery liveQuery(_database);
+		liveQuery.prepare(QStringLiteral("SELECT Segment, SUM(Length) FROM DataIndex "
+										 "WHERE Type = ? AND Segment IS NOT NULL AND File IS NOT NULL "
+										 "GROUP BY Segment"));
+		liveQuery.addBindValue(typeId(typeName));
+		exec(liveQuery, typeName);
+		QHash<qint64, qint64> liveBytes;
+		while(liveQuery.next())
+			liveBytes.insert(liveQuery.value(0).toLongLong(), liveQuery.value(1).toLongLong());
+
+		QList<qint64> compactList;
+		qint64 lastSegment = 0;
+		auto removed = 0;
+		for(const auto &info : segmentFiles) {
+			auto ok = false;
+			const auto segment = info.completeBaseName().mid(8).toLongLong(&ok); //strip "segment_"
+			if(!ok)
+				continue;
+			lastSegment = qMax(lastSegment, segment);
+
+			const auto live = liveBytes.value(segment, 0);
+			if(live == 0) {
+				//not referenced anymore, typically compacted by the previous run. Removing it only
+				//now makes sure no reader that started before that run is still using it
+				if(QFile::remove(info.absoluteFilePath()))
+					removed++;
+				else
+					logWarning() << "Failed to remove unused segment file" << info.absoluteFilePath();
+			} else if(1.0 - static_cast<double>(live) / static_cast<double>(info.size()) > threshold)
+				compactList.append(segment);
+		}
+
+		if(!compactList.isEmpty()) {
+			QFile target(segmentPath(tableDir, lastSegment + 1));
+			if(!target.open(QIODevice::WriteOnly | QIODevice::Append))
+				throw LocalStoreException(_defaults, typeName, target.fileName(), target.errorString());
+			auto targetOffset = target.size();
+
+			for(const auto segment : qAsConst(compactList)) {
+				QFile source(segmentPath(tableDir, segment));
+				if(!source.open(QIODevice::ReadOnly))
+					throw LocalStoreException(_defaults, typeName, source.fileName(), source.errorString());
+
+				QSqlQuery entriesQuery(_database);
+				entriesQuery.prepare(QStringLiteral("SELECT Id, Offset, Length FROM DataIndex "
+													"WHERE Type = ? AND Segment = ? AND File IS NOT NULL"));
+				entriesQuery.addBindValue(typeId(typeName));
+				entriesQuery.addBindValue(segment);
+				exec(entriesQuery, typeName);
+				QList<std::tuple<QString, qint64, int>> entries; //collected first, as the rows get updated
+				while(entriesQuery.next()) {
+					entries.append(std::make_tuple(entriesQuery.value(0).toString(),
+												   entriesQuery.value(1).toLongLong(),
+												   entriesQuery.value(2).toInt()));
+				}
+
+				for(const auto &entry : qAsConst(entries)) {
+					const ObjectKey key {typeName, std::get<0>(entry)};
+					const auto length = std::get<2>(entry);
+					QByteArray data;
+					if(source.seek(std::get<1>(entry)))
+						data = source.read(length);
+					if(data.size() != length)
+						throw LocalStoreException(_defaults, key, source.fileName(), QStringLiteral("Segment file is truncated"));
+					if(target.write(data) != length)
+						throw LocalStoreException(_defaults, key, target.fileName(), target.errorString());
+
+					QSqlQuery moveQuery(_database);
+					moveQuery.prepare(QStringLiteral("UPDATE DataIndex SET Segment = ?, Offset = ? WHERE Type = ? AND Id = ?"));
+					moveQuery.addBindValue(lastSegment + 1);
+					moveQuery.addBindValue(targetOffset);
+					moveQuery.addBindValue(typeId(key.typeName));
+					moveQuery.addBindValue(key.id);
+					exec(moveQuery, key);
+					targetOffset += length;
+				}
+			}
+
+			//complete the copy (last before commit!), the moved data must be as durable as before
+			if(!target.flush())
+				throw LocalStoreException(_defaults, typeName, target.fileName(), target.errorString());
+			target.close();
+			if(durability() != Setup::Relaxed && !syncToDisk(target.fileName()))
+				throw LocalStoreException(_defaults, typeName, target.fileName(), QStringLiteral("Failed to flush segment file to disk"));
+		}
+
+		if(!_database->commit())
+			throw LocalStoreException(_defaults, typeName, _database->databaseName(), _database->lastError().text());
+
+		if(!compactList.isEmpty() || removed > 0) {
+			logDebug() << "Compacted" << compactList.size()
+					   << "and removed" << removed
+					   << "segment files of type" << typeName;
+		}
+	} catch(...) {
+		_database->rollback();
+		throw;
+	}
+}
+
+void LocalStore::beginReadTransaction(const ObjectKey &key) const
+{
+	if(!_database->transaction())
+		throw LocalStoreException(_defaults, key, _database->databaseName(), _database->lastError().text());
+}
+
+void LocalStore::beginWriteTransaction(const ObjectKey &key, bool exclusive)
+{
+	QSqlQuery transactQuery(_database);
+	if(!transactQuery.exec(QStringLiteral("BEGIN %1 TRANSACTION")
+						   .arg(exclusive ? QStringLiteral("EXCLUSIVE") : QStringLiteral("IMMEDIATE")))) {
+		throw LocalStoreException(_defaults,
+								  key,
+								  transactQuery.executedQuery().simplified(),
+								  transactQuery.lastError().text());
+	}
+}
+
+void LocalStore::exec(QSqlQuery &query, const ObjectKey &key) const
+{
+	if(!query.exec()) {
+			throw LocalStoreException(_defaults,
+									  key,
+									  query.executedQuery().simplified(),
+									  query.lastError().text());
+	}
+}
+
+function<void()> LocalStore::storeChangedImpl(const DatabaseRef &db, const ObjectKey &key, quint64 version, const QString &fileName, const QJsonObject &data, bool changed, bool existing, bool emitChange)
+{
+	const auto binData = toStorageFormat(data);
+	const auto storedData = CodecHelper::encode(CodecHelper::codecName(_defaults, key.typeName),
+												_defaults.property(Defaults::CompressionThreshold).toInt(),
+												binData);
+	const auto storeInline = storedData.size() < _defaults.property(Defaults::InlineDataLimit).toInt();
+	const auto segmentSize = _defaults.property(Defaults::SegmentSize).toInt();
+	const auto durability = this->durability();
+
+	QString storedName;
+	QString obsoleteFile;
+	QVariant segment{QVariant::LongLong};
+	QVariant offset{QVariant::LongLong};
+	QScopedPointer<QFileDevice> device;
+	function<bool(QFileDevice*)> fileCommitFn;
+
+	if(storeInline) {
+		storedName = QStringLiteral(""); //empty, but not null
+		if(existing && !fileName.isEmpty()) //was stored as file before -> remove it after the commit
+			obsoleteFile = filePath(key, fileName);
+	} else if(segmentSize > 0) {
+		storedName = QStringLiteral(""); //empty, but not null
+		if(existing && !fileName.isEmpty()) //was stored as file before -> remove it after the commit
+			obsoleteFile = filePath(key, fileName);
+		//the previous data in a segment just becomes unused, see compactSegments
+		const auto location = appendSegment(db, key, storedData, segmentSize, durability);
+		segment = location.first;
+		offset = location.second;
+	} else {
+		auto tableDir = typeDirectory(key);
+		if(existing && !fileName.isEmpty() && durability == Setup::Full) {
+			auto file = new QSaveFile(filePath(tableDir, fileName));
+			device.reset(file);
+			if(!file->open(QIODevice::WriteOnly))
+				throw LocalStoreException(_defaults, key, file->fileName(), file->errorString());
+			fileCommitFn = [](QFileDevice *d){
+				return static_cast<QSaveFile*>(d)->commit();
+			};
+		} else {
+			//without full durability, the data goes to a new file instead, so a crash can never leave a partially overwritten one
+			if(existing && !fileName.isEmpty())
+				obsoleteFile = filePath(tableDir, fileName);
+			auto newFileName = shardedName(QStringLiteral("%1XXXXXX")
+										   .arg(QString::fromUtf8(QUuid::createUuid().toRfc4122().toHex())));
+			auto newFilePath = filePath(tableDir, newFileName);
+			if(!tableDir.mkpath(QFileInfo(newFilePath).path()))
+				throw LocalStoreException(_defaults, key, newFilePath, QStringLiteral("Failed to create directory"));
+			auto file = new QTemporaryFile(newFilePath);
+			device.reset(file);
+			if(!file->open())
+				throw LocalStoreException(_defaults, key, file->fileName(), file->errorString());
+			fileCommitFn = [this, durability](QFileDevice *d){
+				auto f = static_cast<QTemporaryFile*>(d);
+				f->close();
+				if(f->error() != QFile::NoError)
+					return false;
+				const QStringList paths {f->fileName(), QFileInfo{f->fileName()}.path()};
+				if(durability == Setup::Full) {
+					for(const auto &path : paths) {
+						if(!syncToDisk(path))
+							return false;
+					}
+				} else if(durability == Setup::Normal)
+					markUnsynced(paths);
+				f->setAutoRemove(false);
+				return true;
+			};
+		}
+
+		//write the data
+		device->write(storedData);
+		if(device->error() != QFile::NoError)
+			throw LocalStoreException(_defaults, key, device->fileName(), device->errorString());
+		QFileInfo storedInfo{device->fileName()};
+		storedName = tableDir.relativeFilePath(storedInfo.dir().filePath(storedInfo.completeBaseName()));
+	}
+
+	//save key in database
+	const auto inlineData = storeInline ? QVariant(storedData) : QVariant(QVariant::ByteArray);
+	const auto length = segment.isNull() ? QVariant(QVariant::Int) : QVariant(storedData.size());
+	if(existing) {
+		PreparedQuery updateQuery(db, UpdateStatement, QStringLiteral("UPDATE DataIndex SET Version = ?, File = ?, Checksum = ?, Data = ?, Segment = ?, Offset = ?, Length = ?, Size = ? WHERE Type = ? AND Id = ?"));
+		updateQuery.addBindValue(version);
+		updateQuery.addBindValue(storedName); //still update file, in case it was set to NULL
+		updateQuery.addBindValue(SyncHelper::jsonHash(data));
+		updateQuery.addBindValue(inlineData);
+		updateQuery.addBindValue(segment);
+		updateQuery.addBindValue(offset);
+		updateQuery.addBindValue(length);
+		updateQuery.addBindValue(storedData.size());
+		updateQuery.addBindValue(typeId(key.typeName));
+		updateQuery.addBindValue(key.id);
+		exec(updateQuery, key);
+	} else {
+		PreparedQuery insertQuery(db, InsertStatement, QStringLiteral("INSERT INTO DataIndex (Type, Id, Version, File, Checksum, Data, Segment, Offset, Length, Size) VALUES(?, ?, ?, ?, ?, ?, ?, ?, ?, ?)"));
+		insertQuery.addBindValue(knownTypeId(key));
+		insertQuery.addBindValue(key.id);
+		insertQuery.addBindValue(version);
+		insertQuery.addBindValue(storedName);
+		insertQuery.addBindValue(SyncHelper::jsonHash(data));
+		insertQuery.addBindValue(inlineData);
+		insertQuery.addBindValue(segment);
+		insertQuery.addBindValue(offset);
+		insertQuery.addBindValue(length);
+		insertQuery.addBindValue(storedData.size());
+		exec(insertQuery, key);
+	}
+	storeChangeLogImpl(db, key, changed);
+	storeIndexImpl(db, key, data, existing);
+	storeFullTextImpl(db, key, data, existing);
+
+	//complete the file-save (last before commit!)
+	if(device && !fileCommitFn(device.data()))
+		throw LocalStoreException(_defaults, key, device->fileName(), device->errorString());
+
+	const auto costs = binData.size();
+	return [this, key, data, costs, changed, obsoleteFile, emitChange]() {
+		//update cache, only now loads can find the key in the database
+		//replaces the missing entry of the key under the same lock, so readers never see both
+		_emitter->putCached(key, data, costs);
+		//remove the file of data that was moved into the database
+		if(!obsoleteFile.isNull())
+			removeObsoleteFiles({obsoleteFile});
+		//trigger change signals
+		if(emitChange)
+			_emitter->triggerChange(key, false, changed);
+	};
+}
+
+void LocalStore::storeIndexImpl(const DatabaseRef &db, const ObjectKey &key, const QJsonObject &data, bool existing)
+{
+	const auto properties = indexedProperties(key.typeName);
+	if(properties.isEmpty())
+		return;
+
+	if(existing)
+		removeIndexImpl(db, key);
+	for(const auto &property : properties) {
+		const auto value = indexValue(data.value(property));
+		if(!value.isValid())
+			continue;
+
+		PreparedQuery insertQuery(db, InsertIndexStatement, QStringLiteral("INSERT OR REPLACE INTO PropertyIndex (Type, Property, Value, Id) VALUES(?, ?, ?, ?)"));
+		insertQuery.addBindValue(knownTypeId(key));
+		insertQuery.addBindValue(property);
+		insertQuery.addBindValue(value);
+		insertQuery.addBindValue(key.id);
+		exec(insertQuery, key);
+	}
+}
+
+void LocalStore::removeIndexImpl(const DatabaseRef &db, const ObjectKey &key)
+{
+	if(indexedProperties(key.typeName).isEmpty())
+		return;
+
+	PreparedQuery removeQuery(db, RemoveIndexStatement, QStringLiteral("DELETE FROM PropertyIndex WHERE Type = ? AND Id = ?"));
+	removeQuery.addBindValue(typeId(key.typeName));
+	removeQuery.addBindValue(key.id);
+	exec(removeQuery, key);
+}
+
+void LocalStore::storeFullTextImpl(const DatabaseRef &db, const ObjectKey &key, const QJsonObject &data, bool existing)
+{
+	const auto properties = fullTextProperties(key.typeName);
+	if(properties.isEmpty())
+		return;
+
+	if(existing)
+		removeFullTextImpl(db, key);
+	const auto content = fullTextContent(data, properties);
+	if(content.isEmpty())
+		return;
+
+	PreparedQuery keyQuery(db, InsertFullTextKeyStatement, QStringLiteral("INSERT INTO FullTextKeys (Type, Id) VALUES(?, ?)"));
+	keyQuery.addBindValue(knownTypeId(key));
+	keyQuery.addBindValue(key.id);
+	exec(keyQuery, key);
+
+	PreparedQuery insertQuery(db, InsertFullTextStatement, QStringLiteral("INSERT INTO FullTextIndex (rowid, Content) VALUES(?, ?)"));
+	insertQuery.addBindValue(keyQuery.lastInsertId());
+	insertQuery.addBindValue(content);
+	exec(insertQuery, key);
+}
+
+void LocalStore::removeFullTextImpl(const DatabaseRef &db, const ObjectKey &key)
+{
+	if(fullTextProperties(key.typeName).isEmpty())
+		return;
+
+	PreparedQuery keyQuery(db, FullTextKeyStatement, QStringLiteral("SELECT Key FROM FullTextKeys WHERE Type = ? AND Id = ?"));
+	keyQuery.addBindValue(typeId(key.typeName));
+	keyQuery.addBindValue(key.id);
+	exec(keyQuery, key);
+	if(!keyQuery.first())
+		return;
+	const auto rowId = keyQuery.value(0);
+
+	PreparedQuery removeQuery(db, RemoveFullTextStatement, QStringLiteral("DELETE FROM FullTextIndex WHERE rowid = ?"));
+	removeQuery.addBindValue(rowId);
+	exec(removeQuery, key);
+
+	PreparedQuery removeKeyQuery(db, RemoveFullTextKeyStatement, QStringLiteral("DELETE FROM FullTextKeys WHERE Key = ?"));
+	removeKeyQuery.addBindValue(rowId);
+	exec(removeKeyQuery, key);
+}
+
+void LocalStore::storeChangeLogImpl(const DatabaseRef &db, const ObjectKey &key, bool changed)
+{
+	//a new change replaces the entry, so it gets a new sequence number and is uploaded again
+	PreparedQuery unlogQuery(db, UnlogChangeStatement, QStringLiteral("DELETE FROM ChangeLog WHERE Type = ? AND Id = ?"));
+	unlogQuery.addBindValue(typeId(key.typeName));
+	unlogQuery.addBindValue(key.id);
+	exec(unlogQuery, key);
+
+	if(changed) {
+		PreparedQuery logQuery(db, LogChangeStatement, QStringLiteral("INSERT INTO ChangeLog (Type, Id) VALUES(?, ?)"));
+		logQuery.addBindValue(knownTypeId(key));
+		logQuery.addBindValue(key.id);
+		exec(logQuery, key);
+	}
+}
+
+void LocalStore::markUnchangedImpl(const DatabaseRef &db, const ObjectKey &key, quint64 version, bool isDelete)
+{
+	//only completes the change if it was not changed again in the meantime
+	PreparedQuery completeQuery(db,
+								CompleteChangeStatement,
+								QStringLiteral("DELETE FROM ChangeLog WHERE Type = ? AND Id = ? AND EXISTS ( "
+											   "	SELECT 1 FROM DataIndex "
+											   "	WHERE DataIndex.Type = ChangeLog.Type AND DataIndex.Id = ChangeLog.Id AND Version = ? "
+											   ")"));
+	completeQuery.addBindValue(typeId(key.typeName));
 	completeQuery.addBindValue(key.id);
 	completeQuery.addBindValue(version);
-	exec(completeQuery);
+	exec(completeQuery, key);
+
+	if(isDelete && !_defaults.property(Defaults::PersistDeleted).toBool()) {
+		PreparedQuery deleteQuery(db, CompleteDeleteStatement, QStringLiteral("DELETE FROM DataIndex WHERE Type = ? AND Id = ? AND Version = ? AND File IS NULL"));
+		deleteQuery.addBindValue(typeId(key.typeName));
+		deleteQuery.addBindValue(key.id);
+		deleteQuery.addBindValue(version);
+		exec(deleteQuery, key);
+	}
 }
 
 // ------------- SyncScope -------------
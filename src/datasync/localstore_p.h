@@ -7,6 +7,8 @@
 #include <QtCore/QObject>
 #include <QtCore/QPointer>
 #include <QtCore/QJsonObject>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QFile>
 #include <QtCore/QUuid>
 
 #include <QtSql/QSqlDatabase>
@@ -17,6 +19,8 @@
 #include "logger.h"
 #include "exception.h"
 #include "datastore.h"
+#include "objectcache_p.h"
+#include "writejournal_p.h"
 
 namespace QtDataSync {
 
@@ -58,23 +62,48 @@ public:
 	~LocalStore() override;
 
 	QJsonObject readJson(const ObjectKey &key, const QString &filePath, int *costs = nullptr) const;
+	void migrateInlineData();
+	void migrateFileLayout();
+	void compactSegments();
+	void flushJournal(); //writes all journaled saves of the setup, see Setup::writeBehindDelay
+	void recover(); //checks the data files after an unclean shutdown, see Setup::durability
+	void checkpoint(bool shutdown = false); //flushes data files written since the last checkpoint, stores the load counts
+	void warmCache(); //loads the datasets of the Setup::setCachePreload policies, never throws
+
+	// on disk format of a dataset, both formats are read
+	static QByteArray toStorageFormat(const QJsonObject &data);
+	static QJsonDocument fromStorageFormat(const QByteArray &data);
 
 	// normal store access
 	quint64 count(const QByteArray &typeName) const;
+	quint64 storedSize(const QByteArray &typeName) const; //in bytes, as written to disk
 	QStringList keys(const QByteArray &typeName) const;
+	QStringList keys(const QByteArray &typeName, int offset, int limit) const;
+	QList<QPair<QString, QJsonObject>> loadPage(const QByteArray &typeName, const QString &after, int limit) const; //(key, data), sorted by key
+	void iterate(const QByteArray &typeName, const std::function<bool(ObjectKey, QJsonObject)> &visitor) const; //(key, data)
 	QList<QJsonObject> loadAll(const QByteArray &typeName) const;
 
 	QJsonObject load(const ObjectKey &key) const;
+	bool tryLoad(const ObjectKey &key, QJsonObject &data) const; //false instead of a NoDataException
+	bool tryLoad(const ObjectKey &key, QJsonObject &data, quint64 &generation, int &size) const; //generation and size of the cached data, generation is 0 if not cached
+	bool contains(const ObjectKey &key) const;
+	QList<QJsonObject> loadMany(const QByteArray &typeName, const QStringList &ids) const;
 	void save(const ObjectKey &key, const QJsonObject &data);
+	void saveBatch(const QByteArray &typeName, const QHash<QString, QJsonObject> &data);
 	bool remove(const ObjectKey &key);
+	QStringList removeMany(const QByteArray &typeName, const QStringList &ids);
 
 	QList<QJsonObject> find(const QByteArray &typeName, const QString &query, DataStore::SearchMode mode) const;
+	void find(const QByteArray &typeName, const QString &query, DataStore::SearchMode mode, const std::function<bool(ObjectKey, QJsonObject)> &visitor) const; //(key, data)
+	QList<QJsonObject> findBy(const QByteArray &typeName, const QString &property, const QJsonValue &value) const;
+	QList<QJsonObject> fullTextSearch(const QByteArray &typeName, const QString &query, int limit) const; //sorted by rank
 	void clear(const QByteArray &typeName);
 	void reset(bool keepData);
 
 	// change access
 	quint32 changeCount() const;
 	void loadChanges(int limit, const std::function<bool(ObjectKey, quint64, QString, QUuid)> &visitor) const; //(key, version, file, device)
+	void loadChanges(int limit, quint64 afterSeq, const std::function<bool(quint64, ObjectKey, quint64, QString, QUuid)> &visitor) const; //(seq, key, version, file, device), seq is 0 for device changes
 	void markUnchanged(const ObjectKey &key, quint64 version, bool isDelete);
 	void removeDeviceChange(const ObjectKey &key, QUuid deviceId);
 
@@ -107,15 +136,108 @@ Q_SIGNALS:
 	void dataResetted();
 
 private:
+	//ids for the per connection statement cache, see DatabaseRef::preparedQuery
+	enum StatementId {
+		LoadDataStatement,
+		CountStatement,
+		KeysStatement,
+		KeysPageStatement,
+		LoadPageStatement,
+		LoadAllStatement,
+		IterateStatement,
+		LoadStatement,
+		ExistsStatement,
+		RemoveInfoStatement,
+		RemoveStatement,
+		ChangeCountStatement,
+		LoadChangesStatement,
+		LoadDeviceChangesStatement,
+		RemoveDeviceChangeStatement,
+		LoadChangeInfoStatement,
+		UpdateVersionStatement,
+		LoadFileStatement,
+		StoreDeletedStatement,
+		InsertDeletedStatement,
+		UpdateStatement,
+		InsertStatement,
+		CompleteDeleteStatement,
+		CompleteChangeStatement,
+		FindByStatement,
+		RemoveIndexStatement,
+		InsertIndexStatement,
+		FullTextSearchStatement,
+		FullTextKeyStatement,
+		RemoveFullTextStatement,
+		RemoveFullTextKeyStatement,
+		InsertFullTextKeyStatement,
+		InsertFullTextStatement,
+		LoadSegmentStatement,
+		ActiveSegmentStatement,
+		LogChangeStatement,
+		UnlogChangeStatement,
+		StoredSizeStatement,
+		TypeIdStatement,
+		InsertTypeStatement,
+		ContainsStatement
+	};
+
+	static const int SchemaVersion;
+	static const int MaxBatchSize;
+	static const qint64 MinMapSize;
+
 	Defaults _defaults;
 	Logger *_logger;
 	EmitterAdapter *_emitter;
 	DatabaseRef _database;
+	mutable QHash<QByteArray, qint64> _typeIds; //type name -> id in the Types table, never change once created
 
 	QDir typeDirectory(const ObjectKey &key) const;
 	QString filePath(const QDir &typeDir, const QString &baseName) const;
 	QString filePath(const ObjectKey &key, const QString &baseName) const;
+	QString segmentPath(const QDir &typeDir, qint64 segment) const;
+	static QString shardedName(const QString &baseName);
+
+	static QString bindList(int count);
+	static QString searchPattern(const QString &query, DataStore::SearchMode mode);
+	static QString findStatement(DataStore::SearchMode mode);
 
+	void streamRows(const QByteArray &typeName, QSqlQuery &query, const std::function<bool(ObjectKey, QJsonObject)> &visitor) const;
+
+	void createDataTables();
+	void createIndexTables();
+	void createFullTextKeyTables();
+	void upgradeSchema();
+	void createTypeStats();
+	void convertTypeNames();
+
+	qint64 typeId(const QByteArray &typeName) const; //-1 if unknown
+	qint64 knownTypeId(const ObjectKey &key) const;
+	void registerType(const QByteArray &typeName);
+	void updateIndexes();
+	QStringList indexedProperties(const QByteArray &typeName) const;
+	static QVariant indexValue(const QJsonValue &value);
+	void updateFullTextIndexes();
+	QStringList fullTextProperties(const QByteArray &typeName) const;
+	static QString fullTextContent(const QJsonObject &data, const QStringList &properties);
+	QJsonObject readJson(const ObjectKey &key, const QString &fileName, const QByteArray &inlineData, int *costs) const;
+	QJsonObject readSegment(const ObjectKey &key, int *costs) const;
+	QJsonObject readSegment(const ObjectKey &key, qint64 segment, qint64 offset, int length, int *costs) const;
+	static QJsonDocument readDocument(QFile &file, qint64 offset, qint64 size, int *costs);
+	static QJsonDocument parseDocument(const QByteArray &data, int *costs);
+	QPair<qint64, qint64> appendSegment(const DatabaseRef &db, const ObjectKey &key, const QByteArray &data, int segmentSize, Setup::Durability durability); //(segment, offset)
+	void compactSegments(const QByteArray &typeName, double threshold);
+
+	void loadAccessCounts(AccessTracker *tracker) const;
+	void storeAccessCounts();
+	void flushPending(const QByteArray &typeName) const; //for queries that cannot include the journal, see pendingEntries
+	WriteJournal::Entries pendingEntries(const QByteArray &typeName) const; //journaled saves, read them before the database
+	QSet<QString> storedIds(const QByteArray &typeName, const QStringList &ids) const;
+	ObjectCache::LookupResult lookupCached(const ObjectKey &key, QJsonObject &json, quint64 &generation, int *size = nullptr) const; //journal and cache, generation for EmitterAdapter::putMissing
+	Setup::Durability durability() const;
+	void markUnsynced(const QStringList &paths);
+	void repairDataFiles();
+	void removeObsoleteFiles(const QStringList &paths); //after the commit that unreferenced them
+	void removeOrphanedFiles();
 	void beginReadTransaction(const ObjectKey &key = ObjectKey{"any"}) const;
 	void beginWriteTransaction(const ObjectKey &key = ObjectKey{"any"}, bool exclusive = false);
 	void exec(QSqlQuery &query, const ObjectKey &key = ObjectKey{"any"}) const;
@@ -126,7 +248,22 @@ private:
 																 const QString &filePath,
 																 const QJsonObject &data,
 																 bool changed,
-																 bool existing);
+																 bool existing,
+																 bool emitChange = true);
+	void storeIndexImpl(const DatabaseRef &db,
+						const ObjectKey &key,
+						const QJsonObject &data,
+						bool existing);
+	void removeIndexImpl(const DatabaseRef &db, const ObjectKey &key);
+	void storeChangeLogImpl(const DatabaseRef &db, const ObjectKey &key, bool changed);
+	Q_REQUIRED_RESULT QList<std::function<void()>> saveBatchImpl(const DatabaseRef &db,
+																const QByteArray &typeName,
+																const QHash<QString, QJsonObject> &data);
+	void storeFullTextImpl(const DatabaseRef &db,
+						   const ObjectKey &key,
+						   const QJsonObject &data,
+						   bool existing);
+	void removeFullTextImpl(const DatabaseRef &db, const ObjectKey &key);
 	void markUnchangedImpl(const DatabaseRef &db,
 						   const ObjectKey &key,
 						   quint64 version,
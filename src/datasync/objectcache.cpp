@@ -0,0 +1,233 @@
+#include "objectcache_p.h"
+#include "cachestatistics_p.h"
+using namespace QtDataSync;
+
+const int ObjectCache::MinShardCost = 1024 * 1024;
+const int ObjectCache::MaxShardCount = 16;
+
+ObjectCache::ObjectCache(int maxCost) :
+	_maxCost{maxCost}
+{
+	//small caches get less shards, so single large objects still fit
+	while(_shardCount < MaxShardCount && _maxCost / (_shardCount * 2) >= MinShardCost)
+		_shardCount *= 2;
+	_shardCost = _maxCost / _shardCount;
+	_shards.reset(new Shard[_shardCount]);
+}
+
+int ObjectCache::maxCost() const
+{
+	return _maxCost;
+}
+
+int ObjectCache::totalCost() const
+{
+	auto cost = 0;
+	for(auto i = 0; i < _shardCount; i++) {
+		QReadLocker _(&_shards[i].lock);
+		cost += _shards[i].totalCost;
+	}
+	return cost;
+}
+
+int ObjectCache::count() const
+{
+	auto count = 0;
+	for(auto i = 0; i < _shardCount; i++) {
+		QReadLocker _(&_shards[i].lock);
+		count += _shards[i].index.size();
+	}
+	return count;
+}
+
+CacheStatistics ObjectCache::statistics() const
+{
+	CacheStatistics statistics;
+	statistics.d->maxCost = _maxCost;
+	for(auto i = 0; i < _shardCount; i++) {
+		const auto &s = _shards[i];
+		QReadLocker _(&s.lock);
+		statistics.d->hits += s.hits.load();
+		statistics.d->misses += s.misses.load();
+		statistics.d->inserts += s.inserts;
+		statistics.d->evictions += s.evictions;
+		statistics.d->invalidations += s.invalidations;
+		statistics.d->count += s.index.size();
+		statistics.d->totalCost += s.totalCost;
+	}
+	return statistics;
+}
+
+bool ObjectCache::lookup(const ObjectKey &key, QJsonObject &data) const
+{
+	quint64 generation;
+	return find(key, data, generation) == Cached;
+}
+
+ObjectCache::LookupResult ObjectCache::find(const ObjectKey &key, QJsonObject &data, quint64 &generation, int *cost) const
+{
+	const auto &s = shard(key);
+	QReadLocker _(&s.lock);
+	auto it = s.index.constFind(key);
+	if(it == s.index.constEnd()) {
+		s.misses.fetchAndAddRelaxed(1);
+		generation = s.generation;
+		return NotCached;
+	}
+
+	s.hits.fetchAndAddRelaxed(1);
+	const auto &entry = s.slots.at(*it);
+	entry.referenced.store(1); //second chance for the clock, no write lock needed
+	if(entry.missing)
+		return Missing;
+	data = entry.data;
+	generation = entry.generation;
+	if(cost)
+		*cost = entry.cost;
+	return Cached;
+}
+
+bool ObjectCache::insert(const ObjectKey &key, const QJsonObject &data, int cost, quint64 *generation)
+{
+	auto &s = shard(key);
+	QWriteLocker _(&s.lock);
+	s.generation++;
+	if(!s.store(key, data, cost, false, _shardCost))
+		return false;
+	if(generation)
+		*generation = s.generation;
+	return true;
+}
+
+bool ObjectCache::insertMissing(const ObjectKey &key, quint64 generation)
+{
+	auto &s = shard(key);
+	QWriteLocker _(&s.lock);
+	//a save between the find and the database query could not be seen by the query
+	if(s.generation != generation)
+		return false;
+	const auto cost = key.typeName.size() + key.id.size() * static_cast<int>(sizeof(QChar));
+	return s.store(key, {}, cost, true, _shardCost);
+}
+
+void ObjectCache::removeMissing(const ObjectKey &key)
+{
+	auto &s = shard(key);
+	QWriteLocker _(&s.lock);
+	s.generation++;
+	auto slot = s.index.value(key, -1);
+	if(slot != -1 && s.slots[slot].missing)
+		s.release(slot);
+}
+
+bool ObjectCache::remove(const ObjectKey &key, bool remote)
+{
+	auto &s = shard(key);
+	//check if cached, remote changes might have saved a missing key and must always be recorded
+	if(!remote) {
+		QReadLocker _(&s.lock);
+		if(!s.index.contains(key))
+			return false;
+	}
+
+	QWriteLocker _(&s.lock);
+	if(remote)
+		s.generation++;
+	auto slot = s.index.value(key, -1);
+	if(slot == -1)
+		return false;
+	s.release(slot);
+	if(remote)
+		s.invalidations++;
+	return true;
+}
+
+void ObjectCache::remove(const QByteArray &typeName, const QStringList &ids, bool remote)
+{
+	for(const auto &id : ids)
+		remove({typeName, id}, remote);
+}
+
+void ObjectCache::clear(bool remote)
+{
+	for(auto i = 0; i < _shardCount; i++) {
+		auto &s = _shards[i];
+		QWriteLocker _(&s.lock);
+		if(remote)
+			s.invalidations += static_cast<quint64>(s.index.size());
+		s.generation++;
+		s.index.clear();
+		s.slots.clear();
+		s.freeSlots.clear();
+		s.hand = 0;
+		s.totalCost = 0;
+	}
+}
+
+ObjectCache::Shard &ObjectCache::shard(const ObjectKey &key) const
+{
+	auto hash = qHash(key);
+	hash ^= hash >> 16; //use the high bits for the shard selection as well
+	return _shards.data()[hash & static_cast<uint>(_shardCount - 1)];
+}
+
+
+
+bool ObjectCache::Shard::store(const ObjectKey &key, const QJsonObject &data, int cost, bool missing, int maxCost)
+{
+	auto slot = index.value(key, -1);
+	if(slot != -1)
+		release(slot);
+	if(cost > maxCost)
+		return false;
+
+	while(totalCost + cost > maxCost && evictOne());
+	if(freeSlots.isEmpty()) {
+		slot = slots.size();
+		slots.append(Entry{});
+	} else
+		slot = freeSlots.takeLast();
+
+	auto &entry = slots[slot];
+	entry.key = key;
+	entry.data = data;
+	entry.cost = cost;
+	entry.generation = generation;
+	entry.missing = missing;
+	entry.referenced.store(0);
+	index.insert(key, slot);
+	totalCost += cost;
+	inserts++;
+	return true;
+}
+
+void ObjectCache::Shard::release(int slot)
+{
+	auto &entry = slots[slot];
+	index.remove(entry.key);
+	totalCost -= entry.cost;
+	entry.key = {};
+	entry.data = {};
+	entry.cost = -1;
+	entry.generation = 0;
+	entry.missing = false;
+	freeSlots.append(slot);
+}
+
+bool ObjectCache::Shard::evictOne()
+{
+	//two rounds at most: the first one clears all reference bits
+	for(auto steps = 2 * slots.size(); steps > 0; steps--) {
+		if(hand >= slots.size())
+			hand = 0;
+		auto &entry = slots[hand++];
+		if(entry.cost == -1)
+			continue;
+		if(entry.referenced.fetchAndStoreRelaxed(0) == 0) {
+			release(hand - 1);
+			evictions++;
+			return true;
+		}
+	}
+	return false;
+}
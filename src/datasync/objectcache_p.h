@@ -0,0 +1,92 @@
+#ifndef QTDATASYNC_OBJECTCACHE_P_H
+#define QTDATASYNC_OBJECTCACHE_P_H
+
+#include <QtCore/QHash>
+#include <QtCore/QVector>
+#include <QtCore/QStringList>
+#include <QtCore/QJsonObject>
+#include <QtCore/QReadWriteLock>
+#include <QtCore/QAtomicInt>
+#include <QtCore/QScopedArrayPointer>
+
+#include "qtdatasync_global.h"
+#include "objectkey.h"
+#include "cachestatistics.h"
+
+namespace QtDataSync {
+
+//cache of loaded json data, shared by all stores of a setup, see Setup::cacheSize
+//split into shards with their own lock and CLOCK eviction, so lookups only need a read lock
+//keys known to not exist are cached as well, with the size of the key as costs
+class Q_DATASYNC_EXPORT ObjectCache
+{
+	Q_DISABLE_COPY(ObjectCache)
+
+public:
+	enum LookupResult {
+		NotCached,
+		Cached,
+		Missing
+	};
+
+	explicit ObjectCache(int maxCost);
+
+	int maxCost() const;
+	int totalCost() const;
+	int count() const;
+	CacheStatistics statistics() const;
+
+	bool lookup(const ObjectKey &key, QJsonObject &data) const; //data is a shallow copy of the cached object
+	LookupResult find(const ObjectKey &key, QJsonObject &data, quint64 &generation, int *cost = nullptr) const; //generation of the entry if cached, else needed for insertMissing
+	bool insert(const ObjectKey &key, const QJsonObject &data, int cost, quint64 *generation = nullptr); //false if cost exceeds the shard size. Always replaces a missing entry
+	bool insertMissing(const ObjectKey &key, quint64 generation); //false if the key might have been saved since the find
+	void removeMissing(const ObjectKey &key); //must be called after the key was saved and committed
+	bool remove(const ObjectKey &key, bool remote = false); //remote removals count as invalidations and reject pending insertMissing calls
+	void remove(const QByteArray &typeName, const QStringList &ids, bool remote = false);
+	void clear(bool remote = false);
+
+private:
+	struct Entry {
+		ObjectKey key;
+		QJsonObject data;
+		int cost = -1; //-1 for free slots
+		quint64 generation = 0; //unique per key and data, as long as the entry is cached
+		bool missing = false;
+		mutable QAtomicInt referenced; //set by lookups under the read lock
+	};
+
+	struct Shard {
+		mutable QReadWriteLock lock;
+		QHash<ObjectKey, int> index; //key -> slot
+		QVector<Entry> slots;
+		QVector<int> freeSlots;
+		int hand = 0; //clock hand, next slot to check for eviction
+		int totalCost = 0;
+		quint64 generation = 0; //increased whenever a key of the shard might have been saved
+
+		//statistics, lookups only hold the read lock
+		mutable QAtomicInteger<quint64> hits;
+		mutable QAtomicInteger<quint64> misses;
+		quint64 inserts = 0;
+		quint64 evictions = 0;
+		quint64 invalidations = 0;
+
+		bool store(const ObjectKey &key, const QJsonObject &data, int cost, bool missing, int maxCost);
+		void release(int slot);
+		bool evictOne();
+	};
+
+	static const int MinShardCost;
+	static const int MaxShardCount;
+
+	const int _maxCost;
+	int _shardCount = 1; //always a power of 2
+	int _shardCost;
+	QScopedArrayPointer<Shard> _shards;
+
+	Shard &shard(const ObjectKey &key) const;
+};
+
+}
+
+#endif // QTDATASYNC_OBJECTCACHE_P_H
@@ -187,6 +187,56 @@ qint32 Setup::cipherKeySize() const
 	return d->properties.value(Defaults::SymKeyParam).toInt();
 }
 
+int Setup::inlineDataLimit() const
+{
+	return d->properties.value(Defaults::InlineDataLimit).toInt();
+}
+
+DatabaseConfig Setup::databaseConfiguration() const
+{
+	return d->properties.value(Defaults::DatabaseConfiguration).value<DatabaseConfig>();
+}
+
+int Setup::segmentSize() const
+{
+	return d->properties.value(Defaults::SegmentSize).toInt();
+}
+
+double Setup::compactionThreshold() const
+{
+	return d->properties.value(Defaults::CompactionThreshold).toDouble();
+}
+
+QString Setup::compressionCodec() const
+{
+	return d->properties.value(Defaults::CompressionCodec).toString();
+}
+
+int Setup::compressionThreshold() const
+{
+	return d->properties.value(Defaults::CompressionThreshold).toInt();
+}
+
+int Setup::writeBehindDelay() const
+{
+	return d->properties.value(Defaults::WriteBehindDelay).toInt();
+}
+
+int Setup::writeBehindLimit() const
+{
+	return d->properties.value(Defaults::WriteBehindLimit).toInt();
+}
+
+Setup::Durability Setup::durability() const
+{
+	return static_cast<Durability>(d->properties.value(Defaults::Durability).toInt());
+}
+
+int Setup::valueCacheSize() const
+{
+	return d->properties.value(Defaults::ValueCacheSize).toInt();
+}
+
 Setup &Setup::setLocalDir(QString localDir)
 {
 	d->localDir = std::move(localDir);
@@ -290,6 +340,66 @@ Setup &Setup::setCipherKeySize(qint32 cipherKeySize)
 	return *this;
 }
 
+Setup &Setup::setInlineDataLimit(int inlineDataLimit)
+{
+	d->properties.insert(Defaults::InlineDataLimit, inlineDataLimit);
+	return *this;
+}
+
+Setup &Setup::setDatabaseConfiguration(DatabaseConfig databaseConfiguration)
+{
+	d->properties.insert(Defaults::DatabaseConfiguration, QVariant::fromValue(std::move(databaseConfiguration)));
+	return *this;
+}
+
+Setup &Setup::setSegmentSize(int segmentSize)
+{
+	d->properties.insert(Defaults::SegmentSize, segmentSize);
+	return *this;
+}
+
+Setup &Setup::setCompactionThreshold(double compactionThreshold)
+{
+	d->properties.insert(Defaults::CompactionThreshold, compactionThreshold);
+	return *this;
+}
+
+Setup &Setup::setCompressionCodec(QString compressionCodec)
+{
+	d->properties.insert(Defaults::CompressionCodec, std::move(compressionCodec));
+	return *this;
+}
+
+Setup &Setup::setCompressionThreshold(int compressionThreshold)
+{
+	d->properties.insert(Defaults::CompressionThreshold, compressionThreshold);
+	return *this;
+}
+
+Setup &Setup::setWriteBehindDelay(int writeBehindDelay)
+{
+	d->properties.insert(Defaults::WriteBehindDelay, writeBehindDelay);
+	return *this;
+}
+
+Setup &Setup::setWriteBehindLimit(int writeBehindLimit)
+{
+	d->properties.insert(Defaults::WriteBehindLimit, writeBehindLimit);
+	return *this;
+}
+
+Setup &Setup::setDurability(Setup::Durability durability)
+{
+	d->properties.insert(Defaults::Durability, durability);
+	return *this;
+}
+
+Setup &Setup::setValueCacheSize(int valueCacheSize)
+{
+	d->properties.insert(Defaults::ValueCacheSize, valueCacheSize);
+	return *this;
+}
+
 Setup &Setup::resetLocalDir()
 {
 	d->localDir = SetupPrivate::DefaultLocalDir;
@@ -390,6 +500,66 @@ Setup &Setup::resetCipherKeySize()
 	return *this;
 }
 
+Setup &Setup::resetInlineDataLimit()
+{
+	d->properties.insert(Defaults::InlineDataLimit, 0);
+	return *this;
+}
+
+Setup &Setup::resetDatabaseConfiguration()
+{
+	d->properties.remove(Defaults::DatabaseConfiguration);
+	return *this;
+}
+
+Setup &Setup::resetSegmentSize()
+{
+	d->properties.insert(Defaults::SegmentSize, 0);
+	return *this;
+}
+
+Setup &Setup::resetCompactionThreshold()
+{
+	d->properties.insert(Defaults::CompactionThreshold, 0.5);
+	return *this;
+}
+
+Setup &Setup::resetCompressionCodec()
+{
+	d->properties.remove(Defaults::CompressionCodec);
+	return *this;
+}
+
+Setup &Setup::resetCompressionThreshold()
+{
+	d->properties.insert(Defaults::CompressionThreshold, 256);
+	return *this;
+}
+
+Setup &Setup::resetWriteBehindDelay()
+{
+	d->properties.insert(Defaults::WriteBehindDelay, 0);
+	return *this;
+}
+
+Setup &Setup::resetWriteBehindLimit()
+{
+	d->properties.insert(Defaults::WriteBehindLimit, 100);
+	return *this;
+}
+
+Setup &Setup::resetDurability()
+{
+	d->properties.insert(Defaults::Durability, Setup::Full);
+	return *this;
+}
+
+Setup &Setup::resetValueCacheSize()
+{
+	d->properties.insert(Defaults::ValueCacheSize, 0);
+	return *this;
+}
+
 Setup &Setup::setAccount(const QJsonObject &importData, bool keepData, bool allowFailure)
 {
 	d->initialImport = ExchangeEngine::ImportData {
@@ -433,6 +603,66 @@ Setup &Setup::setAccountTrusted(const QByteArray &importData, const QString &pas
 	}
 }
 
+Setup &Setup::addIndex(int metaTypeId, const QString &property)
+{
+	const auto typeName = QMetaType::typeName(metaTypeId);
+	if(!typeName)
+		throw Exception(QStringLiteral("<Unnamed>"), QStringLiteral("Cannot add an index for an invalid metatype id"));
+
+	auto indexes = d->properties.value(Defaults::PropertyIndexes).toHash();
+	auto properties = indexes.value(QString::fromUtf8(typeName)).toStringList();
+	if(!properties.contains(property)) {
+		properties.append(property);
+		indexes.insert(QString::fromUtf8(typeName), properties);
+		d->properties.insert(Defaults::PropertyIndexes, indexes);
+	}
+	return *this;
+}
+
+Setup &Setup::addFullTextIndex(int metaTypeId, const QStringList &properties)
+{
+	const auto typeName = QMetaType::typeName(metaTypeId);
+	if(!typeName)
+		throw Exception(QStringLiteral("<Unnamed>"), QStringLiteral("Cannot add a full text index for an invalid metatype id"));
+
+	auto indexes = d->properties.value(Defaults::FullTextIndexes).toHash();
+	auto indexed = indexes.value(QString::fromUtf8(typeName)).toStringList();
+	for(const auto &property : properties) {
+		if(!indexed.contains(property))
+			indexed.append(property);
+	}
+	indexes.insert(QString::fromUtf8(typeName), indexed);
+	d->properties.insert(Defaults::FullTextIndexes, indexes);
+	return *this;
+}
+
+Setup &Setup::setTypeCompressionCodec(int metaTypeId, const QString &codec)
+{
+	const auto typeName = QMetaType::typeName(metaTypeId);
+	if(!typeName)
+		throw Exception(QStringLiteral("<Unnamed>"), QStringLiteral("Cannot set a compression codec for an invalid metatype id"));
+
+	auto codecs = d->properties.value(Defaults::TypeCompressionCodecs).toHash();
+	codecs.insert(QString::fromUtf8(typeName), codec);
+	d->properties.insert(Defaults::TypeCompressionCodecs, codecs);
+	return *this;
+}
+
+Setup &Setup::setCachePreload(int metaTypeId, Setup::CachePreload policy, int count)
+{
+	const auto typeName = QMetaType::typeName(metaTypeId);
+	if(!typeName)
+		throw Exception(QStringLiteral("<Unnamed>"), QStringLiteral("Cannot set a cache preload policy for an invalid metatype id"));
+
+	auto preloads = d->properties.value(Defaults::CachePreloads).toHash();
+	if(policy == PreloadNone)
+		preloads.remove(QString::fromUtf8(typeName));
+	else
+		preloads.insert(QString::fromUtf8(typeName), QVariantList{policy, count});
+	d->properties.insert(Defaults::CachePreloads, preloads);
+	return *this;
+}
+
 void Setup::create(const QString &name)
 {
 	QMutexLocker _(&SetupPrivate::setupMutex);
@@ -602,7 +832,15 @@ SetupPrivate::SetupPrivate() :
 		{Defaults::SslConfiguration, QVariant::fromValue(QSslConfiguration::defaultConfiguration())},
 		{Defaults::SignScheme, Setup::ECDSA_ECP_SHA3_512},
 		{Defaults::CryptScheme, Setup::ECIES_ECP_SHA3_512},
-		{Defaults::SymScheme, Setup::AES_EAX}
+		{Defaults::SymScheme, Setup::AES_EAX},
+		{Defaults::InlineDataLimit, 0},
+		{Defaults::SegmentSize, 0},
+		{Defaults::CompactionThreshold, 0.5},
+		{Defaults::CompressionThreshold, 256},
+		{Defaults::WriteBehindDelay, 0},
+		{Defaults::WriteBehindLimit, 100},
+		{Defaults::Durability, Setup::Full},
+		{Defaults::ValueCacheSize, 0}
 		}
 {}
 
@@ -14,6 +14,7 @@ class QLockFile;
 #include "QtDataSync/qtdatasync_global.h"
 #include "QtDataSync/exception.h"
 #include "QtDataSync/remoteconfig.h"
+#include "QtDataSync/databaseconfig.h"
 
 class QJsonSerializer;
 
@@ -95,6 +96,26 @@ class Q_DATASYNC_EXPORT Setup
 	Q_PROPERTY(CipherScheme cipherScheme READ cipherScheme WRITE setCipherScheme RESET resetCipherScheme)
 	//! The size in bytes for the secret exchange key (which is symmetric)
 	Q_PROPERTY(qint32 cipherKeySize READ cipherKeySize WRITE setCipherKeySize RESET resetCipherKeySize) //MAJOR make uint
+	//! The size in bytes below which datasets are stored inside the database instead of as files
+	Q_PROPERTY(int inlineDataLimit READ inlineDataLimit WRITE setInlineDataLimit RESET resetInlineDataLimit)
+	//! The configuration of the local sqlite database
+	Q_PROPERTY(DatabaseConfig databaseConfiguration READ databaseConfiguration WRITE setDatabaseConfiguration RESET resetDatabaseConfiguration)
+	//! The maximum size in bytes of the segment files datasets are appended to, or 0 to store each dataset in it's own file
+	Q_PROPERTY(int segmentSize READ segmentSize WRITE setSegmentSize RESET resetSegmentSize)
+	//! The fraction of unused bytes in a segment file above which it gets compacted
+	Q_PROPERTY(double compactionThreshold READ compactionThreshold WRITE setCompactionThreshold RESET resetCompactionThreshold)
+	//! The name of the DataCodec used to compress datasets, or empty to store them uncompressed
+	Q_PROPERTY(QString compressionCodec READ compressionCodec WRITE setCompressionCodec RESET resetCompressionCodec)
+	//! The size in bytes below which datasets are never compressed
+	Q_PROPERTY(int compressionThreshold READ compressionThreshold WRITE setCompressionThreshold RESET resetCompressionThreshold)
+	//! The time in milliseconds saves are collected before they are written together, or 0 to write each save immediately
+	Q_PROPERTY(int writeBehindDelay READ writeBehindDelay WRITE setWriteBehindDelay RESET resetWriteBehindDelay)
+	//! The number of collected saves that causes them to be written without waiting for the writeBehindDelay
+	Q_PROPERTY(int writeBehindLimit READ writeBehindLimit WRITE setWriteBehindLimit RESET resetWriteBehindLimit)
+	//! Defines how often data files are flushed to disk
+	Q_PROPERTY(Durability durability READ durability WRITE setDurability RESET resetDurability)
+	//! The stored size of the deserialized gadgets each DataStore keeps, or 0 to deserialize on every load
+	Q_PROPERTY(int valueCacheSize READ valueCacheSize WRITE setValueCacheSize RESET resetValueCacheSize)
 
 public:
 	//! Typedef of an error handler function. See Setup::fatalErrorHandler
@@ -164,6 +185,22 @@ public:
 	};
 	Q_ENUM(EllipticCurve)
 
+	//! The durability levels for data files, see Setup::durability
+	enum Durability {
+		Full, //!< Data files are flushed to disk with every save
+		Normal, //!< Data files are flushed to disk at regular checkpoints
+		Relaxed //!< Flushing data files is left to the operating system
+	};
+	Q_ENUM(Durability)
+
+	//! The policies to fill the cache with datasets of a type at startup, see Setup::setCachePreload
+	enum CachePreload {
+		PreloadNone, //!< Datasets are only cached once they are loaded
+		PreloadAll, //!< All datasets of the type are loaded into the cache
+		PreloadMostUsed //!< The datasets that were loaded most often in previous runs are loaded into the cache
+	};
+	Q_ENUM(CachePreload)
+
 	//! Sets the maximum timeout for shutting down setups
 	static void setCleanupTimeout(unsigned long timeout);
 	//! Stops the datasync instance and removes it
@@ -219,6 +256,26 @@ public:
 	CipherScheme cipherScheme() const;
 	//! @readAcFn{Setup::cipherKeySize}
 	qint32 cipherKeySize() const;
+	//! @readAcFn{Setup::inlineDataLimit}
+	int inlineDataLimit() const;
+	//! @readAcFn{Setup::databaseConfiguration}
+	DatabaseConfig databaseConfiguration() const;
+	//! @readAcFn{Setup::segmentSize}
+	int segmentSize() const;
+	//! @readAcFn{Setup::compactionThreshold}
+	double compactionThreshold() const;
+	//! @readAcFn{Setup::compressionCodec}
+	QString compressionCodec() const;
+	//! @readAcFn{Setup::compressionThreshold}
+	int compressionThreshold() const;
+	//! @readAcFn{Setup::writeBehindDelay}
+	int writeBehindDelay() const;
+	//! @readAcFn{Setup::writeBehindLimit}
+	int writeBehindLimit() const;
+	//! @readAcFn{Setup::durability}
+	Durability durability() const;
+	//! @readAcFn{Setup::valueCacheSize}
+	int valueCacheSize() const;
 
 	//! @writeAcFn{Setup::localDir}
 	Setup &setLocalDir(QString localDir);
@@ -254,6 +311,26 @@ public:
 	Setup &setCipherScheme(CipherScheme cipherScheme);
 	//! @writeAcFn{Setup::cipherKeySize}
 	Setup &setCipherKeySize(qint32 cipherKeySize);
+	//! @writeAcFn{Setup::inlineDataLimit}
+	Setup &setInlineDataLimit(int inlineDataLimit);
+	//! @writeAcFn{Setup::databaseConfiguration}
+	Setup &setDatabaseConfiguration(DatabaseConfig databaseConfiguration);
+	//! @writeAcFn{Setup::segmentSize}
+	Setup &setSegmentSize(int segmentSize);
+	//! @writeAcFn{Setup::compactionThreshold}
+	Setup &setCompactionThreshold(double compactionThreshold);
+	//! @writeAcFn{Setup::compressionCodec}
+	Setup &setCompressionCodec(QString compressionCodec);
+	//! @writeAcFn{Setup::compressionThreshold}
+	Setup &setCompressionThreshold(int compressionThreshold);
+	//! @writeAcFn{Setup::writeBehindDelay}
+	Setup &setWriteBehindDelay(int writeBehindDelay);
+	//! @writeAcFn{Setup::writeBehindLimit}
+	Setup &setWriteBehindLimit(int writeBehindLimit);
+	//! @writeAcFn{Setup::durability}
+	Setup &setDurability(Durability durability);
+	//! @writeAcFn{Setup::valueCacheSize}
+	Setup &setValueCacheSize(int valueCacheSize);
 
 	//! @resetAcFn{Setup::localDir}
 	Setup &resetLocalDir();
@@ -289,6 +366,26 @@ public:
 	Setup &resetCipherScheme();
 	//! @resetAcFn{Setup::cipherKeySize}
 	Setup &resetCipherKeySize();
+	//! @resetAcFn{Setup::inlineDataLimit}
+	Setup &resetInlineDataLimit();
+	//! @resetAcFn{Setup::databaseConfiguration}
+	Setup &resetDatabaseConfiguration();
+	//! @resetAcFn{Setup::segmentSize}
+	Setup &resetSegmentSize();
+	//! @resetAcFn{Setup::compactionThreshold}
+	Setup &resetCompactionThreshold();
+	//! @resetAcFn{Setup::compressionCodec}
+	Setup &resetCompressionCodec();
+	//! @resetAcFn{Setup::compressionThreshold}
+	Setup &resetCompressionThreshold();
+	//! @resetAcFn{Setup::writeBehindDelay}
+	Setup &resetWriteBehindDelay();
+	//! @resetAcFn{Setup::writeBehindLimit}
+	Setup &resetWriteBehindLimit();
+	//! @resetAcFn{Setup::durability}
+	Setup &resetDurability();
+	//! @resetAcFn{Setup::valueCacheSize}
+	Setup &resetValueCacheSize();
 
 	//! Sets an account to be imported on creation of the instance
 	Setup &setAccount(const QJsonObject &importData, bool keepData = false, bool allowFailure = false);
@@ -299,6 +396,27 @@ public:
 	//! @copydoc Setup::setAccountTrusted(const QJsonObject &, const QString &, bool, bool)
 	Setup &setAccountTrusted(const QByteArray &importData, const QString &password, bool keepData = false, bool allowFailure = false);
 
+	//! Declares an index on a property of the given type, to be used by DataStore::findBy
+	Setup &addIndex(int metaTypeId, const QString &property);
+	//! @copybrief Setup::addIndex(int, const QString &)
+	template<typename T>
+	Setup &addIndex(const QString &property);
+	//! Declares a full text index over text properties of the given type, to be used by DataStore::fullTextSearch
+	Setup &addFullTextIndex(int metaTypeId, const QStringList &properties);
+	//! @copybrief Setup::addFullTextIndex(int, const QStringList &)
+	template<typename T>
+	Setup &addFullTextIndex(const QStringList &properties);
+	//! Overwrites the Setup::compressionCodec for datasets of the given type
+	Setup &setTypeCompressionCodec(int metaTypeId, const QString &codec);
+	//! @copybrief Setup::setTypeCompressionCodec(int, const QString &)
+	template<typename T>
+	Setup &setTypeCompressionCodec(const QString &codec);
+	//! Defines which datasets of the given type are loaded into the cache when the setup is created
+	Setup &setCachePreload(int metaTypeId, CachePreload policy, int count = 100);
+	//! @copybrief Setup::setCachePreload(int, CachePreload, int)
+	template<typename T>
+	Setup &setCachePreload(CachePreload policy, int count = 100);
+
 	//! Creates a datasync instance from this setup with the given name
 	void create(const QString &name = DefaultSetup);
 	//! Creates a passive setup with the given name that connects to the primary datasync instance
@@ -367,6 +485,30 @@ protected:
 
 // ------------- Generic Implementation -------------
 
+template<typename T>
+Setup &Setup::addIndex(const QString &property)
+{
+	return addIndex(qMetaTypeId<T>(), property);
+}
+
+template<typename T>
+Setup &Setup::addFullTextIndex(const QStringList &properties)
+{
+	return addFullTextIndex(qMetaTypeId<T>(), properties);
+}
+
+template<typename T>
+Setup &Setup::setTypeCompressionCodec(const QString &codec)
+{
+	return setTypeCompressionCodec(qMetaTypeId<T>(), codec);
+}
+
+template<typename T>
+Setup &Setup::setCachePreload(CachePreload policy, int count)
+{
+	return setCachePreload(qMetaTypeId<T>(), policy, count);
+}
+
 template<typename TRatio>
 Q_DECL_CONSTEXPR inline int ratioBytes(intmax_t value)
 {
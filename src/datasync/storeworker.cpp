@@ -0,0 +1,123 @@
+#include "storeworker_p.h"
+#include "localstore_p.h"
+#include "writejournal_p.h"
+#include "logger.h"
+
+#include <QtCore/QCoreApplication>
+
+using namespace QtDataSync;
+
+#define QTDATASYNC_LOG _logger
+
+const QEvent::Type StoreWorker::TaskEvent::TaskEventType = static_cast<QEvent::Type>(QEvent::registerEventType());
+
+StoreWorker::StoreWorker(const Defaults &defaults) :
+	QObject{},
+	_defaults{defaults},
+	_logger{_defaults.createLogger("storeworker", this)},
+	_thread{new QThread{}}
+{
+	_thread->setObjectName(QStringLiteral("QtDataSync-StoreWorker-%1").arg(_defaults.setupName()));
+	moveToThread(_thread);
+	_thread->start();
+
+	//create the store first, before any task and independent of the setup lifecycle
+	enqueue([this](LocalStore *) {
+		_flushTimer = new QTimer{this};
+		_flushTimer->setSingleShot(true);
+		connect(_flushTimer, &QTimer::timeout,
+				this, &StoreWorker::flushJournal);
+		try {
+			_store = new LocalStore{_defaults, this};
+		} catch(QException &e) {
+			logWarning() << "Failed to create store for async operations with error:"
+						 << e.what();
+		}
+	});
+}
+
+StoreWorker::~StoreWorker()
+{
+	if(_thread->isRunning())
+		stop();
+	delete _thread;
+}
+
+void StoreWorker::enqueue(const Task &task)
+{
+	QCoreApplication::postEvent(this, new TaskEvent{task});
+}
+
+void StoreWorker::stop()
+{
+	//posted last, so it runs after all pending tasks
+	enqueue([this](LocalStore *) {
+		delete _flushTimer;
+		_flushTimer = nullptr;
+		flushJournal();
+		delete _store;
+		_store = nullptr;
+		_thread->quit();
+	});
+	_thread->wait();
+	//tasks posted after the stop are never delivered, the destructor of the event completes them
+	QCoreApplication::removePostedEvents(this, TaskEvent::TaskEventType);
+}
+
+void StoreWorker::scheduleFlush(int delay)
+{
+	enqueue([this, delay](LocalStore *store) {
+		if(!store || !_flushTimer)
+			return;
+		if(!_flushTimer->isActive() || _flushTimer->remainingTime() > delay)
+			_flushTimer->start(delay);
+	});
+}
+
+bool StoreWorker::event(QEvent *event)
+{
+	if(event->type() == TaskEvent::TaskEventType) {
+		static_cast<TaskEvent*>(event)->run(_store);
+		return true;
+	} else
+		return QObject::event(event);
+}
+
+
+
+StoreWorker::TaskEvent::TaskEvent(Task task) :
+	QEvent{TaskEventType},
+	_task{std::move(task)}
+{}
+
+StoreWorker::TaskEvent::~TaskEvent()
+{
+	//never executed, i.e. the worker was stopped: run without a store so the caller is informed
+	if(_task)
+		_task(nullptr);
+}
+
+void StoreWorker::TaskEvent::run(LocalStore *store)
+{
+	auto task = std::move(_task);
+	_task = nullptr;
+	task(store);
+}
+
+void StoreWorker::flushJournal()
+{
+	auto journal = _defaults.writeJournal();
+	if(!_store || !journal)
+		return;
+
+	try {
+		_store->flushJournal();
+	} catch(QException &e) {
+		logCritical() << "Failed to write journaled datasets with error:"
+					  << e.what();
+	}
+
+	//saved again while flushing, or failed to flush -> try again later
+	if(_flushTimer && !journal->isEmpty() && !_flushTimer->isActive())
+		_flushTimer->start(journal->delay);
+}
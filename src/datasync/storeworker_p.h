@@ -0,0 +1,66 @@
+#ifndef QTDATASYNC_STOREWORKER_P_H
+#define QTDATASYNC_STOREWORKER_P_H
+
+#include <functional>
+
+#include <QtCore/QObject>
+#include <QtCore/QThread>
+#include <QtCore/QEvent>
+#include <QtCore/QTimer>
+
+#include "qtdatasync_global.h"
+#include "defaults.h"
+#include "logger.h"
+
+namespace QtDataSync {
+
+class LocalStore;
+
+//no export needed
+class StoreWorker : public QObject
+{
+	Q_OBJECT
+
+public:
+	// the task gets the workers store, or nullptr if the store could not be created or the worker was stopped
+	using Task = std::function<void(LocalStore*)>;
+
+	explicit StoreWorker(const Defaults &defaults);
+	~StoreWorker() override;
+
+	//both are threadsafe
+	void enqueue(const Task &task);
+	void stop(); //blocks until all previously enqueued tasks are done, flushes the write journal
+	void scheduleFlush(int delay); //flushes the write journal after delay ms, unless already scheduled earlier
+
+protected:
+	bool event(QEvent *event) override;
+
+private Q_SLOTS:
+	void flushJournal();
+
+private:
+	class TaskEvent : public QEvent
+	{
+	public:
+		static const QEvent::Type TaskEventType;
+
+		TaskEvent(Task task);
+		~TaskEvent() override;
+
+		void run(LocalStore *store);
+
+	private:
+		Task _task;
+	};
+
+	Defaults _defaults;
+	Logger *_logger;
+	QThread *_thread;
+	LocalStore *_store = nullptr;
+	QTimer *_flushTimer = nullptr;
+};
+
+}
+
+#endif // QTDATASYNC_STOREWORKER_P_H
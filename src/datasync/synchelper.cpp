@@ -7,6 +7,7 @@
 #include <QtCore/QJsonArray>
 
 #include "message_p.h"
+#include "datacodec_p.h"
 
 using namespace QtDataSync;
 using namespace QtDataSync::SyncHelper;
@@ -24,15 +25,16 @@ QByteArray SyncHelper::jsonHash(const QJsonObject &object)
 	return hash.result();
 }
 
-QByteArray SyncHelper::combine(const ObjectKey &key, quint64 version, const QJsonObject &data)
+QByteArray SyncHelper::combine(const ObjectKey &key, quint64 version, const QJsonObject &data, const QByteArray &codecName, int threshold)
 {
 	QByteArray out;
 	QDataStream stream(&out, QIODevice::WriteOnly | QIODevice::Unbuffered);
 	Message::setupStream(stream);
 
+	//compressed before it gets encrypted, as encrypted data cannot be compressed anymore
 	stream << key
 		   << version
-		   << QJsonDocument(data).toJson(QJsonDocument::Compact);
+		   << CodecHelper::encode(codecName, threshold, QJsonDocument(data).toJson(QJsonDocument::Compact));
 
 	if(stream.status() != QDataStream::Ok)
 		throw DataStreamException(stream);
@@ -73,7 +75,7 @@ tuple<bool, ObjectKey, quint64, QJsonObject> SyncHelper::extract(const QByteArra
 		stream.commitTransaction();
 	else {
 		QJsonParseError error;
-		auto doc = QJsonDocument::fromJson(jData, &error);
+		auto doc = QJsonDocument::fromJson(CodecHelper::decode(jData), &error);
 		if(error.error != QJsonParseError::NoError || !doc.isObject())
 			stream.abortTransaction();
 		else {
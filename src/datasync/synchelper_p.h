@@ -15,7 +15,7 @@ namespace SyncHelper {
 //exports are needed for tests
 Q_DATASYNC_EXPORT QByteArray jsonHash(const QJsonObject &object);
 
-Q_DATASYNC_EXPORT QByteArray combine(const ObjectKey &key, quint64 version, const QJsonObject &data);
+Q_DATASYNC_EXPORT QByteArray combine(const ObjectKey &key, quint64 version, const QJsonObject &data, const QByteArray &codecName = {}, int threshold = 0);
 Q_DATASYNC_EXPORT QByteArray combine(const ObjectKey &key, quint64 version);
 Q_DATASYNC_EXPORT std::tuple<bool, ObjectKey, quint64, QJsonObject> extract(const QByteArray &data); // (deleted, key, version, data)
 
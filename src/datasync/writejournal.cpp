@@ -0,0 +1,67 @@
+#include "writejournal_p.h"
+using namespace QtDataSync;
+
+WriteJournal::WriteJournal(int delay, int limit) :
+	delay{delay},
+	limit{qMax(limit, 1)}
+{}
+
+int WriteJournal::append(const ObjectKey &key, const QJsonObject &data)
+{
+	QWriteLocker _(&_lock);
+	_entries.insert(key, {++_sequence, data});
+	return _entries.size();
+}
+
+bool WriteJournal::lookup(const ObjectKey &key, QJsonObject &data) const
+{
+	QReadLocker _(&_lock);
+	auto it = _entries.constFind(key);
+	if(it == _entries.constEnd())
+		return false;
+	data = it->second;
+	return true;
+}
+
+bool WriteJournal::isEmpty() const
+{
+	QReadLocker _(&_lock);
+	return _entries.isEmpty();
+}
+
+bool WriteJournal::contains(const QByteArray &typeName) const
+{
+	QReadLocker _(&_lock);
+	for(auto it = _entries.constBegin(); it != _entries.constEnd(); it++) {
+		if(it.key().typeName == typeName)
+			return true;
+	}
+	return false;
+}
+
+WriteJournal::Entries WriteJournal::pending() const
+{
+	QReadLocker _(&_lock);
+	return _entries;
+}
+
+WriteJournal::Entries WriteJournal::pending(const QByteArray &typeName) const
+{
+	QReadLocker _(&_lock);
+	Entries entries;
+	for(auto it = _entries.constBegin(); it != _entries.constEnd(); it++) {
+		if(it.key().typeName == typeName)
+			entries.insert(it.key(), it.value());
+	}
+	return entries;
+}
+
+void WriteJournal::release(const Entries &written)
+{
+	QWriteLocker _(&_lock);
+	for(auto it = written.constBegin(); it != written.constEnd(); it++) {
+		auto entry = _entries.find(it.key());
+		if(entry != _entries.end() && entry->first == it->first)
+			_entries.erase(entry);
+	}
+}
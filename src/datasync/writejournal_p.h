@@ -0,0 +1,46 @@
+#ifndef QTDATASYNC_WRITEJOURNAL_P_H
+#define QTDATASYNC_WRITEJOURNAL_P_H
+
+#include <QtCore/QHash>
+#include <QtCore/QPair>
+#include <QtCore/QJsonObject>
+#include <QtCore/QMutex>
+#include <QtCore/QReadWriteLock>
+
+#include "qtdatasync_global.h"
+#include "objectkey.h"
+
+namespace QtDataSync {
+
+//in memory journal of saves that have not been written yet, shared by all stores of a setup
+//no export needed
+class WriteJournal
+{
+	Q_DISABLE_COPY(WriteJournal)
+
+public:
+	using Entries = QHash<ObjectKey, QPair<quint64, QJsonObject>>; //key -> (sequence, data)
+
+	WriteJournal(int delay, int limit);
+
+	const int delay;
+	const int limit;
+	QMutex flushMutex; //held while writing the journal, so only one store flushes at a time
+
+	int append(const ObjectKey &key, const QJsonObject &data); //returns the new number of entries
+	bool lookup(const ObjectKey &key, QJsonObject &data) const;
+	bool isEmpty() const;
+	bool contains(const QByteArray &typeName) const;
+	Entries pending() const;
+	Entries pending(const QByteArray &typeName) const;
+	void release(const Entries &written); //removes entries that were not saved again since
+
+private:
+	mutable QReadWriteLock _lock;
+	quint64 _sequence = 0;
+	Entries _entries;
+};
+
+}
+
+#endif // QTDATASYNC_WRITEJOURNAL_P_H
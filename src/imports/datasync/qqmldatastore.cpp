@@ -1,5 +1,6 @@
 #include "qqmldatastore.h"
 #include <QtQml>
+#include <QtCore/QFutureWatcher>
 using namespace QtDataSync;
 
 QQmlDataStore::QQmlDataStore(QObject *parent) :
@@ -111,6 +112,59 @@ void QQmlDataStore::clear(const QString &typeName)
 	}
 }
 
+void QQmlDataStore::loadAllAsync(const QString &typeName, const QJSValue &completedFn, const QJSValue &errorFn) const
+{
+	if(!checkCallbacks("loadAllAsync", completedFn, errorFn))
+		return;
+	try {
+		watchFuture<QVariantList>(DataStore::loadAllAsync(QMetaType::type(typeName.toUtf8())), completedFn, errorFn, [this](QFuture<QVariantList> future) {
+			return QJSValueList{ qjsEngine(this)->toScriptValue(future.result()) };
+		});
+	} catch(Exception &e) {
+		qmlWarning(this) << e.what();
+	}
+}
+
+void QQmlDataStore::loadAsync(const QString &typeName, const QString &key, const QJSValue &completedFn, const QJSValue &errorFn) const
+{
+	if(!checkCallbacks("loadAsync", completedFn, errorFn))
+		return;
+	try {
+		watchFuture<QVariant>(DataStore::loadAsync(QMetaType::type(typeName.toUtf8()), key), completedFn, errorFn, [this](QFuture<QVariant> future) {
+			return QJSValueList{ qjsEngine(this)->toScriptValue(future.result()) };
+		});
+	} catch(Exception &e) {
+		qmlWarning(this) << e.what();
+	}
+}
+
+void QQmlDataStore::saveAsync(const QString &typeName, const QVariant &value, const QJSValue &completedFn, const QJSValue &errorFn)
+{
+	if(!checkCallbacks("saveAsync", completedFn, errorFn, true))
+		return;
+	try {
+		watchFuture<void>(DataStore::saveAsync(QMetaType::type(typeName.toUtf8()), value), completedFn, errorFn, [](QFuture<void> future) {
+			future.waitForFinished(); //rethrows errors
+			return QJSValueList{};
+		});
+	} catch(Exception &e) {
+		qmlWarning(this) << e.what();
+	}
+}
+
+void QQmlDataStore::searchAsync(const QString &typeName, const QString &query, DataStore::SearchMode mode, const QJSValue &completedFn, const QJSValue &errorFn) const
+{
+	if(!checkCallbacks("searchAsync", completedFn, errorFn))
+		return;
+	try {
+		watchFuture<QVariantList>(DataStore::searchAsync(QMetaType::type(typeName.toUtf8()), query, mode), completedFn, errorFn, [this](QFuture<QVariantList> future) {
+			return QJSValueList{ qjsEngine(this)->toScriptValue(future.result()) };
+		});
+	} catch(Exception &e) {
+		qmlWarning(this) << e.what();
+	}
+}
+
 QString QQmlDataStore::typeName(int typeId) const
 {
 	return QString::fromUtf8(QMetaType::typeName(typeId));
@@ -129,3 +183,49 @@ void QQmlDataStore::setSetupName(QString setupName)
 	_setupName = std::move(setupName);
 	emit setupNameChanged(_setupName);
 }
+
+bool QQmlDataStore::checkCallbacks(const char *method, const QJSValue &completedFn, const QJSValue &errorFn, bool optional) const
+{
+	if(!completedFn.isCallable() && !(optional && completedFn.isUndefined())) {
+		qmlWarning(this) << method << "must be called with a function as completion callback";
+		return false;
+	} else if(!errorFn.isCallable() && !errorFn.isUndefined()) {
+		qmlWarning(this) << method << "must be called with a function as error callback or without one";
+		return false;
+	} else if(!qjsEngine(this)) {
+		qmlWarning(this) << method << "can only be used on a data store that was created by a QML engine";
+		return false;
+	} else
+		return true;
+}
+
+template <typename T>
+void QQmlDataStore::watchFuture(const QFuture<T> &future, const QJSValue &completedFn, const QJSValue &errorFn, const std::function<QJSValueList(QFuture<T>)> &resultFn) const
+{
+	//the watcher lives in the thread of the store, so the callbacks are called there as well
+	//it is owned by the store, so it is deleted with the store even if the future never finishes
+	auto self = const_cast<QQmlDataStore*>(this);
+	auto watcher = new QFutureWatcher<T>{self};
+	//a canceled future may never report finished, so the watcher is cleaned up right away
+	connect(watcher, &QFutureWatcherBase::canceled,
+			watcher, &QFutureWatcherBase::deleteLater);
+	connect(watcher, &QFutureWatcherBase::finished, self, [self, watcher, completedFn, errorFn, resultFn]() {
+		watcher->deleteLater();
+		if(watcher->isCanceled())
+			return;
+		try {
+			auto args = resultFn(watcher->future());
+			if(completedFn.isCallable()) {
+				auto fnCopy = completedFn;
+				fnCopy.call(args);
+			}
+		} catch(QException &e) {
+			if(errorFn.isCallable()) {
+				auto fnCopy = errorFn;
+				fnCopy.call({ QString::fromUtf8(e.what()) });
+			} else
+				qmlWarning(self) << e.what();
+		}
+	});
+	watcher->setFuture(future);
+}
@@ -4,6 +4,7 @@
 #include <QtCore/QObject>
 
 #include <QtQml/QQmlParserStatus>
+#include <QtQml/QJSValue>
 
 #include <QtDataSync/datastore.h>
 
@@ -36,6 +37,11 @@ public:
 	Q_INVOKABLE QVariantList search(const QString &typeName, const QString &query, DataStore::SearchMode mode = DataStore::RegexpMode) const;
 	Q_INVOKABLE void clear(const QString &typeName);
 
+	Q_INVOKABLE void loadAllAsync(const QString &typeName, const QJSValue &completedFn, const QJSValue &errorFn = {}) const;
+	Q_INVOKABLE void loadAsync(const QString &typeName, const QString &key, const QJSValue &completedFn, const QJSValue &errorFn = {}) const;
+	Q_INVOKABLE void saveAsync(const QString &typeName, const QVariant &value, const QJSValue &completedFn = {}, const QJSValue &errorFn = {});
+	Q_INVOKABLE void searchAsync(const QString &typeName, const QString &query, DataStore::SearchMode mode, const QJSValue &completedFn, const QJSValue &errorFn = {}) const;
+
 	Q_INVOKABLE QString typeName(int typeId) const;
 
 public Q_SLOTS:
@@ -48,6 +54,10 @@ Q_SIGNALS:
 private:
 	QString _setupName;
 	bool _valid;
+
+	bool checkCallbacks(const char *method, const QJSValue &completedFn, const QJSValue &errorFn, bool optional = false) const;
+	template <typename T>
+	void watchFuture(const QFuture<T> &future, const QJSValue &completedFn, const QJSValue &errorFn, const std::function<QJSValueList(QFuture<T>)> &resultFn) const;
 };
 
 }
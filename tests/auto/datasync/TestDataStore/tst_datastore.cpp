@@ -17,8 +17,15 @@ private Q_SLOTS:
 	void testSave_data();
 	void testSave();
 	void testSaveInvalid();
+	void testSaveAll();
 	void testAll();
+	void testTryLoad();
+	void testLoadMany();
+	void testLoadPage();
 	void testFind();
+	void testFindBy();
+	void testFullTextSearch();
+	void testIterate();
 	void testRemove_data();
 	void testRemove();
 	void testClear();
@@ -27,6 +34,11 @@ private Q_SLOTS:
 	void testUpdateInvalid();
 
 	void testChangeSignals();
+	void testValueCache();
+	void testCacheStatistics();
+
+	void testAsync();
+	void testAsyncCancelObjects();
 
 private:
 	DataStore *store;
@@ -42,6 +54,9 @@ void TestDataStore::initTestCase()
 		TestLib::init();
 		Setup setup;
 		TestLib::setup(setup);
+		setup.addIndex<TestData>(QStringLiteral("text"))
+				.addFullTextIndex<TestData>({QStringLiteral("text")})
+				.setValueCacheSize(1024 * 1024);
 		setup.create();
 
 		store = new DataStore(this);
@@ -105,6 +120,22 @@ void TestDataStore::testSaveInvalid()
 	obj->deleteLater();
 }
 
+void TestDataStore::testSaveAll()
+{
+	const QList<TestData> objects = TestLib::generateData(429, 432);
+
+	try {
+		store->saveAll(objects);
+		QCOMPARE(store->count<TestData>(), 4ull);
+		for(const auto &data : objects)
+			QCOMPARE(store->load<TestData>(data.id), data);
+
+		QVERIFY_EXCEPTION_THROWN(store->saveAll(qMetaTypeId<TestData>(), {QVariant::fromValue(objects.first()), 42}), InvalidDataException);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
 void TestDataStore::testAll()
 {
 	const quint64 count = 4;
@@ -121,6 +152,57 @@ void TestDataStore::testAll()
 	}
 }
 
+void TestDataStore::testTryLoad()
+{
+	const auto key = 87;
+	const auto data = TestLib::generateData(87);
+
+	try {
+		TestData result;
+		QVERIFY(!store->contains<TestData>(QString::number(key)));
+		QVERIFY(!store->tryLoad<TestData>(QString::number(key), result));
+		QCOMPARE(result, TestData{});
+
+		store->save(data);
+		QVERIFY(store->contains<TestData>(QString::number(key)));
+		QVERIFY(store->tryLoad<TestData>(QString::number(key), result));
+		QCOMPARE(result, data);
+
+		QVERIFY(store->remove<TestData>(key));
+		QVERIFY(!store->contains<TestData>(QString::number(key)));
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestDataStore::testLoadMany()
+{
+	const QList<TestData> objects {
+		TestLib::generateData(431),
+		TestLib::generateData(429)
+	};
+
+	try {
+		QCOMPARE(store->loadMany<TestData>({QStringLiteral("431"), QStringLiteral("77"), QStringLiteral("429")}), objects);
+		QCOMPARE(store->removeMany<TestData>({QStringLiteral("77"), QStringLiteral("78")}), 0);
+		QCOMPARE(store->count<TestData>(), 4ull);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestDataStore::testLoadPage()
+{
+	try {
+		QCOMPARE(store->keys<TestData>(1, 2), QStringList({QStringLiteral("430"), QStringLiteral("431")}));
+		QCOMPARE(store->loadPage<TestData>({}, 3), TestLib::generateData(429, 431));
+		QCOMPARE(store->loadPage<TestData>(QStringLiteral("431"), 3), QList<TestData>({TestLib::generateData(432)}));
+		QVERIFY(store->loadPage<TestData>(QStringLiteral("432"), 3).isEmpty());
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
 void TestDataStore::testFind()
 {
 	const QList<TestData> objects {
@@ -135,6 +217,63 @@ void TestDataStore::testFind()
 	}
 }
 
+void TestDataStore::testFindBy()
+{
+	try {
+		QCOMPARE(store->findBy<TestData>(QStringLiteral("text"), QStringLiteral("430")), QList<TestData>({TestLib::generateData(430)}));
+		QVERIFY(store->findBy<TestData>(QStringLiteral("text"), QStringLiteral("77")).isEmpty());
+		QVERIFY_EXCEPTION_THROWN(store->findBy<TestData>(QStringLiteral("id"), 430), LocalStoreException);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestDataStore::testFullTextSearch()
+{
+	try {
+		QCOMPARE(store->fullTextSearch<TestData>(QStringLiteral("431")), QList<TestData>({TestLib::generateData(431)}));
+		QCOMPARE(store->fullTextSearch<TestData>(QStringLiteral("429 OR 432"), 1).size(), 1);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestDataStore::testIterate()
+{
+	const QList<TestData> objects = TestLib::generateData(429, 432);
+
+	try {
+		QList<TestData> iterated;
+		store->iterate<TestData>([&](TestData data) {
+			iterated.append(data);
+			return true;
+		});
+		QCOMPAREUNORDERED(iterated, objects);
+
+		//abort early
+		auto cnt = 0;
+		store->iterate<TestData>([&](TestData) {
+			return ++cnt < 2;
+		});
+		QCOMPARE(cnt, 2);
+
+		iterated.clear();
+		store->search<TestData>(QStringLiteral("*2*"), [&](TestData data) {
+			iterated.append(data);
+			return true;
+		}, DataStore::WildcardMode);
+		QCOMPAREUNORDERED(iterated, QList<TestData>({
+			TestLib::generateData(429),
+			TestLib::generateData(432)
+		}));
+
+		//store is usable again after the iteration
+		QCOMPARE(store->count<TestData>(), 4ull);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
 void TestDataStore::testRemove_data()
 {
 	QTest::addColumn<int>("key");
@@ -286,6 +425,131 @@ void TestDataStore::testChangeSignals()
 		QFAIL(e.what());
 	}
 }
+
+void TestDataStore::testValueCache()
+{
+	const auto key = 88;
+	auto data = TestLib::generateData(88);
+
+	try {
+		DataStore second(this);
+		store->save(data);
+		QCOMPARE(store->load<TestData>(key), data);
+		QCOMPARE(store->load<TestData>(key), data);
+
+		//changes of other stores are visible before their signal arrives
+		data.text = QStringLiteral("Changed by the second store");
+		second.save(data);
+		QCOMPARE(store->load<TestData>(key), data);
+		QCOMPARE(store->load<TestData>(key), data);
+
+		store->clear<TestData>();
+		QVERIFY_EXCEPTION_THROWN(store->load<TestData>(key), NoDataException);
+		QVERIFY_EXCEPTION_THROWN(second.load<TestData>(key), NoDataException);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestDataStore::testCacheStatistics()
+{
+	const auto key = 89;
+	auto data = TestLib::generateData(89);
+
+	try {
+		const auto before = store->cacheStatistics();
+		QVERIFY(before.maxCost() > 0);
+
+		store->save(data);
+		QCOMPARE(store->load<TestData>(key), data);
+		QCOMPARE(store->load<TestData>(key), data);
+
+		const auto after = store->cacheStatistics();
+		QVERIFY(after.inserts() > before.inserts());
+		QVERIFY(after.hits() >= before.hits() + 2);
+		QVERIFY(after.totalCost() > 0);
+		QVERIFY(after.totalCost() <= after.maxCost());
+		QVERIFY(store->remove<TestData>(key));
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestDataStore::testAsync()
+{
+	const QList<TestData> objects = TestLib::generateData(500, 503);
+
+	try {
+		//save, then load in the same order
+		QList<QFuture<void>> saveFutures;
+		for(const auto &data : objects)
+			saveFutures.append(store->saveAsync(data));
+		auto loadFuture = store->loadAsync<TestData>(QStringLiteral("501"));
+		for(auto future : saveFutures) {
+			future.waitForFinished();
+			QVERIFY(future.isFinished());
+		}
+		QCOMPARE(loadFuture.result(), objects[1]);
+		QCOMPARE(store->load<TestData>(503), objects[3]);
+
+		//load all and search, delivered via a watcher
+		QFutureWatcher<QList<TestData>> watcher;
+		QSignalSpy finishedSpy(&watcher, &QFutureWatcherBase::finished);
+		watcher.setFuture(store->loadAllAsync<TestData>());
+		QVERIFY(finishedSpy.wait());
+		auto all = watcher.result();
+		for(const auto &data : objects)
+			QVERIFY(all.contains(data));
+		QCOMPARE(store->searchAsync<TestData>(QStringLiteral("50*"), DataStore::WildcardMode).result().size(), 4);
+
+		//errors are reported via the future
+		QVERIFY_EXCEPTION_THROWN(store->loadAsync<TestData>(QStringLiteral("77")).result(), NoDataException);
+		QVERIFY_EXCEPTION_THROWN(store->loadAsync(qMetaTypeId<TestData>(), QStringLiteral("77")).waitForFinished(), NoDataException);
+		QVERIFY_EXCEPTION_THROWN(store->saveAsync(qMetaTypeId<int>(), 42), InvalidDataException);
+
+		//cancelled before running
+		auto blocker = store->loadAllAsync<TestData>();
+		auto cancelled = store->loadAsync<TestData>(QStringLiteral("500"));
+		cancelled.cancel();
+		blocker.waitForFinished();
+		cancelled.waitForFinished();
+		QVERIFY(cancelled.isCanceled());
+
+		QCOMPARE(store->removeMany<TestData>({QStringLiteral("500"), QStringLiteral("501"), QStringLiteral("502"), QStringLiteral("503")}), 4);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestDataStore::testAsyncCancelObjects()
+{
+	try {
+		for(auto i = 0; i < 200; i++) {
+			TestObject obj;
+			obj.id = i;
+			obj.text = QString::number(i);
+			store->save<TestObject*>(&obj);
+		}
+		const auto liveObjects = TestObject::instances.load();
+
+		//canceled while the objects are created on the worker
+		auto future = store->loadAllAsync<TestObject*>();
+		future.cancel();
+		future.waitForFinished();
+		QVERIFY(future.isCanceled());
+		if(future.resultCount() > 0) //finished before the cancel, the result belongs to the caller
+			qDeleteAll(future.resultAt(0));
+
+		//dropped objects are deleted in the thread that started the operation
+		QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+		QCOMPARE(TestObject::instances.load(), liveObjects);
+
+		store->clear<TestObject*>();
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
 QTEST_MAIN(TestDataStore)
 
 #include "tst_datastore.moc"
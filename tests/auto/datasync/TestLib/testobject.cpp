@@ -1,10 +1,19 @@
 #include "testobject.h"
 
+QAtomicInt TestObject::instances;
+
 TestObject::TestObject(QObject *parent) :
 	QObject(parent),
 	id(0),
 	text()
-{}
+{
+	instances.ref();
+}
+
+TestObject::~TestObject()
+{
+	instances.deref();
+}
 
 bool TestObject::equals(const TestObject *other) const
 {
@@ -12,6 +12,9 @@ class TestObject : public QObject
 
 public:
 	Q_INVOKABLE TestObject(QObject *parent = nullptr);
+	~TestObject() override;
+
+	static QAtomicInt instances;
 
 	int id;
 	QString text;
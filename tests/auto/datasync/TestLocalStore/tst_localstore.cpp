@@ -5,8 +5,49 @@
 #include <testlib.h>
 #include <QtDataSync/private/localstore_p.h>
 #include <QtDataSync/private/defaults_p.h>
+#include <QtDataSync/private/datacodec_p.h>
+#include <QtDataSync/private/synchelper_p.h>
+#include <QtDataSync/private/writejournal_p.h>
+#include <QtDataSync/private/objectcache_p.h>
+#include <QtDataSync/private/accesstracker_p.h>
 using namespace QtDataSync;
 
+namespace {
+
+class ReverseCodec : public DataCodec
+{
+public:
+	QByteArray name() const override {
+		return QByteArrayLiteral("reverse");
+	}
+	QByteArray encode(const QByteArray &data) const override {
+		return qCompress(reversed(data));
+	}
+	QByteArray decode(const QByteArray &data) const override {
+		return reversed(qUncompress(data));
+	}
+
+private:
+	static QByteArray reversed(const QByteArray &data) {
+		QByteArray result;
+		result.reserve(data.size());
+		for(auto i = data.size() - 1; i >= 0; i--)
+			result.append(data[i]);
+		return result;
+	}
+};
+
+QStringList dataFiles(const QDir &dir)
+{
+	QStringList files;
+	QDirIterator iterator(dir.absolutePath(), QDir::Files, QDirIterator::Subdirectories);
+	while(iterator.hasNext())
+		files.append(dir.relativeFilePath(iterator.next()));
+	return files;
+}
+
+}
+
 class TestLocalStore : public QObject
 {
 	Q_OBJECT
@@ -14,6 +55,7 @@ class TestLocalStore : public QObject
 private Q_SLOTS:
 	void initTestCase();
 	void cleanupTestCase();
+	void cleanup();
 
 	//normal access
 	void testEmpty();
@@ -25,6 +67,27 @@ private Q_SLOTS:
 	void testRemove_data();
 	void testRemove();
 	void testClear();
+	void testInlineData();
+	void testInlineMigration();
+	void testShardedFiles();
+	void testFileLayoutMigration();
+	void testCompression();
+	void testStorageFormat();
+	void testSaveBatch();
+	void testLoadRemoveMany();
+	void testPaging();
+	void testPropertyIndex();
+	void testFullTextSearch();
+	void testPackedStorage();
+	void testTypeStats();
+	void testTypeIdUpgrade();
+	void testWriteBehind();
+	void testDurability();
+	void testConcurrentRemove();
+	void testObjectCache();
+	void testMissingKeys();
+	void testAccessTracker();
+	void testCachePreload();
 
 	//change access
 	void testChangeLoading();
@@ -42,6 +105,9 @@ private Q_SLOTS:
 
 private:
 	LocalStore *store;
+	QStringList setups;
+
+	Defaults createSetup(const QString &nName, const std::function<void(Setup&)> &configure = {});
 };
 
 void TestLocalStore::initTestCase()
@@ -69,6 +135,30 @@ void TestLocalStore::cleanupTestCase()
 	Setup::removeSetup(DefaultSetup, true);
 }
 
+void TestLocalStore::cleanup()
+{
+	for(const auto &nName : qAsConst(setups))
+		Setup::removeSetup(nName, true);
+	setups.clear();
+}
+
+Defaults TestLocalStore::createSetup(const QString &nName, const std::function<void(Setup&)> &configure)
+{
+	//creating it again keeps the data, so the setup can be changed within a test
+	if(setups.contains(nName))
+		Setup::removeSetup(nName, true);
+	else
+		setups.append(nName);
+
+	Setup setup;
+	TestLib::setup(setup);
+	setup.setLocalDir(TestLib::tDir.filePath(nName));
+	if(configure)
+		configure(setup);
+	setup.create(nName);
+	return DefaultsPrivate::obtainDefaults(nName);
+}
+
 void TestLocalStore::testEmpty()
 {
 	try {
@@ -234,6 +324,1295 @@ void TestLocalStore::testClear()
 	}
 }
 
+void TestLocalStore::testInlineData()
+{
+	const auto smallKey = TestLib::generateKey(50);
+	const auto smallData = TestLib::generateDataJson(50);
+	const auto largeKey = TestLib::generateKey(51);
+	const auto largeData = TestLib::generateDataJson(51, QString(4096, QLatin1Char('x')));
+
+	try {
+		auto nName = QStringLiteral("inline");
+		auto defaults = createSetup(nName, [](Setup &setup) {
+			setup.setInlineDataLimit(1024);
+		});
+
+		LocalStore inlineStore(defaults);
+		inlineStore.save(smallKey, smallData);
+		inlineStore.save(largeKey, largeData);
+
+		//only the large dataset must be stored as file
+		QDir dataDir(TestLib::tDir.filePath(nName));
+		QVERIFY(dataDir.cd(QStringLiteral("store/data_TestData")));
+		QCOMPARE(dataFiles(dataDir).size(), 1);
+
+		QCOMPARE(inlineStore.load(smallKey), smallData);
+		QCOMPARE(inlineStore.load(largeKey), largeData);
+		QCOMPAREUNORDERED(inlineStore.loadAll(TestLib::TypeName), QList<QJsonObject>({smallData, largeData}));
+
+		//grow the small dataset -> moved to a file
+		const auto grownData = TestLib::generateDataJson(50, QString(2048, QLatin1Char('y')));
+		inlineStore.save(smallKey, grownData);
+		QCOMPARE(dataFiles(dataDir).size(), 2);
+		QCOMPARE(inlineStore.load(smallKey), grownData);
+
+		//shrink it again -> back inline
+		inlineStore.save(smallKey, smallData);
+		QCOMPARE(dataFiles(dataDir).size(), 1);
+
+		//upload path reads inline data via the empty file name
+		auto cnt = 0;
+		inlineStore.loadChanges(10, [&](ObjectKey key, quint64, QString file, QUuid) {
+			if(key == smallKey) {
+				[&](){
+					QVERIFY(!file.isNull());
+					QVERIFY(file.isEmpty());
+					QCOMPARE(inlineStore.readJson(key, file), smallData);
+				}();
+			}
+			cnt++;
+			return true;
+		});
+		QCOMPARE(cnt, 2);
+
+		QVERIFY(inlineStore.remove(smallKey));
+		QVERIFY(inlineStore.remove(largeKey));
+		QVERIFY_EXCEPTION_THROWN(inlineStore.load(smallKey), NoDataException);
+		QCOMPARE(dataFiles(dataDir).size(), 0);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestLocalStore::testInlineMigration()
+{
+	const auto largeData = TestLib::generateDataJson(10, QString(4096, QLatin1Char('x')));
+
+	try {
+		auto nName = QStringLiteral("inlineMigration");
+		QDir dataDir(TestLib::tDir.filePath(nName));
+		//all data stored as files without a limit
+		{
+			auto defaults = createSetup(nName);
+			LocalStore fileStore(defaults);
+			for(auto i = 0; i < 5; i++)
+				fileStore.save(TestLib::generateKey(i), TestLib::generateDataJson(i));
+			fileStore.save(TestLib::generateKey(10), largeData);
+			QVERIFY(dataDir.cd(QStringLiteral("store/data_TestData")));
+			QCOMPARE(dataFiles(dataDir).size(), 6);
+		}
+
+		//raising the limit moves the small datasets into the database
+		auto defaults = createSetup(nName, [](Setup &setup) {
+			setup.setInlineDataLimit(1024);
+		});
+		LocalStore inlineStore(defaults);
+		inlineStore.migrateInlineData();
+		QCOMPARE(dataFiles(dataDir).size(), 1);
+
+		auto database = defaults.aquireDatabase(this);
+		QSqlQuery inlineQuery(database);
+		QVERIFY(inlineQuery.exec(QStringLiteral("SELECT COUNT(*) FROM DataIndex WHERE File = '' AND Data IS NOT NULL")));
+		QVERIFY(inlineQuery.first());
+		QCOMPARE(inlineQuery.value(0).toInt(), 5);
+
+		for(auto i = 0; i < 5; i++)
+			QCOMPARE(inlineStore.load(TestLib::generateKey(i)), TestLib::generateDataJson(i));
+		QCOMPARE(inlineStore.load(TestLib::generateKey(10)), largeData);
+		QCOMPARE(inlineStore.count(TestLib::TypeName), 6ull);
+
+		//already migrated -> nothing to do
+		inlineStore.migrateInlineData();
+		QCOMPARE(dataFiles(dataDir).size(), 1);
+		QCOMPARE(inlineStore.load(TestLib::generateKey(10)), largeData);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestLocalStore::testShardedFiles()
+{
+	auto gen = [](int index) {
+		return TestLib::generateDataJson(index, QString(2048, QLatin1Char('x')));
+	};
+
+	try {
+		auto nName = QStringLiteral("sharded");
+		auto defaults = createSetup(nName, [](Setup &setup) {
+			setup.setInlineDataLimit(1024);
+		});
+
+		LocalStore shardStore(defaults);
+		for(auto i = 0; i < 10; i++)
+			shardStore.save(TestLib::generateKey(i), gen(i));
+
+		//files are placed in two levels of directories, named after the start of the file name
+		QDir dataDir(TestLib::tDir.filePath(nName));
+		QVERIFY(dataDir.cd(QStringLiteral("store/data_TestData")));
+		const auto files = dataFiles(dataDir);
+		QCOMPARE(files.size(), 10);
+		QRegularExpression shardRegex{QStringLiteral("^([0-9a-f]{2})/([0-9a-f]{2})/\\1\\2\\w+\\.dat$")};
+		for(const auto &file : files)
+			QVERIFY2(shardRegex.match(file).hasMatch(), qUtf8Printable(file));
+
+		QCOMPARE(shardStore.load(TestLib::generateKey(4)), gen(4));
+		shardStore.save(TestLib::generateKey(4), gen(40));
+		QCOMPARE(shardStore.load(TestLib::generateKey(4)), gen(40));
+		QVERIFY(shardStore.remove(TestLib::generateKey(5)));
+		QCOMPARE(dataFiles(dataDir).size(), 9);
+
+		//already sharded -> nothing to migrate
+		shardStore.migrateFileLayout();
+		QCOMPARE(dataFiles(dataDir).size(), 9);
+		QCOMPARE(shardStore.load(TestLib::generateKey(6)), gen(6));
+
+		//clear removes all files
+		shardStore.clear(TestLib::TypeName);
+		QVERIFY(dataFiles(dataDir).isEmpty());
+		QCOMPARE(shardStore.count(TestLib::TypeName), 0ull);
+
+		shardStore.save(TestLib::generateKey(1), gen(1));
+		QCOMPARE(shardStore.load(TestLib::generateKey(1)), gen(1));
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestLocalStore::testFileLayoutMigration()
+{
+	try {
+		auto nName = QStringLiteral("fileLayout");
+		{
+			auto defaults = createSetup(nName);
+			LocalStore oldStore(defaults);
+			for(auto i = 0; i < 5; i++)
+				oldStore.save(TestLib::generateKey(i), TestLib::generateDataJson(i));
+		}
+
+		//recreated, so no data is served from the cache
+		auto defaults = createSetup(nName);
+		QDir dataDir(TestLib::tDir.filePath(nName));
+		QVERIFY(dataDir.cd(QStringLiteral("store/data_TestData")));
+
+		//move the files back into the flat layout of older stores
+		auto database = defaults.aquireDatabase(this);
+		QSqlQuery filesQuery(database);
+		QVERIFY(filesQuery.exec(QStringLiteral("SELECT Type, Id, File FROM DataIndex")));
+		QStringList flatFiles;
+		while(filesQuery.next()) {
+			const auto shardedName = filesQuery.value(2).toString();
+			const auto flatName = shardedName.section(QLatin1Char('/'), -1);
+			QVERIFY(shardedName.contains(QLatin1Char('/')));
+			QVERIFY(QFile::rename(dataDir.absoluteFilePath(shardedName + QStringLiteral(".dat")),
+								  dataDir.absoluteFilePath(flatName + QStringLiteral(".dat"))));
+			QSqlQuery flattenQuery(database);
+			flattenQuery.prepare(QStringLiteral("UPDATE DataIndex SET File = ? WHERE Type = ? AND Id = ?"));
+			flattenQuery.addBindValue(flatName);
+			flattenQuery.addBindValue(filesQuery.value(0));
+			flattenQuery.addBindValue(filesQuery.value(1));
+			QVERIFY2(flattenQuery.exec(), qUtf8Printable(flattenQuery.lastError().text()));
+			flatFiles.append(flatName + QStringLiteral(".dat"));
+		}
+		QCOMPARE(flatFiles.size(), 5);
+		QCOMPAREUNORDERED(dataFiles(dataDir), flatFiles);
+		{
+			QScopedPointer<QSettings> settings{defaults.createSettings(nullptr, QStringLiteral("store"))};
+			settings->remove(QStringLiteral("shardedFiles"));
+		}
+
+		//files are copied into the sharded directories and the old ones removed
+		LocalStore newStore(defaults);
+		newStore.migrateFileLayout();
+		const auto files = dataFiles(dataDir);
+		QCOMPARE(files.size(), 5);
+		QRegularExpression shardRegex{QStringLiteral("^([0-9a-f]{2})/([0-9a-f]{2})/\\1\\2\\w+\\.dat$")};
+		for(const auto &file : files)
+			QVERIFY2(shardRegex.match(file).hasMatch(), qUtf8Printable(file));
+		for(const auto &file : qAsConst(flatFiles))
+			QVERIFY(!dataDir.exists(file));
+
+		QSqlQuery movedQuery(database);
+		QVERIFY(movedQuery.exec(QStringLiteral("SELECT COUNT(*) FROM DataIndex WHERE File LIKE '%/%'")));
+		QVERIFY(movedQuery.first());
+		QCOMPARE(movedQuery.value(0).toInt(), 5);
+		{
+			QScopedPointer<QSettings> settings{defaults.createSettings(nullptr, QStringLiteral("store"))};
+			QVERIFY(settings->value(QStringLiteral("shardedFiles"), false).toBool());
+		}
+
+		for(auto i = 0; i < 5; i++)
+			QCOMPARE(newStore.load(TestLib::generateKey(i)), TestLib::generateDataJson(i));
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestLocalStore::testCompression()
+{
+	const auto largeKey = TestLib::generateKey(60);
+	const auto largeData = TestLib::generateDataJson(60, QStringLiteral("compress me ").repeated(400));
+	const auto largeSize = LocalStore::toStorageFormat(largeData).size();
+	const auto smallKey = TestLib::generateKey(61);
+	const auto smallData = TestLib::generateDataJson(61);
+	DataCodec::registerCodec(new ReverseCodec{});
+
+	try {
+		auto nName = QStringLiteral("compressed");
+		{
+			auto defaults = createSetup(nName, [](Setup &setup) {
+				setup.setCompressionCodec(QStringLiteral("zlib"));
+			});
+
+			LocalStore compStore(defaults);
+			compStore.save(largeKey, largeData);
+			compStore.save(smallKey, smallData);
+
+			//only the large dataset is compressed
+			QDir dataDir(TestLib::tDir.filePath(nName));
+			QVERIFY(dataDir.cd(QStringLiteral("store/data_TestData")));
+			const auto files = dataFiles(dataDir);
+			QCOMPARE(files.size(), 2);
+			auto encodedCnt = 0;
+			for(const auto &fileName : files) {
+				QFile file(dataDir.absoluteFilePath(fileName));
+				QVERIFY(file.open(QIODevice::ReadOnly));
+				const auto content = file.readAll();
+				if(CodecHelper::isEncoded(content)) {
+					encodedCnt++;
+					QVERIFY(content.size() < largeSize / 4);
+					QCOMPARE(CodecHelper::decode(content).size(), largeSize);
+				} else
+					QVERIFY(LocalStore::fromStorageFormat(content).isObject());
+			}
+			QCOMPARE(encodedCnt, 1);
+
+			QCOMPARE(compStore.load(largeKey), largeData);
+			QCOMPARE(compStore.load(smallKey), smallData);
+		}
+
+		//switch the codec -> old data stays readable
+		{
+			auto defaults = createSetup(nName, [](Setup &setup) {
+				setup.setCompressionCodec(QStringLiteral("zlib"))
+						.setTypeCompressionCodec<TestData>(QStringLiteral("reverse"));
+			});
+
+			LocalStore compStore(defaults);
+			QCOMPARE(compStore.load(largeKey), largeData);
+			const auto otherKey = TestLib::generateKey(62);
+			const auto otherData = TestLib::generateDataJson(62, QStringLiteral("also compressed ").repeated(400));
+			compStore.save(otherKey, otherData);
+			QCOMPARE(compStore.load(otherKey), otherData);
+			QCOMPAREUNORDERED(compStore.loadAll(TestLib::TypeName), QList<QJsonObject>({largeData, smallData, otherData}));
+		}
+
+		//uploaded changes
+		auto plain = SyncHelper::combine(largeKey, 1, largeData);
+		auto compressed = SyncHelper::combine(largeKey, 1, largeData, "zlib", 256);
+		QVERIFY(compressed.size() < plain.size() / 4);
+		QCOMPARE(SyncHelper::combine(smallKey, 1, smallData, "zlib", 256), SyncHelper::combine(smallKey, 1, smallData));
+		auto extracted = SyncHelper::extract(compressed);
+		QCOMPARE(std::get<0>(extracted), false);
+		QCOMPARE(std::get<1>(extracted), largeKey);
+		QCOMPARE(std::get<3>(extracted), largeData);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestLocalStore::testStorageFormat()
+{
+	const auto key = TestLib::generateKey(63);
+	const auto data = TestLib::generateDataJson(63);
+	const auto newData = TestLib::generateDataJson(63, QStringLiteral("new"));
+
+	try {
+		auto nName = QStringLiteral("format");
+		auto defaults = createSetup(nName, [](Setup &setup) {
+			setup.setCacheSize(0) //always parse the stored data
+					.setInlineDataLimit(1024);
+		});
+
+		{
+			LocalStore formatStore(defaults);
+			auto database = defaults.aquireDatabase(this);
+			formatStore.save(key, data);
+
+			auto readData = [&]() {
+				QSqlQuery loadQuery(database);
+				[&](){
+					QVERIFY(loadQuery.prepare(QStringLiteral("SELECT Data FROM DataIndex WHERE Type = (SELECT Id FROM Types WHERE Name = ?) AND Id = ?")));
+					loadQuery.addBindValue(key.typeName);
+					loadQuery.addBindValue(key.id);
+					QVERIFY(loadQuery.exec());
+					QVERIFY(loadQuery.first());
+				}();
+				return loadQuery.value(0).toByteArray();
+			};
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+			QVERIFY(readData().startsWith("\xd9\xd9\xf7"));
+#endif
+
+			//replace with data as written by older versions -> still readable
+			QSqlQuery updateQuery(database);
+			QVERIFY(updateQuery.prepare(QStringLiteral("UPDATE DataIndex SET Data = ? WHERE Type = (SELECT Id FROM Types WHERE Name = ?) AND Id = ?")));
+			updateQuery.addBindValue(QJsonDocument(data).toBinaryData());
+			updateQuery.addBindValue(key.typeName);
+			updateQuery.addBindValue(key.id);
+			QVERIFY(updateQuery.exec());
+			QVERIFY(readData().startsWith("qbjs"));
+			QCOMPARE(formatStore.load(key), data);
+			QCOMPARE(formatStore.loadAll(TestLib::TypeName), QList<QJsonObject>({data}));
+
+			//saving converts it
+			formatStore.save(key, newData);
+			QCOMPARE(LocalStore::toStorageFormat(newData), readData());
+			QCOMPARE(formatStore.load(key), newData);
+		}
+
+		//all json types survive the conversion
+		QJsonObject allTypes {
+			{QStringLiteral("null"), QJsonValue::Null},
+			{QStringLiteral("true"), true},
+			{QStringLiteral("false"), false},
+			{QStringLiteral("int"), 42},
+			{QStringLiteral("negative"), -42},
+			{QStringLiteral("double"), 4.2},
+			{QStringLiteral("large"), 1e300},
+			{QStringLiteral("string"), QStringLiteral("text \u00e4\u00f6\u00fc")},
+			{QStringLiteral("array"), QJsonArray{1, QStringLiteral("two"), QJsonArray{3}}},
+			{QStringLiteral("object"), QJsonObject{{QStringLiteral("inner"), QJsonObject{}}}}
+		};
+		QCOMPARE(LocalStore::fromStorageFormat(LocalStore::toStorageFormat(allTypes)).object(), allTypes);
+		QVERIFY(LocalStore::fromStorageFormat("invalid").isNull());
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestLocalStore::testSaveBatch()
+{
+	QSignalSpy changeSpy(store, &LocalStore::dataChanged);
+
+	try {
+		store->reset(false);
+		store->save(TestLib::generateKey(60), TestLib::generateDataJson(60));
+		changeSpy.clear();
+
+		QHash<QString, QJsonObject> batch;
+		for(auto i = 60; i < 70; i++)
+			batch.insert(QString::number(i), TestLib::generateDataJson(i, QStringLiteral("batch")));
+		store->saveBatch(TestLib::TypeName, batch);
+
+		QCOMPARE(store->count(TestLib::TypeName), 10ull);
+		for(auto i = 60; i < 70; i++)
+			QCOMPARE(store->load(TestLib::generateKey(i)), batch.value(QString::number(i)));
+		QCOMPARE(changeSpy.size(), 10);
+		for(const auto &sig : qAsConst(changeSpy)) {
+			QCOMPARE(sig[0].value<ObjectKey>().typeName, TestLib::TypeName);
+			QCOMPARE(sig[1].toBool(), false);
+		}
+
+		//existing entry was updated, not duplicated
+		QCOMPARE(store->changeCount(), 10u);
+		store->loadChanges(10, [&](ObjectKey key, quint64 version, QString, QUuid) {
+			[&](){
+				QCOMPARE(version, key == TestLib::generateKey(60) ? 2ull : 1ull);
+			}();
+			return true;
+		});
+
+		store->reset(false);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestLocalStore::testLoadRemoveMany()
+{
+	QSignalSpy changeSpy(store, &LocalStore::dataChanged);
+
+	try {
+		store->reset(false);
+		QHash<QString, QJsonObject> batch;
+		for(auto i = 80; i < 85; i++)
+			batch.insert(QString::number(i), TestLib::generateDataJson(i));
+		store->saveBatch(TestLib::TypeName, batch);
+		changeSpy.clear();
+
+		//load in the given order, skip unknown ones
+		const QStringList ids {
+			QStringLiteral("84"),
+			QStringLiteral("99"),
+			QStringLiteral("80"),
+			QStringLiteral("82")
+		};
+		QCOMPARE(store->loadMany(TestLib::TypeName, ids), QList<QJsonObject>({
+			TestLib::generateDataJson(84),
+			TestLib::generateDataJson(80),
+			TestLib::generateDataJson(82)
+		}));
+		QVERIFY(store->loadMany(TestLib::TypeName, {}).isEmpty());
+
+		//duplicates are returned for every occurrence
+		QCOMPARE(store->loadMany(TestLib::TypeName, {QStringLiteral("83"), QStringLiteral("99"), QStringLiteral("83"), QStringLiteral("81")}),
+				 QList<QJsonObject>({
+					 TestLib::generateDataJson(83),
+					 TestLib::generateDataJson(83),
+					 TestLib::generateDataJson(81)
+				 }));
+
+		//remove only existing ones
+		QCOMPAREUNORDERED(store->removeMany(TestLib::TypeName, ids), QStringList({
+			QStringLiteral("84"),
+			QStringLiteral("80"),
+			QStringLiteral("82")
+		}));
+		QCOMPARE(store->count(TestLib::TypeName), 2ull);
+		QVERIFY_EXCEPTION_THROWN(store->load(TestLib::generateKey(80)), NoDataException);
+		QVERIFY(store->loadMany(TestLib::TypeName, ids).isEmpty());
+		QCOMPARE(changeSpy.size(), 3);
+		for(const auto &sig : qAsConst(changeSpy))
+			QCOMPARE(sig[1].toBool(), true);
+
+		//removing again does nothing
+		QVERIFY(store->removeMany(TestLib::TypeName, ids).isEmpty());
+		QCOMPARE(changeSpy.size(), 3);
+
+		store->reset(false);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestLocalStore::testPaging()
+{
+	try {
+		store->reset(false);
+		QHash<QString, QJsonObject> batch;
+		for(auto i = 10; i < 35; i++)
+			batch.insert(QString::number(i), TestLib::generateDataJson(i));
+		store->saveBatch(TestLib::TypeName, batch);
+		store->remove(TestLib::generateKey(20));
+
+		//offset based keys, sorted
+		QCOMPARE(store->keys(TestLib::TypeName, 0, 3), QStringList({
+			QStringLiteral("10"),
+			QStringLiteral("11"),
+			QStringLiteral("12")
+		}));
+		QCOMPARE(store->keys(TestLib::TypeName, 9, 2), QStringList({
+			QStringLiteral("19"),
+			QStringLiteral("21")
+		}));
+		QCOMPARE(store->keys(TestLib::TypeName, 20, -1).size(), 4);
+		QVERIFY(store->keys(TestLib::TypeName, 30, 10).isEmpty());
+
+		//keyset pages, walk through all of them
+		QStringList allKeys;
+		QString after;
+		forever {
+			auto page = store->loadPage(TestLib::TypeName, after, 10);
+			for(const auto &entry : page) {
+				QCOMPARE(entry.second, TestLib::generateDataJson(entry.first.toInt()));
+				allKeys.append(entry.first);
+			}
+			if(page.size() < 10)
+				break;
+			after = page.last().first;
+		}
+		QCOMPARE(allKeys.size(), 24);
+		QVERIFY(!allKeys.contains(QStringLiteral("20")));
+		QCOMPARE(allKeys, store->keys(TestLib::TypeName, 0, -1));
+
+		//continue after a key that does not exist
+		auto page = store->loadPage(TestLib::TypeName, QStringLiteral("195"), 2);
+		QCOMPARE(page.size(), 2);
+		QCOMPARE(page[0].first, QStringLiteral("21"));
+		QCOMPARE(page[1].first, QStringLiteral("22"));
+
+		store->reset(false);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestLocalStore::testPropertyIndex()
+{
+	const auto textKey = QStringLiteral("text");
+	auto gen = [](int index, const char *text) {
+		return TestLib::generateDataJson(index, QString::fromUtf8(text));
+	};
+
+	try {
+		auto nName = QStringLiteral("indexes");
+		//create data without an index
+		{
+			auto defaults = createSetup(nName);
+
+			LocalStore indexStore(defaults);
+			indexStore.save(TestLib::generateKey(1), gen(1, "a"));
+			indexStore.save(TestLib::generateKey(2), gen(2, "b"));
+			indexStore.save(TestLib::generateKey(3), gen(3, "a"));
+			indexStore.save(TestLib::generateKey(4), gen(4, "c"));
+			QVERIFY_EXCEPTION_THROWN(indexStore.findBy(TestLib::TypeName, textKey, QStringLiteral("a")), LocalStoreException);
+		}
+
+		//reopen with an index -> built from existing data
+		auto defaults = createSetup(nName, [&](Setup &setup) {
+			setup.addIndex<TestData>(textKey);
+		});
+
+		LocalStore indexStore(defaults);
+		QCOMPARE(indexStore.findBy(TestLib::TypeName, textKey, QStringLiteral("a")), QList<QJsonObject>({gen(1, "a"), gen(3, "a")}));
+		QVERIFY(indexStore.findBy(TestLib::TypeName, textKey, QStringLiteral("d")).isEmpty());
+		QVERIFY_EXCEPTION_THROWN(indexStore.findBy(TestLib::TypeName, QStringLiteral("id"), 1), LocalStoreException);
+
+		//index follows changes
+		indexStore.save(TestLib::generateKey(5), gen(5, "a"));
+		indexStore.save(TestLib::generateKey(1), gen(1, "b"));
+		QVERIFY(indexStore.remove(TestLib::generateKey(3)));
+		QCOMPARE(indexStore.findBy(TestLib::TypeName, textKey, QStringLiteral("a")), QList<QJsonObject>({gen(5, "a")}));
+		QCOMPARE(indexStore.findBy(TestLib::TypeName, textKey, QStringLiteral("b")), QList<QJsonObject>({gen(1, "b"), gen(2, "b")}));
+
+		QHash<QString, QJsonObject> batch;
+		batch.insert(QStringLiteral("6"), gen(6, "c"));
+		batch.insert(QStringLiteral("2"), gen(2, "c"));
+		indexStore.saveBatch(TestLib::TypeName, batch);
+		QCOMPARE(indexStore.findBy(TestLib::TypeName, textKey, QStringLiteral("c")), QList<QJsonObject>({gen(2, "c"), gen(4, "c"), gen(6, "c")}));
+		indexStore.removeMany(TestLib::TypeName, {QStringLiteral("4"), QStringLiteral("6")});
+		QCOMPARE(indexStore.findBy(TestLib::TypeName, textKey, QStringLiteral("c")), QList<QJsonObject>({gen(2, "c")}));
+
+		//booleans only match booleans, not the numbers or strings they could be converted to
+		auto boolData = TestLib::generateDataJson(7);
+		boolData[textKey] = true;
+		auto numberData = TestLib::generateDataJson(8);
+		numberData[textKey] = 1;
+		auto stringData = TestLib::generateDataJson(9);
+		stringData[textKey] = QStringLiteral("true");
+		indexStore.save(TestLib::generateKey(7), boolData);
+		indexStore.save(TestLib::generateKey(8), numberData);
+		indexStore.save(TestLib::generateKey(9), stringData);
+		QCOMPARE(indexStore.findBy(TestLib::TypeName, textKey, true), QList<QJsonObject>({boolData}));
+		QVERIFY(indexStore.findBy(TestLib::TypeName, textKey, false).isEmpty());
+		QCOMPARE(indexStore.findBy(TestLib::TypeName, textKey, 1), QList<QJsonObject>({numberData}));
+		QCOMPARE(indexStore.findBy(TestLib::TypeName, textKey, QStringLiteral("true")), QList<QJsonObject>({stringData}));
+
+		indexStore.clear(TestLib::TypeName);
+		QVERIFY(indexStore.findBy(TestLib::TypeName, textKey, QStringLiteral("b")).isEmpty());
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestLocalStore::testFullTextSearch()
+{
+	auto gen = [](int index, const char *text) {
+		return TestLib::generateDataJson(index, QString::fromUtf8(text));
+	};
+
+	try {
+		auto nName = QStringLiteral("fulltext");
+		auto defaults = createSetup(nName, [](Setup &setup) {
+			setup.addFullTextIndex<TestData>({QStringLiteral("text")});
+		});
+
+		LocalStore ftsStore(defaults);
+		ftsStore.save(TestLib::generateKey(1), gen(1, "The quick brown fox"));
+		ftsStore.save(TestLib::generateKey(2), gen(2, "A lazy dog"));
+		ftsStore.save(TestLib::generateKey(3), gen(3, "Brown dogs and brown cats"));
+
+		QCOMPAREUNORDERED(ftsStore.fullTextSearch(TestLib::TypeName, QStringLiteral("brown"), -1), QList<QJsonObject>({
+			gen(1, "The quick brown fox"),
+			gen(3, "Brown dogs and brown cats")
+		}));
+		QCOMPARE(ftsStore.fullTextSearch(TestLib::TypeName, QStringLiteral("brown"), 1).size(), 1);
+		QCOMPARE(ftsStore.fullTextSearch(TestLib::TypeName, QStringLiteral("dog*"), -1).size(), 2);
+		QCOMPARE(ftsStore.fullTextSearch(TestLib::TypeName, QStringLiteral("lazy AND dog"), -1), QList<QJsonObject>({gen(2, "A lazy dog")}));
+		QVERIFY(ftsStore.fullTextSearch(TestLib::TypeName, QStringLiteral("elephant"), -1).isEmpty());
+		QVERIFY_EXCEPTION_THROWN(ftsStore.fullTextSearch("OtherType", QStringLiteral("brown"), -1), LocalStoreException);
+
+		//index follows changes
+		ftsStore.save(TestLib::generateKey(1), gen(1, "The quick red fox"));
+		QVERIFY(ftsStore.remove(TestLib::generateKey(2)));
+		QCOMPARE(ftsStore.fullTextSearch(TestLib::TypeName, QStringLiteral("brown"), -1), QList<QJsonObject>({gen(3, "Brown dogs and brown cats")}));
+		QCOMPARE(ftsStore.fullTextSearch(TestLib::TypeName, QStringLiteral("dog*"), -1), QList<QJsonObject>({gen(3, "Brown dogs and brown cats")}));
+
+		ftsStore.clear(TestLib::TypeName);
+		QVERIFY(ftsStore.fullTextSearch(TestLib::TypeName, QStringLiteral("fox"), -1).isEmpty());
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestLocalStore::testPackedStorage()
+{
+	auto gen = [](int index, char fill) {
+		return TestLib::generateDataJson(index, QString(2048, QLatin1Char(fill)));
+	};
+	auto packSize = [](const QDir &dir) {
+		qint64 size = 0;
+		for(const auto &info : dir.entryInfoList({QStringLiteral("*.pack")}, QDir::Files))
+			size += info.size();
+		return size;
+	};
+
+	try {
+		auto nName = QStringLiteral("packed");
+		auto defaults = createSetup(nName, [](Setup &setup) {
+			setup.setInlineDataLimit(1024)
+					.setSegmentSize(16384)
+					.setCompactionThreshold(0.25);
+		});
+
+		LocalStore packStore(defaults);
+		for(auto i = 0; i < 20; i++)
+			packStore.save(TestLib::generateKey(i), gen(i, 'a'));
+
+		//no single data files, only segments
+		QDir dataDir(TestLib::tDir.filePath(nName));
+		QVERIFY(dataDir.cd(QStringLiteral("store/data_TestData")));
+		const auto files = dataDir.entryList(QDir::Files);
+		QVERIFY(files.size() > 1);
+		for(const auto &file : files)
+			QVERIFY2(file.endsWith(QStringLiteral(".pack")), qUtf8Printable(file));
+
+		QCOMPARE(packStore.count(TestLib::TypeName), 20ull);
+		QCOMPARE(packStore.load(TestLib::generateKey(7)), gen(7, 'a'));
+
+		//overwrite and remove leave unused data behind
+		for(auto i = 0; i < 10; i++)
+			packStore.save(TestLib::generateKey(i), gen(i, 'b'));
+		for(auto i = 10; i < 15; i++)
+			QVERIFY(packStore.remove(TestLib::generateKey(i)));
+		QCOMPARE(packStore.load(TestLib::generateKey(3)), gen(3, 'b'));
+		QVERIFY_EXCEPTION_THROWN(packStore.load(TestLib::generateKey(12)), NoDataException);
+
+		//first run moves the live data, second removes the old segments
+		const auto oldSize = packSize(dataDir);
+		packStore.compactSegments();
+		packStore.compactSegments();
+		QVERIFY(packSize(dataDir) < oldSize);
+
+		QList<QJsonObject> expected;
+		for(auto i = 0; i < 10; i++)
+			expected.append(gen(i, 'b'));
+		for(auto i = 15; i < 20; i++)
+			expected.append(gen(i, 'a'));
+		QCOMPAREUNORDERED(packStore.loadAll(TestLib::TypeName), expected);
+
+		//segments of cleared types are removed by the next compaction
+		packStore.clear(TestLib::TypeName);
+		packStore.compactSegments();
+		QVERIFY(dataDir.entryList({QStringLiteral("*.pack")}, QDir::Files).isEmpty());
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestLocalStore::testTypeStats()
+{
+	try {
+		store->reset(false);
+		QCOMPARE(store->count(TestLib::TypeName), 0ull);
+		QCOMPARE(store->storedSize(TestLib::TypeName), 0ull);
+		QCOMPARE(store->changeCount(), 0u);
+
+		//saving counts objects, bytes and changes
+		for(auto i = 0; i < 3; i++)
+			store->save(TestLib::generateKey(i), TestLib::generateDataJson(i));
+		QCOMPARE(store->count(TestLib::TypeName), 3ull);
+		const auto size = store->storedSize(TestLib::TypeName);
+		QVERIFY(size > 0);
+		QCOMPARE(store->changeCount(), 3u);
+
+		//overwriting only changes the size
+		store->save(TestLib::generateKey(1), TestLib::generateDataJson(1, QStringLiteral("a much longer text than before")));
+		QCOMPARE(store->count(TestLib::TypeName), 3ull);
+		QVERIFY(store->storedSize(TestLib::TypeName) > size);
+		QCOMPARE(store->changeCount(), 3u);
+
+		//removing keeps the change
+		QVERIFY(store->remove(TestLib::generateKey(1)));
+		QCOMPARE(store->count(TestLib::TypeName), 2ull);
+		QVERIFY(store->storedSize(TestLib::TypeName) < size);
+		QVERIFY(store->storedSize(TestLib::TypeName) > 0);
+		QCOMPARE(store->changeCount(), 3u);
+		store->markUnchanged(TestLib::generateKey(0), 1, false);
+		store->markUnchanged(TestLib::generateKey(1), 3, true);
+		QCOMPARE(store->changeCount(), 1u);
+
+		//clear and reset
+		store->clear(TestLib::TypeName);
+		QCOMPARE(store->count(TestLib::TypeName), 0ull);
+		QCOMPARE(store->storedSize(TestLib::TypeName), 0ull);
+		QCOMPARE(store->changeCount(), 2u);
+		store->reset(false);
+		QCOMPARE(store->changeCount(), 0u);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestLocalStore::testTypeIdUpgrade()
+{
+	const auto textKey = QStringLiteral("text");
+	try {
+		auto nName = QStringLiteral("typeIdUpgrade");
+		auto defaults = createSetup(nName, [&](Setup &setup) {
+			setup.addIndex<TestData>(textKey);
+		});
+
+		auto database = defaults.aquireDatabase(this);
+		quint64 size;
+		{
+			LocalStore oldStore(defaults);
+			for(auto i = 0; i < 3; i++)
+				oldStore.save(TestLib::generateKey(i), TestLib::generateDataJson(i));
+			size = oldStore.storedSize(TestLib::TypeName);
+		}
+
+		//tables as created by schema version 4, with type names instead of ids
+		const QStringList typeTables {
+			QStringLiteral("DataIndex"),
+			QStringLiteral("DeviceUploads"),
+			QStringLiteral("ChangeLog"),
+			QStringLiteral("PropertyIndex"),
+			QStringLiteral("IndexedProperties")
+		};
+		QStringList downgradeStatements;
+		for(const auto &table : typeTables) {
+			downgradeStatements.append(QStringLiteral("CREATE TABLE %1Old AS SELECT * FROM %1").arg(table));
+			downgradeStatements.append(QStringLiteral("UPDATE %1Old SET Type = (SELECT Name FROM Types WHERE Types.Id = %1Old.Type)").arg(table));
+		}
+		downgradeStatements += {
+			QStringLiteral("DROP TABLE ChangeLog"),
+			QStringLiteral("DROP TABLE DeviceUploads"),
+			QStringLiteral("DROP TABLE TypeStats"),
+			QStringLiteral("DROP TABLE DataIndex"),
+			QStringLiteral("DROP TABLE PropertyIndex"),
+			QStringLiteral("DROP TABLE IndexedProperties"),
+			QStringLiteral("DROP TABLE AccessCounts"),
+			QStringLiteral("DROP TABLE Types")
+		};
+		for(const auto &table : typeTables)
+			downgradeStatements.append(QStringLiteral("ALTER TABLE %1Old RENAME TO %1").arg(table));
+		downgradeStatements += {
+			QStringLiteral("CREATE TABLE TypeStats ( "
+						   "	Type	TEXT NOT NULL, "
+						   "	Objects	INTEGER NOT NULL DEFAULT 0, "
+						   "	Bytes	INTEGER NOT NULL DEFAULT 0, "
+						   "	Changes	INTEGER NOT NULL DEFAULT 0, "
+						   "	PRIMARY KEY(Type) "
+						   ") WITHOUT ROWID;"),
+			QStringLiteral("INSERT INTO TypeStats (Type, Objects, Bytes, Changes) VALUES('%1', 3, %2, 3)")
+				.arg(QString::fromUtf8(TestLib::TypeName))
+				.arg(size),
+			QStringLiteral("PRAGMA user_version = 4")
+		};
+		for(const auto &statement : qAsConst(downgradeStatements)) {
+			QSqlQuery downgradeQuery(database);
+			QVERIFY2(downgradeQuery.exec(statement), qUtf8Printable(downgradeQuery.lastError().text()));
+		}
+
+		auto typeColumnTypes = [&](const QString &table) {
+			QStringList types;
+			QSqlQuery typeQuery(database);
+			[&](){
+				QVERIFY(typeQuery.exec(QStringLiteral("SELECT DISTINCT typeof(Type) FROM %1").arg(table)));
+			}();
+			while(typeQuery.next())
+				types.append(typeQuery.value(0).toString());
+			return types;
+		};
+		QCOMPARE(typeColumnTypes(QStringLiteral("DataIndex")), QStringList{QStringLiteral("text")});
+		QCOMPARE(typeColumnTypes(QStringLiteral("PropertyIndex")), QStringList{QStringLiteral("text")});
+
+		//opening the store replaces the names in all tables and keeps the data, counters and indexes
+		LocalStore newStore(defaults);
+		for(const auto &table : {QStringLiteral("DataIndex"), QStringLiteral("ChangeLog"), QStringLiteral("TypeStats"),
+								 QStringLiteral("PropertyIndex"), QStringLiteral("IndexedProperties")})
+			QCOMPARE(typeColumnTypes(table), QStringList{QStringLiteral("integer")});
+		QCOMPARE(newStore.count(TestLib::TypeName), 3ull);
+		QCOMPARE(newStore.storedSize(TestLib::TypeName), size);
+		QCOMPARE(newStore.changeCount(), 3u);
+		QCOMPARE(newStore.load(TestLib::generateKey(1)), TestLib::generateDataJson(1));
+		QCOMPARE(newStore.findBy(TestLib::TypeName, textKey, QStringLiteral("2")),
+				 QList<QJsonObject>{TestLib::generateDataJson(2)});
+
+		newStore.save(TestLib::generateKey(3), TestLib::generateDataJson(3));
+		QCOMPARE(newStore.count(TestLib::TypeName), 4ull);
+		QCOMPARE(newStore.findBy(TestLib::TypeName, textKey, QStringLiteral("3")),
+				 QList<QJsonObject>{TestLib::generateDataJson(3)});
+		QCOMPARE(typeColumnTypes(QStringLiteral("PropertyIndex")), QStringList{QStringLiteral("integer")});
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestLocalStore::testWriteBehind()
+{
+	try {
+		auto nName = QStringLiteral("writeBehind");
+		{
+			auto defaults = createSetup(nName, [](Setup &setup) {
+				setup.setWriteBehindDelay(60000) //never flushed by the timer within the test
+						.setWriteBehindLimit(20);
+			});
+
+			auto journal = defaults.writeJournal();
+			QVERIFY(journal);
+			LocalStore wbStore(defaults);
+			LocalStore otherStore(defaults);
+			QSignalSpy changeSpy(&wbStore, &LocalStore::dataChanged);
+
+			//saves are only journaled, but visible to all stores and announced right away
+			for(auto i = 0; i < 10; i++)
+				wbStore.save(TestLib::generateKey(i), TestLib::generateDataJson(i));
+			QVERIFY(!journal->isEmpty());
+			QCOMPARE(otherStore.load(TestLib::generateKey(3)), TestLib::generateDataJson(3));
+			wbStore.save(TestLib::generateKey(3), TestLib::generateDataJson(3, QStringLiteral("again")));
+			QCOMPARE(otherStore.load(TestLib::generateKey(3)), TestLib::generateDataJson(3, QStringLiteral("again")));
+			QCOMPARE(changeSpy.size(), 11);
+			QCOMPARE(changeSpy.last()[0].value<ObjectKey>(), TestLib::generateKey(3));
+			QCOMPARE(changeSpy.last()[1].toBool(), false);
+
+			//reads of the whole type include the journal, without writing it
+			QList<QJsonObject> expected;
+			for(auto i = 0; i < 10; i++)
+				expected.append(i == 3 ? TestLib::generateDataJson(3, QStringLiteral("again")) : TestLib::generateDataJson(i));
+			QCOMPARE(otherStore.count(TestLib::TypeName), 10ull);
+			QCOMPARE(otherStore.keys(TestLib::TypeName).size(), 10);
+			QCOMPAREUNORDERED(otherStore.loadAll(TestLib::TypeName), expected);
+			QList<QJsonObject> visited;
+			otherStore.iterate(TestLib::TypeName, [&](const ObjectKey &, const QJsonObject &data) {
+				visited.append(data);
+				return true;
+			});
+			QCOMPAREUNORDERED(visited, expected);
+			QCOMPARE(otherStore.loadMany(TestLib::TypeName, {TestLib::generateDataKey(3)}),
+					 QList<QJsonObject>{TestLib::generateDataJson(3, QStringLiteral("again"))});
+			QVERIFY(!journal->isEmpty());
+			QCOMPARE(changeSpy.size(), 11);
+
+			//other queries write them first, in one batch, without announcing them again
+			QCOMPARE(otherStore.keys(TestLib::TypeName, 0, 5).size(), 5);
+			QVERIFY(journal->isEmpty());
+			QCOMPARE(otherStore.changeCount(), 10u);
+			QCOMPARE(changeSpy.size(), 11);
+
+			//keys that are already stored are not counted twice
+			wbStore.save(TestLib::generateKey(3), TestLib::generateDataJson(3));
+			wbStore.save(TestLib::generateKey(50), TestLib::generateDataJson(50));
+			QCOMPARE(otherStore.count(TestLib::TypeName), 11ull);
+			QCOMPARE(otherStore.keys(TestLib::TypeName).size(), 11);
+			expected[3] = TestLib::generateDataJson(3);
+			expected.append(TestLib::generateDataJson(50));
+			QCOMPAREUNORDERED(otherStore.loadAll(TestLib::TypeName), expected);
+			QCOMPARE(otherStore.load(TestLib::generateKey(3)), TestLib::generateDataJson(3));
+			QVERIFY(!journal->isEmpty());
+			QVERIFY(otherStore.storedSize(TestLib::TypeName) > 0);
+			QVERIFY(journal->isEmpty());
+			QCOMPARE(changeSpy.size(), 13);
+
+			//reaching the limit flushes in the background
+			for(auto i = 10; i < 30; i++)
+				wbStore.save(TestLib::generateKey(i), TestLib::generateDataJson(i));
+			QCOMPARE(changeSpy.size(), 33);
+			QTRY_VERIFY(journal->isEmpty());
+
+			//removing the setup flushes as well
+			wbStore.save(TestLib::generateKey(42), TestLib::generateDataJson(42));
+			QVERIFY(!journal->isEmpty());
+		}
+
+		{
+			auto defaults = createSetup(nName);
+
+			LocalStore plainStore(defaults);
+			QCOMPARE(plainStore.count(TestLib::TypeName), 32ull);
+			QCOMPARE(plainStore.load(TestLib::generateKey(42)), TestLib::generateDataJson(42));
+		}
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestLocalStore::testDurability()
+{
+	auto gen = [](int index) {
+		return TestLib::generateDataJson(index, QString(2048, QLatin1Char('x')));
+	};
+
+	try {
+		auto nName = QStringLiteral("durability");
+		auto defaults = createSetup(nName, [](Setup &setup) {
+			setup.setInlineDataLimit(1024)
+					.setDurability(Setup::Normal);
+		});
+
+		{
+			LocalStore durStore(defaults);
+			for(auto i = 0; i < 5; i++)
+				durStore.save(TestLib::generateKey(i), gen(i));
+			durStore.save(TestLib::generateKey(2), gen(20));
+
+			//written files are only flushed at the next checkpoint
+			auto unsynced = defaults.unsyncedFiles();
+			{
+				QMutexLocker _(&unsynced->lock);
+				QVERIFY(!unsynced->paths.isEmpty());
+			}
+			durStore.checkpoint();
+			{
+				QMutexLocker _(&unsynced->lock);
+				QVERIFY(unsynced->paths.isEmpty());
+			}
+
+			//damage one file and pretend the last run crashed
+			QDir dataDir(TestLib::tDir.filePath(nName));
+			QVERIFY(dataDir.cd(QStringLiteral("store/data_TestData")));
+			const auto files = dataFiles(dataDir);
+			QCOMPARE(files.size(), 5);
+			QFile damaged(dataDir.absoluteFilePath(files.first()));
+			QVERIFY(damaged.resize(3));
+			QScopedPointer<QSettings> settings{defaults.createSettings(nullptr, QStringLiteral("store"))};
+			settings->setValue(QStringLiteral("cleanShutdown"), false);
+
+			//recovery quarantines only the broken entry
+			QCOMPARE(durStore.changeCount(), 5u);
+			QSignalSpy changeSpy(&durStore, &LocalStore::dataChanged);
+			durStore.recover();
+			QCOMPARE(durStore.count(TestLib::TypeName), 4ull);
+			QCOMPARE(changeSpy.size(), 1);
+			const auto removedKey = changeSpy.takeFirst()[0].value<ObjectKey>();
+			QVERIFY(!durStore.keys(TestLib::TypeName).contains(removedKey.id));
+			for(const auto &id : durStore.keys(TestLib::TypeName))
+				QVERIFY(!durStore.load({TestLib::TypeName, id}).isEmpty());
+			QVERIFY(!damaged.exists());
+			QVERIFY(QFile::exists(damaged.fileName() + QStringLiteral(".broken")));
+			QCOMPARE(dataFiles(dataDir).size(), 5);
+
+			//not uploaded as delete, but replaced by any remote version
+			QCOMPARE(durStore.changeCount(), 4u);
+			{
+				auto scope = durStore.startSync(removedKey);
+				const auto info = durStore.loadChangeInfo(scope);
+				QCOMPARE(std::get<0>(info), LocalStore::ExistsDeleted);
+				QCOMPARE(std::get<1>(info), 0ull);
+				durStore.storeChanged(scope, 1, std::get<2>(info), gen(30), false, std::get<0>(info));
+				durStore.commitSync(scope);
+			}
+			QCOMPARE(durStore.load(removedKey), gen(30));
+			QCOMPARE(durStore.changeCount(), 4u);
+
+			//files that were not removed after their commit are found as well
+			QVERIFY(dataDir.mkpath(QStringLiteral("ab/cd")));
+			QFile orphan(dataDir.absoluteFilePath(QStringLiteral("ab/cd/abcdorphan.dat")));
+			QVERIFY(orphan.open(QIODevice::WriteOnly));
+			orphan.close();
+			settings->setValue(QStringLiteral("cleanShutdown"), false);
+			durStore.recover();
+			QVERIFY(!orphan.exists());
+			QCOMPARE(dataFiles(dataDir).size(), 6);
+
+			//nothing left to repair
+			settings->setValue(QStringLiteral("cleanShutdown"), false);
+			durStore.recover();
+			QCOMPARE(durStore.count(TestLib::TypeName), 5ull);
+		}
+
+		//a successful shutdown is clean, no matter the durability
+		auto relaxedDefaults = createSetup(QStringLiteral("relaxed"), [](Setup &setup) {
+			setup.setDurability(Setup::Relaxed);
+		});
+		LocalStore relaxedStore(relaxedDefaults);
+		relaxedStore.save(TestLib::generateKey(1), gen(1));
+		relaxedStore.recover();
+		QScopedPointer<QSettings> settings{relaxedDefaults.createSettings(nullptr, QStringLiteral("store"))};
+		QVERIFY(!settings->value(QStringLiteral("cleanShutdown")).toBool());
+		relaxedStore.checkpoint(true);
+		settings->sync();
+		QVERIFY(settings->value(QStringLiteral("cleanShutdown")).toBool());
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestLocalStore::testConcurrentRemove()
+{
+	try {
+		auto nName = QStringLiteral("concurrentremove");
+		auto defaults = createSetup(nName, [](Setup &setup) {
+			setup.setCacheSize(0) //always read the files
+					.setDatabaseConfiguration({true, DatabaseConfig::SyncNormal});
+		});
+
+		LocalStore writeStore(defaults);
+		QHash<QString, QJsonObject> batch;
+		for(auto i = 0; i < 50; i++)
+			batch.insert(TestLib::generateDataKey(i), TestLib::generateDataJson(i));
+
+		//with WAL, readers continue on their snapshot while the writer commits
+		QAtomicInt running = 1;
+		QAtomicInt errors = 0;
+		auto reader = QtConcurrent::run([&](){
+			LocalStore readStore(defaults);//thread without eventloop!
+			while(running.load()) {
+				try {
+					readStore.loadAll(TestLib::TypeName);
+					readStore.iterate(TestLib::TypeName, [](const ObjectKey &, const QJsonObject &) {
+						return true;
+					});
+					QJsonObject json;
+					readStore.tryLoad(TestLib::generateKey(7), json);
+				} catch(QException &e) {
+					qWarning() << e.what();
+					errors.ref();
+				}
+			}
+		});
+
+		auto removed = 0;
+		try {
+			for(auto round = 0; round < 50; round++) {
+				writeStore.saveBatch(TestLib::TypeName, batch);
+				for(auto i = 0; i < 10; i++)
+					removed += writeStore.remove(TestLib::generateKey(i)) ? 1 : 0;
+				writeStore.clear(TestLib::TypeName);
+			}
+		} catch(...) {
+			running.store(0);
+			reader.waitForFinished();
+			throw;
+		}
+		running.store(0);
+		reader.waitForFinished();
+
+		QCOMPARE(removed, 500);
+		QCOMPARE(errors.load(), 0);
+		QCOMPARE(writeStore.count(TestLib::TypeName), 0ull);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestLocalStore::testObjectCache()
+{
+	const auto keyA = TestLib::generateKey(1);
+	const auto keyB = TestLib::generateKey(2);
+	const auto keyC = TestLib::generateKey(3);
+	const auto dataA = TestLib::generateDataJson(1);
+
+	ObjectCache cache{100}; //small enough for a single shard
+	QVERIFY(cache.insert(keyA, dataA, 40));
+	QVERIFY(cache.insert(keyB, TestLib::generateDataJson(2), 40));
+	QCOMPARE(cache.count(), 2);
+	QCOMPARE(cache.totalCost(), 80);
+
+	//a hit gives keyA a second chance, so keyB gets evicted
+	QJsonObject data;
+	QVERIFY(cache.lookup(keyA, data));
+	QCOMPARE(data, dataA);
+	QVERIFY(cache.insert(keyC, TestLib::generateDataJson(3), 40));
+	QVERIFY(cache.lookup(keyA, data));
+	QVERIFY(!cache.lookup(keyB, data));
+	QVERIFY(cache.lookup(keyC, data));
+	QCOMPARE(cache.totalCost(), 80);
+
+	//replacing updates data and costs
+	QVERIFY(cache.insert(keyA, TestLib::generateDataJson(10), 10));
+	QVERIFY(cache.lookup(keyA, data));
+	QCOMPARE(data, TestLib::generateDataJson(10));
+	QCOMPARE(cache.totalCost(), 50);
+
+	//too large objects are not cached and drop the old value
+	QVERIFY(!cache.insert(keyA, dataA, 200));
+	QVERIFY(!cache.lookup(keyA, data));
+	QCOMPARE(cache.count(), 1);
+
+	QVERIFY(cache.remove(keyC));
+	QVERIFY(!cache.remove(keyC));
+	QCOMPARE(cache.count(), 0);
+	QCOMPARE(cache.totalCost(), 0);
+
+	//removed slots are reused
+	QVERIFY(cache.insert(keyA, dataA, 40));
+	QVERIFY(cache.insert(keyB, dataA, 40));
+	cache.clear();
+	QCOMPARE(cache.count(), 0);
+	QVERIFY(!cache.lookup(keyA, data));
+
+	//only remote removals count as invalidations
+	QVERIFY(cache.insert(keyA, dataA, 40));
+	QVERIFY(cache.insert(keyB, dataA, 40));
+	QVERIFY(cache.remove(keyA, true));
+	cache.clear(true);
+
+	const auto statistics = cache.statistics();
+	QCOMPARE(statistics.hits(), 4ull);
+	QCOMPARE(statistics.misses(), 3ull);
+	QCOMPARE(statistics.inserts(), 8ull);
+	QCOMPARE(statistics.evictions(), 1ull);
+	QCOMPARE(statistics.invalidations(), 2ull);
+	QCOMPARE(statistics.count(), 0);
+	QCOMPARE(statistics.totalCost(), 0);
+	QCOMPARE(statistics.maxCost(), 100);
+	QCOMPARE(statistics.hitRate(), 4.0 / 7.0);
+
+	//missing keys are only remembered if nothing was saved in between
+	quint64 generation;
+	QCOMPARE(cache.find(keyA, data, generation), ObjectCache::NotCached);
+	QVERIFY(cache.insertMissing(keyA, generation));
+	QCOMPARE(cache.find(keyA, data, generation), ObjectCache::Missing);
+	QVERIFY(!cache.lookup(keyA, data));
+	cache.removeMissing(keyA);
+	QCOMPARE(cache.find(keyA, data, generation), ObjectCache::NotCached);
+	cache.insert(keyB, dataA, 40);
+	QVERIFY(!cache.insertMissing(keyA, generation));
+	QCOMPARE(cache.find(keyA, data, generation), ObjectCache::NotCached);
+	QVERIFY(cache.insertMissing(keyA, generation));
+	quint64 insertGeneration = 0;
+	QVERIFY(cache.insert(keyA, dataA, 40, &insertGeneration));
+	QVERIFY(insertGeneration != 0);
+	int cost = 0;
+	QCOMPARE(cache.find(keyA, data, generation, &cost), ObjectCache::Cached);
+	QCOMPARE(data, dataA);
+	QCOMPARE(generation, insertGeneration);
+	QCOMPARE(cost, 40);
+
+	//cached data keeps its generation until the key is saved again
+	QVERIFY(cache.insert(keyB, dataA, 40));
+	QCOMPARE(cache.find(keyA, data, generation), ObjectCache::Cached);
+	QCOMPARE(generation, insertGeneration);
+	QVERIFY(cache.insert(keyA, dataA, 40));
+	QCOMPARE(cache.find(keyA, data, generation), ObjectCache::Cached);
+	QVERIFY(generation != insertGeneration);
+
+	//saving data too large for the cache still replaces the missing entry
+	QVERIFY(cache.remove(keyA));
+	QCOMPARE(cache.find(keyA, data, generation), ObjectCache::NotCached);
+	QVERIFY(cache.insertMissing(keyA, generation));
+	QVERIFY(!cache.insert(keyA, dataA, 200));
+	QCOMPARE(cache.find(keyA, data, generation), ObjectCache::NotCached);
+}
+
+void TestLocalStore::testMissingKeys()
+{
+	const auto key = TestLib::generateKey(55);
+	const auto data = TestLib::generateDataJson(55);
+
+	try {
+		store->reset(false);
+
+		QJsonObject json;
+		QVERIFY(!store->contains(key));
+		QVERIFY(!store->tryLoad(key, json));
+		QVERIFY(json.isEmpty());
+		QVERIFY_EXCEPTION_THROWN(store->load(key), NoDataException);
+
+		//saving makes it visible to all stores again
+		LocalStore second(DefaultsPrivate::obtainDefaults(DefaultSetup));
+		QVERIFY(!second.contains(key));
+		store->save(key, data);
+		QVERIFY(second.contains(key));
+		QVERIFY(second.tryLoad(key, json));
+		QCOMPARE(json, data);
+
+		QVERIFY(store->remove(key));
+		QVERIFY(!store->contains(key));
+		QVERIFY(!second.tryLoad(key, json));
+		store->save(key, data);
+		QCOMPARE(second.load(key), data);
+
+		store->clear(TestLib::TypeName);
+		QVERIFY(!second.contains(key));
+		QVERIFY(!store->contains(key));
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void TestLocalStore::testAccessTracker()
+{
+	const QByteArray otherType = "OtherData";
+	AccessTracker tracker{QHash<QByteArray, int>{{TestLib::TypeName, 3}}};
+	QVERIFY(tracker.isTracked(TestLib::TypeName));
+	QVERIFY(!tracker.isTracked(otherType));
+
+	for(auto i : {1, 2, 1, 3, 1, 2})
+		tracker.record(TestLib::generateKey(i));
+	tracker.record({otherType, TestLib::generateDataKey(1)}); //ignored
+	QCOMPARE(tracker.mostUsed(TestLib::TypeName, 2), (QStringList{TestLib::generateDataKey(1), TestLib::generateDataKey(2)}));
+	QVERIFY(tracker.mostUsed(otherType, 2).isEmpty());
+
+	//a new key replaces the least used one and inherits its count
+	tracker.record(TestLib::generateKey(4));
+	auto changed = tracker.takeChanged();
+	QCOMPARE(changed.size(), 1);
+	const auto counts = changed.value(TestLib::TypeName);
+	QCOMPARE(counts.size(), 3);
+	QVERIFY(!counts.contains(TestLib::generateDataKey(3)));
+	QCOMPARE(counts.value(TestLib::generateDataKey(4)), 2ull);
+	QVERIFY(tracker.takeChanged().isEmpty());
+
+	//restored counts weigh half
+	tracker.clear();
+	tracker.restore(TestLib::TypeName, {
+						{TestLib::generateDataKey(5), 10},
+						{TestLib::generateDataKey(6), 3}
+					});
+	for(auto i = 0; i < 4; i++)
+		tracker.record(TestLib::generateKey(6));
+	QCOMPARE(tracker.mostUsed(TestLib::TypeName, 1), QStringList{TestLib::generateDataKey(6)});
+	QCOMPARE(tracker.takeChanged().value(TestLib::TypeName).value(TestLib::generateDataKey(5)), 5ull);
+}
+
+void TestLocalStore::testCachePreload()
+{
+	try {
+		auto nName = QStringLiteral("preload");
+		auto defaults = createSetup(nName, [](Setup &setup) {
+			setup.setCachePreload<TestData>(Setup::PreloadMostUsed, 2);
+		});
+
+		auto cache = defaults.cacheHandle().value<QSharedPointer<ObjectCache>>();
+		QVERIFY(cache);
+		auto tracker = defaults.accessTracker();
+		QVERIFY(tracker);
+
+		LocalStore preStore(defaults);
+		for(auto i = 0; i < 5; i++)
+			preStore.save(TestLib::generateKey(i), TestLib::generateDataJson(i));
+		for(auto i : {3, 1, 3, 0, 1, 3, 1, 3})
+			preStore.load(TestLib::generateKey(i));
+		preStore.checkpoint(); //stores the counts
+
+		//pretend a restart: only the stored counts are left
+		tracker->clear();
+		cache->clear();
+		preStore.warmCache();
+		auto mostUsed = tracker->mostUsed(TestLib::TypeName, 2);
+		std::sort(mostUsed.begin(), mostUsed.end());
+		QCOMPARE(mostUsed, TestLib::generateDataKeys(1, 1) + TestLib::generateDataKeys(3, 3));
+
+		QJsonObject json;
+		QVERIFY(cache->lookup(TestLib::generateKey(3), json));
+		QCOMPARE(json, TestLib::generateDataJson(3));
+		QVERIFY(cache->lookup(TestLib::generateKey(1), json));
+		QVERIFY(!cache->lookup(TestLib::generateKey(0), json));
+		QVERIFY(!cache->lookup(TestLib::generateKey(2), json));
+
+		//a reset drops the counts as well
+		preStore.reset(false);
+		tracker->clear();
+		preStore.warmCache();
+		QVERIFY(tracker->mostUsed(TestLib::TypeName, 2).isEmpty());
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
 void TestLocalStore::testChangeLoading()
 {
 	try {
@@ -281,6 +1660,44 @@ void TestLocalStore::testChangeLoading()
 			}();
 			return true;
 		});
+
+		//changes are ordered by sequence, loading can continue after one
+		QList<quint64> seqs;
+		QList<ObjectKey> keys;
+		auto loadAfter = [&](quint64 afterSeq) {
+			seqs.clear();
+			keys.clear();
+			store->loadChanges(10, afterSeq, [&](quint64 seq, ObjectKey k, quint64, QString, QUuid) {
+				seqs.append(seq);
+				keys.append(k);
+				return true;
+			});
+		};
+		loadAfter(0);
+		QCOMPARE(keys, QList<ObjectKey>({TestLib::generateKey(42), TestLib::generateKey(13)}));
+		QVERIFY(seqs[0] < seqs[1]);
+		const auto lastSeq = seqs[1];
+		loadAfter(seqs[0]);
+		QCOMPARE(keys, QList<ObjectKey>({TestLib::generateKey(13)}));
+		loadAfter(lastSeq);
+		QVERIFY(keys.isEmpty());
+
+		//changing again moves it behind the cursor
+		store->save(TestLib::generateKey(7), TestLib::generateDataJson(7));
+		loadAfter(lastSeq);
+		QCOMPARE(keys, QList<ObjectKey>({TestLib::generateKey(7)}));
+		const auto firstSeq = seqs[0];
+		store->save(TestLib::generateKey(7), TestLib::generateDataJson(7, QStringLiteral("again")));
+		loadAfter(firstSeq);
+		QCOMPARE(keys, QList<ObjectKey>({TestLib::generateKey(7)}));
+		QCOMPARE(store->changeCount(), 3u);
+
+		//only completing the current version removes it
+		store->markUnchanged(TestLib::generateKey(7), 1, false);
+		QCOMPARE(store->changeCount(), 3u);
+		QVERIFY(store->remove(TestLib::generateKey(7)));
+		store->markUnchanged(TestLib::generateKey(7), 3, true);
+		QCOMPARE(store->changeCount(), 2u);
 	} catch(QException &e) {
 		QFAIL(e.what());
 	}
@@ -372,6 +1789,24 @@ void TestLocalStore::testDeviceChanges()
 		QCOMPARE(store->changeCount(), 1u);
 		store->markUnchanged(TestLib::generateKey(43), 2, true);
 		QCOMPARE(store->changeCount(), 0u);
+
+		//a pending delete hides the device upload, saving again brings it back
+		store->save(TestLib::generateKey(44), TestLib::generateDataJson(44));
+		store->markUnchanged(TestLib::generateKey(44), 1, false);
+		store->prepareAccountAdded(devId);
+		QCOMPARE(store->changeCount(), 2u);
+		QVERIFY(store->remove(TestLib::generateKey(44)));
+		QCOMPARE(store->changeCount(), 2u);
+		store->save(TestLib::generateKey(44), TestLib::generateDataJson(44));
+		QCOMPARE(store->changeCount(), 3u);
+		cCount = 0;
+		store->loadChanges(10, [&](ObjectKey, quint64, QString, QUuid) {
+			cCount++;
+			return true;
+		});
+		QCOMPARE(static_cast<quint32>(cCount), store->changeCount());
+		store->reset(false);
+		QCOMPARE(store->changeCount(), 0u);
 	} catch(QException &e) {
 		QFAIL(e.what());
 	}
@@ -461,6 +1896,14 @@ void TestLocalStore::testInfoOperations()
 			QCOMPARE(store->changeCount(), 2u);
 		}
 
+		//changes that are rolled back never reach the cache
+		{
+			auto scope = store->startSync(TestLib::generateKey(44));
+			store->storeChanged(scope, 11ull, QString(), TestLib::generateDataJson(44), true, LocalStore::NoExists);
+		}
+		QVERIFY_EXCEPTION_THROWN(store->load(TestLib::generateKey(44)), NoDataException);
+		QCOMPARE(store->changeCount(), 2u);
+
 		//store changed of new data
 		{
 			auto scope = store->startSync(TestLib::generateKey(44));
@@ -7,8 +7,11 @@ CONFIG   -= app_bundle
 
 DEFINES += SRCDIR=\\\"$$_PRO_FILE_PWD_/\\\"
 
+#projects outside of tests/auto/datasync set the build dir of the TestLib themselves
+isEmpty(TESTLIB_OUT_PWD): TESTLIB_OUT_PWD = $$OUT_PWD/../TestLib
+
 linux: BUILD_LIB_DIR = $$shadowed($$dirname(_QMAKE_CONF_))/lib
-else: BUILD_LIB_DIR = $$OUT_PWD/../TestLib/
+else: BUILD_LIB_DIR = $$TESTLIB_OUT_PWD/
 
 win32:CONFIG(release, debug|release): LIBS += -L$$BUILD_LIB_DIR/release -lTestLib
 else:win32:CONFIG(debug, debug|release): LIBS += -L$$BUILD_LIB_DIR/debug -lTestLib
@@ -18,11 +21,11 @@ INCLUDEPATH += $$PWD/TestLib
 DEPENDPATH += $$PWD/TestLib
 
 !linux {
-	win32-g++:CONFIG(release, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../TestLib/release/libTestLib.a
-	else:win32-g++:CONFIG(debug, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../TestLib/debug/libTestLib.a
-	else:win32:!win32-g++:CONFIG(release, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../TestLib/release/TestLib.lib
-	else:win32:!win32-g++:CONFIG(debug, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../TestLib/debug/TestLib.lib
-	else:unix: PRE_TARGETDEPS += $$OUT_PWD/../TestLib/libTestLib.a
+	win32-g++:CONFIG(release, debug|release): PRE_TARGETDEPS += $$TESTLIB_OUT_PWD/release/libTestLib.a
+	else:win32-g++:CONFIG(debug, debug|release): PRE_TARGETDEPS += $$TESTLIB_OUT_PWD/debug/libTestLib.a
+	else:win32:!win32-g++:CONFIG(release, debug|release): PRE_TARGETDEPS += $$TESTLIB_OUT_PWD/release/TestLib.lib
+	else:win32:!win32-g++:CONFIG(debug, debug|release): PRE_TARGETDEPS += $$TESTLIB_OUT_PWD/debug/TestLib.lib
+	else:unix: PRE_TARGETDEPS += $$TESTLIB_OUT_PWD/libTestLib.a
 }
 
 INCLUDEPATH += $$PWD/../../../src/messages
@@ -0,0 +1,9 @@
+TESTLIB_OUT_PWD = $$OUT_PWD/../../../auto/datasync/TestLib
+include(../../../auto/datasync/tests.pri)
+
+QT       += concurrent
+
+TARGET = tst_bench_localstore
+
+SOURCES += \
+		tst_bench_localstore.cpp
@@ -0,0 +1,585 @@
+#include <QString>
+#include <QtTest>
+#include <QCoreApplication>
+#include <QtConcurrent>
+#include <testlib.h>
+#include <QtDataSync/private/localstore_p.h>
+#include <QtDataSync/private/defaults_p.h>
+#include <QtDataSync/private/objectcache_p.h>
+using namespace QtDataSync;
+
+namespace {
+
+QStringList dataFiles(const QDir &dir)
+{
+	QStringList files;
+	QDirIterator iterator(dir.absolutePath(), QDir::Files, QDirIterator::Subdirectories);
+	while(iterator.hasNext())
+		files.append(dir.relativeFilePath(iterator.next()));
+	return files;
+}
+
+}
+
+//benchmarks of the LocalStore, run them in release mode, e.g. with "-minimumtotal 1000"
+class BenchLocalStore : public QObject
+{
+	Q_OBJECT
+
+private Q_SLOTS:
+	void initTestCase();
+	void cleanupTestCase();
+	void cleanup();
+
+	void testSaveBenchmark_data();
+	void testSaveBenchmark();
+	void testStatementBenchmark_data();
+	void testStatementBenchmark();
+	void testTypeIdBenchmark_data();
+	void testTypeIdBenchmark();
+	void testConcurrentReadBenchmark_data();
+	void testConcurrentReadBenchmark();
+	void testCacheStressBenchmark_data();
+	void testCacheStressBenchmark();
+	void testPreloadBenchmark_data();
+	void testPreloadBenchmark();
+	void testReadBenchmark_data();
+	void testReadBenchmark();
+	void testParseBenchmark_data();
+	void testParseBenchmark();
+
+private:
+	LocalStore *store;
+	QStringList setups;
+
+	Defaults createSetup(const QString &nName, const std::function<void(Setup&)> &configure = {});
+};
+
+void BenchLocalStore::initTestCase()
+{
+#ifdef Q_OS_LINUX
+	if(!qgetenv("LD_PRELOAD").contains("Qt5DataSync"))
+		qWarning() << "No LD_PRELOAD set - this may fail on systems with multiple version of the modules";
+#endif
+	try {
+		TestLib::init();
+		Setup setup;
+		TestLib::setup(setup);
+		setup.create();
+
+		store = new LocalStore(DefaultsPrivate::obtainDefaults(DefaultSetup), this);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void BenchLocalStore::cleanupTestCase()
+{
+	delete store;
+	store = nullptr;
+	Setup::removeSetup(DefaultSetup, true);
+}
+
+void BenchLocalStore::cleanup()
+{
+	for(const auto &nName : qAsConst(setups))
+		Setup::removeSetup(nName, true);
+	setups.clear();
+}
+
+Defaults BenchLocalStore::createSetup(const QString &nName, const std::function<void(Setup&)> &configure)
+{
+	if(!setups.contains(nName))
+		setups.append(nName);
+
+	Setup setup;
+	TestLib::setup(setup);
+	setup.setLocalDir(TestLib::tDir.filePath(nName));
+	if(configure)
+		configure(setup);
+	setup.create(nName);
+	return DefaultsPrivate::obtainDefaults(nName);
+}
+
+void BenchLocalStore::testSaveBenchmark_data()
+{
+	QTest::addColumn<bool>("batched");
+
+	QTest::newRow("single") << false;
+	QTest::newRow("batched") << true;
+}
+
+void BenchLocalStore::testSaveBenchmark()
+{
+	QFETCH(bool, batched);
+
+	QHash<QString, QJsonObject> data;
+	for(auto i = 0; i < 1000; i++)
+		data.insert(QString::number(i), TestLib::generateDataJson(i));
+
+	try {
+		store->reset(false);
+		QBENCHMARK {
+			if(batched)
+				store->saveBatch(TestLib::TypeName, data);
+			else {
+				for(auto it = data.constBegin(); it != data.constEnd(); it++)
+					store->save({TestLib::TypeName, it.key()}, it.value());
+			}
+		}
+		QCOMPARE(store->count(TestLib::TypeName), 1000ull);
+		store->reset(false);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void BenchLocalStore::testStatementBenchmark_data()
+{
+	QTest::addColumn<bool>("save");
+	QTest::addColumn<bool>("prepared");
+
+	QTest::newRow("load") << false << true;
+	QTest::newRow("load-reprepare") << false << false;
+	QTest::newRow("save") << true << true;
+	QTest::newRow("save-reprepare") << true << false;
+}
+
+void BenchLocalStore::testStatementBenchmark()
+{
+	QFETCH(bool, save);
+	QFETCH(bool, prepared);
+
+	const auto key = TestLib::generateKey(90);
+	const auto data = TestLib::generateDataJson(90);
+
+	try {
+		auto nName = QStringLiteral("statements");
+		auto defaults = createSetup(nName, [](Setup &setup) {
+			setup.setCacheSize(0) //always hit the database
+					.setInlineDataLimit(1024);
+		});
+
+		LocalStore benchStore(defaults);
+		auto database = defaults.aquireDatabase(this);
+		benchStore.save(key, data);
+
+		if(prepared) {
+			QBENCHMARK {
+				if(save)
+					benchStore.save(key, data);
+				else
+					benchStore.load(key);
+			}
+		} else {
+			//what every call did before statements were cached
+			QBENCHMARK {
+				QVERIFY(database->transaction());
+				QSqlQuery loadQuery(database);
+				QVERIFY(loadQuery.prepare(QStringLiteral("SELECT Version, File, Data FROM DataIndex WHERE Type = (SELECT Id FROM Types WHERE Name = ?) AND Id = ?")));
+				loadQuery.addBindValue(key.typeName);
+				loadQuery.addBindValue(key.id);
+				QVERIFY(loadQuery.exec());
+				QVERIFY(loadQuery.first());
+				if(save) {
+					QSqlQuery updateQuery(database);
+					QVERIFY(updateQuery.prepare(QStringLiteral("UPDATE DataIndex SET Version = ?, Checksum = ?, Data = ? WHERE Type = (SELECT Id FROM Types WHERE Name = ?) AND Id = ?")));
+					updateQuery.addBindValue(loadQuery.value(0).toULongLong() + 1);
+					updateQuery.addBindValue(QByteArray());
+					updateQuery.addBindValue(QJsonDocument(data).toBinaryData());
+					updateQuery.addBindValue(key.typeName);
+					updateQuery.addBindValue(key.id);
+					QVERIFY(updateQuery.exec());
+				} else
+					QJsonDocument::fromBinaryData(loadQuery.value(2).toByteArray());
+				loadQuery.finish();
+				QVERIFY(database->commit());
+			}
+		}
+
+		QCOMPARE(benchStore.load(key), data);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void BenchLocalStore::testTypeIdBenchmark_data()
+{
+	QTest::addColumn<bool>("changes");
+	QTest::addColumn<bool>("typeNames");
+
+	QTest::newRow("keys/typeIds") << false << false;
+	QTest::newRow("keys/typeNames") << false << true;
+	QTest::newRow("loadChanges/typeIds") << true << false;
+	QTest::newRow("loadChanges/typeNames") << true << true;
+}
+
+void BenchLocalStore::testTypeIdBenchmark()
+{
+	QFETCH(bool, changes);
+	QFETCH(bool, typeNames);
+
+	try {
+		auto nName = QStringLiteral("typeIds");
+		auto defaults = createSetup(nName, [](Setup &setup) {
+			setup.setInlineDataLimit(1024);
+		});
+
+		LocalStore benchStore(defaults);
+		QHash<QString, QJsonObject> batch;
+		for(auto i = 0; i < 10000; i++)
+			batch.insert(QString::number(i), TestLib::generateDataJson(i));
+		benchStore.saveBatch(TestLib::TypeName, batch);
+		benchStore.prepareAccountAdded(QUuid::createUuid());
+
+		//copy the data into the layout of schema version 4, with the type name in every row
+		auto database = defaults.aquireDatabase(this);
+		const auto namesPath = defaults.storageDir().absoluteFilePath(QStringLiteral("typenames.db"));
+		const QStringList copyStatements {
+			QStringLiteral("ATTACH DATABASE '%1' AS names").arg(namesPath),
+			QStringLiteral("CREATE TABLE names.DataIndex ("
+						   "	Type		TEXT NOT NULL,"
+						   "	Id			TEXT NOT NULL,"
+						   "	Version		INTEGER NOT NULL,"
+						   "	File		TEXT,"
+						   "	Checksum	BLOB,"
+						   "	Data		BLOB,"
+						   "	Segment		INTEGER,"
+						   "	Offset		INTEGER,"
+						   "	Length		INTEGER,"
+						   "	Size		INTEGER,"
+						   "	PRIMARY KEY(Type, Id)"
+						   ") WITHOUT ROWID;"),
+			QStringLiteral("CREATE TABLE names.DeviceUploads ( "
+						   "	Type	TEXT NOT NULL, "
+						   "	Id		TEXT NOT NULL, "
+						   "	Device	TEXT NOT NULL, "
+						   "	PRIMARY KEY(Type, Id, Device) "
+						   ") WITHOUT ROWID;"),
+			QStringLiteral("CREATE TABLE names.ChangeLog ( "
+						   "	Seq		INTEGER PRIMARY KEY AUTOINCREMENT, "
+						   "	Type	TEXT NOT NULL, "
+						   "	Id		TEXT NOT NULL, "
+						   "	UNIQUE(Type, Id) "
+						   ");"),
+			QStringLiteral("CREATE TABLE names.TypeStats ( "
+						   "	Type	TEXT NOT NULL, "
+						   "	Objects	INTEGER NOT NULL DEFAULT 0, "
+						   "	Bytes	INTEGER NOT NULL DEFAULT 0, "
+						   "	Changes	INTEGER NOT NULL DEFAULT 0, "
+						   "	PRIMARY KEY(Type) "
+						   ") WITHOUT ROWID;"),
+			QStringLiteral("INSERT INTO names.DataIndex SELECT Types.Name, c.Id, c.Version, c.File, c.Checksum, c.Data, c.Segment, c.Offset, c.Length, c.Size "
+						   "FROM main.DataIndex c INNER JOIN Types ON Types.Id = c.Type"),
+			QStringLiteral("INSERT INTO names.DeviceUploads SELECT Types.Name, c.Id, c.Device "
+						   "FROM main.DeviceUploads c INNER JOIN Types ON Types.Id = c.Type"),
+			QStringLiteral("INSERT INTO names.ChangeLog SELECT c.Seq, Types.Name, c.Id "
+						   "FROM main.ChangeLog c INNER JOIN Types ON Types.Id = c.Type"),
+			QStringLiteral("INSERT INTO names.TypeStats SELECT Types.Name, c.Objects, c.Bytes, c.Changes "
+						   "FROM main.TypeStats c INNER JOIN Types ON Types.Id = c.Type"),
+			QStringLiteral("DETACH DATABASE names"),
+			QStringLiteral("VACUUM")
+		};
+		for(const auto &statement : copyStatements) {
+			QSqlQuery copyQuery(database);
+			QVERIFY2(copyQuery.exec(statement), qUtf8Printable(copyQuery.lastError().text()));
+		}
+
+		const auto connectionName = QStringLiteral("typenames");
+		{
+			auto namesDatabase = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), connectionName);
+			namesDatabase.setDatabaseName(namesPath);
+			QVERIFY(namesDatabase.open());
+			QSqlQuery vacuumQuery(namesDatabase);
+			QVERIFY(vacuumQuery.exec(QStringLiteral("VACUUM")));
+
+			//the index tables only differ in the type column, so the type ids must make the database smaller
+			const auto idsSize = QFileInfo{defaults.storageDir().absoluteFilePath(QStringLiteral("store.db"))}.size();
+			const auto namesSize = QFileInfo{namesPath}.size();
+			QVERIFY2(idsSize < namesSize, qUtf8Printable(QStringLiteral("%1 >= %2 bytes").arg(idsSize).arg(namesSize)));
+
+			//the queries of keys() and loadChanges() for both layouts
+			QSqlDatabase benchDatabase = database;
+			QVariant type;
+			if(typeNames) {
+				benchDatabase = namesDatabase;
+				type = QString::fromUtf8(TestLib::TypeName);
+			} else {
+				QSqlQuery idQuery(database);
+				QVERIFY(idQuery.exec(QStringLiteral("SELECT Id FROM Types")));
+				QVERIFY(idQuery.first());
+				type = idQuery.value(0);
+			}
+
+			QSqlQuery benchQuery(benchDatabase);
+			if(changes) {
+				QVERIFY(benchQuery.prepare(typeNames ?
+											   QStringLiteral("SELECT ChangeLog.Seq, ChangeLog.Type, ChangeLog.Id, DataIndex.Version, DataIndex.File "
+															  "FROM ChangeLog "
+															  "INNER JOIN DataIndex "
+															  "ON (ChangeLog.Type = DataIndex.Type AND ChangeLog.Id = DataIndex.Id) "
+															  "WHERE ChangeLog.Seq > ? "
+															  "ORDER BY ChangeLog.Seq "
+															  "LIMIT ?") :
+											   QStringLiteral("SELECT ChangeLog.Seq, Types.Name, ChangeLog.Id, DataIndex.Version, DataIndex.File "
+															  "FROM ChangeLog "
+															  "INNER JOIN DataIndex "
+															  "ON (ChangeLog.Type = DataIndex.Type AND ChangeLog.Id = DataIndex.Id) "
+															  "INNER JOIN Types ON Types.Id = ChangeLog.Type "
+															  "WHERE ChangeLog.Seq > ? "
+															  "ORDER BY ChangeLog.Seq "
+															  "LIMIT ?")));
+				QBENCHMARK {
+					benchQuery.addBindValue(0);
+					benchQuery.addBindValue(100);
+					QVERIFY(benchQuery.exec());
+					auto cnt = 0;
+					while(benchQuery.next())
+						cnt++;
+					QCOMPARE(cnt, 100);
+				}
+			} else {
+				QVERIFY(benchQuery.prepare(QStringLiteral("SELECT Id FROM DataIndex WHERE Type = ? AND File IS NOT NULL")));
+				QBENCHMARK {
+					benchQuery.addBindValue(type);
+					QVERIFY(benchQuery.exec());
+					auto cnt = 0;
+					while(benchQuery.next())
+						cnt++;
+					QCOMPARE(cnt, 10000);
+				}
+			}
+			benchQuery.finish();
+			namesDatabase.close();
+		}
+		QSqlDatabase::removeDatabase(connectionName);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void BenchLocalStore::testConcurrentReadBenchmark_data()
+{
+	QTest::addColumn<bool>("wal");
+
+	QTest::newRow("rollback") << false;
+	QTest::newRow("wal") << true;
+}
+
+void BenchLocalStore::testConcurrentReadBenchmark()
+{
+	QFETCH(bool, wal);
+
+	const auto key = TestLib::generateKey(95);
+	const auto data = TestLib::generateDataJson(95);
+
+	try {
+		auto nName = QStringLiteral("concurrent");
+		auto defaults = createSetup(nName, [&](Setup &setup) {
+			setup.setCacheSize(0) //always hit the database
+					.setDatabaseConfiguration({wal, wal ? DatabaseConfig::SyncNormal : DatabaseConfig::SyncFull});
+		});
+
+		LocalStore readStore(defaults);
+		readStore.save(key, data);
+
+		//simulate a running sync: one write transaction after the other
+		QAtomicInt running = 1;
+		auto writer = QtConcurrent::run([&](){
+			LocalStore writeStore(defaults);//thread without eventloop!
+			QHash<QString, QJsonObject> batch;
+			for(auto i = 0; i < 100; i++)
+				batch.insert(QString::number(i), TestLib::generateDataJson(i));
+			while(running.load())
+				writeStore.saveBatch(TestLib::TypeName, batch);
+		});
+
+		QBENCHMARK {
+			readStore.load(key);
+		}
+
+		running.store(0);
+		writer.waitForFinished();
+		QCOMPARE(readStore.load(key), data);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void BenchLocalStore::testCacheStressBenchmark_data()
+{
+	QTest::addColumn<int>("threads");
+
+	QTest::newRow("single") << 1;
+	QTest::newRow("ideal") << qMax(QThread::idealThreadCount(), 2);
+	QTest::newRow("oversubscribed") << 4 * qMax(QThread::idealThreadCount(), 2);
+}
+
+void BenchLocalStore::testCacheStressBenchmark()
+{
+	QFETCH(int, threads);
+
+	//more keys than fit into the cache, so every thread evicts as well
+	const auto keyCount = 4096;
+	const auto costs = 1024;
+	QVector<ObjectKey> keys;
+	QVector<QJsonObject> data;
+	for(auto i = 0; i < keyCount; i++) {
+		keys.append(TestLib::generateKey(i));
+		data.append(TestLib::generateDataJson(i));
+	}
+
+	ObjectCache cache{keyCount * costs / 2};
+	QAtomicInt mismatches = 0;
+	QBENCHMARK {
+		QList<QFuture<void>> futures;
+		for(auto t = 0; t < threads; t++) {
+			futures.append(QtConcurrent::run([&, t](){
+				//90% reads, skewed towards the first quarter of the keys
+				for(auto i = 0; i < 20000; i++) {
+					auto index = (i * 7919 + t * 104729) % keyCount;
+					if(i % 3 != 0)
+						index %= keyCount / 4;
+					QJsonObject json;
+					if(i % 10 == 0 || !cache.lookup(keys[index], json))
+						cache.insert(keys[index], data[index], costs);
+					else if(json != data[index])
+						mismatches.ref();
+				}
+			}));
+		}
+		for(auto f : futures)
+			f.waitForFinished();
+	}
+
+	QCOMPARE(mismatches.load(), 0);
+	QVERIFY(cache.totalCost() <= cache.maxCost());
+}
+
+void BenchLocalStore::testPreloadBenchmark_data()
+{
+	QTest::addColumn<bool>("preload");
+
+	QTest::newRow("cold") << false;
+	QTest::newRow("preloaded") << true;
+}
+
+void BenchLocalStore::testPreloadBenchmark()
+{
+	QFETCH(bool, preload);
+
+	const auto keyCount = 200;
+	try {
+		auto nName = QStringLiteral("preloadbench");
+		auto defaults = createSetup(nName, [&](Setup &setup) {
+			if(preload)
+				setup.setCachePreload<TestData>(Setup::PreloadAll);
+		});
+
+		LocalStore benchStore(defaults);
+		QHash<QString, QJsonObject> data;
+		for(auto i = 0; i < keyCount; i++)
+			data.insert(TestLib::generateDataKey(i), TestLib::generateDataJson(i));
+		benchStore.saveBatch(TestLib::TypeName, data);
+
+		//the first loads after a start, like the first screen of an app
+		auto cache = defaults.cacheHandle().value<QSharedPointer<ObjectCache>>();
+		cache->clear();
+		benchStore.warmCache();
+		const auto hits = cache->statistics().hits();
+		QBENCHMARK_ONCE {
+			for(auto i = 0; i < keyCount; i++)
+				benchStore.load(TestLib::generateKey(i));
+		}
+		QCOMPARE(cache->statistics().hits() - hits, preload ? static_cast<quint64>(keyCount) : 0ull);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void BenchLocalStore::testReadBenchmark_data()
+{
+	QTest::addColumn<int>("size");
+	QTest::addColumn<bool>("mapped");
+
+	QTest::newRow("64k") << 64 * 1024 << true;
+	QTest::newRow("64k-readall") << 64 * 1024 << false;
+	QTest::newRow("4M") << 4 * 1024 * 1024 << true;
+	QTest::newRow("4M-readall") << 4 * 1024 * 1024 << false;
+}
+
+void BenchLocalStore::testReadBenchmark()
+{
+	QFETCH(int, size);
+	QFETCH(bool, mapped);
+
+	const auto key = TestLib::generateKey(96);
+	const auto data = TestLib::generateDataJson(96, QString(size, QLatin1Char('z')));
+
+	try {
+		auto nName = QStringLiteral("read");
+		auto defaults = createSetup(nName, [](Setup &setup) {
+			setup.setCacheSize(0); //always read the file
+		});
+
+		LocalStore benchStore(defaults);
+		benchStore.save(key, data);
+
+		if(mapped) {
+			QBENCHMARK {
+				benchStore.load(key);
+			}
+		} else {
+			QDir dataDir(TestLib::tDir.filePath(nName));
+			QVERIFY(dataDir.cd(QStringLiteral("store/data_TestData")));
+			const auto files = dataFiles(dataDir);
+			QCOMPARE(files.size(), 1);
+
+			//what every load did before files were mapped
+			QBENCHMARK {
+				QFile file(dataDir.absoluteFilePath(files.first()));
+				QVERIFY(file.open(QIODevice::ReadOnly));
+				QVERIFY(LocalStore::fromStorageFormat(file.readAll()).isObject());
+			}
+		}
+		QCOMPARE(benchStore.load(key), data);
+	} catch(QException &e) {
+		QFAIL(e.what());
+	}
+}
+
+void BenchLocalStore::testParseBenchmark_data()
+{
+	QTest::addColumn<int>("size");
+	QTest::addColumn<bool>("cbor");
+
+	QTest::newRow("small-binaryjson") << 0 << false;
+	QTest::newRow("small-cbor") << 0 << true;
+	QTest::newRow("large-binaryjson") << 100 << false;
+	QTest::newRow("large-cbor") << 100 << true;
+}
+
+void BenchLocalStore::testParseBenchmark()
+{
+	QFETCH(int, size);
+	QFETCH(bool, cbor);
+
+	//objects as stored by the datastore tests, with an array of them for the large case
+	auto data = TestLib::generateDataJson(97);
+	if(size > 0) {
+		data.insert(QStringLiteral("children"), TestLib::dataListJson(TestLib::generateDataJson(0, size)));
+	}
+
+	const auto binData = QJsonDocument(data).toBinaryData();
+	const auto storedData = cbor ? LocalStore::toStorageFormat(data) : binData;
+	QVERIFY(storedData.size() <= binData.size());
+	QCOMPARE(LocalStore::fromStorageFormat(storedData).object(), data);
+
+	QBENCHMARK {
+		LocalStore::fromStorageFormat(storedData).object();
+	}
+}
+
+QTEST_MAIN(BenchLocalStore)
+
+#include "tst_bench_localstore.moc"
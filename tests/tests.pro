@@ -3,3 +3,9 @@ TEMPLATE = subdirs
 CONFIG += no_docs_target
 
 SUBDIRS += auto
+
+#not part of make check, enable with CONFIG+=build_benchmarks
+build_benchmarks {
+	SUBDIRS += benchmarks
+	benchmarks.depends += auto #for the TestLib
+}